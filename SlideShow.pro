@@ -23,14 +23,74 @@ DBUS_ADAPTORS += slidewindow.xml
 
 SOURCES += main.cpp
 SOURCES += slidewindow2.cpp
+SOURCES += slideloader.cpp
+SOURCES += slideprefetcher.cpp
+SOURCES += decodepool.cpp
+SOURCES += slidecache.cpp
+SOURCES += jpegdecoder.cpp
+SOURCES += stripdecoder.cpp
+SOURCES += slidediskcache.cpp
+SOURCES += slideindex.cpp
+SOURCES += slidetable.cpp
+SOURCES += slidescanner.cpp
+SOURCES += framestats.cpp
+SOURCES += letterbox.cpp
+SOURCES += slidemesh.cpp
+SOURCES += transition.cpp
+SOURCES += transitions.cpp
+SOURCES += transitionregistry.cpp
+SOURCES += programcache.cpp
+SOURCES += rendersurface.cpp
+SOURCES += dispmanxsurface.cpp
+SOURCES += headlesssurface.cpp
+SOURCES += tracer.cpp
+SOURCES += inputdevices.cpp
+SOURCES += playlist.cpp
+SOURCES += animatedslide.cpp
+SOURCES += kenburns.cpp
+SOURCES += etc1.cpp
+SOURCES += etc1encoder.cpp
+SOURCES += rgb565.cpp
+SOURCES += framepool.cpp
 
 HEADERS += slidewindow2.h
+HEADERS += slideloader.h
+HEADERS += slideprefetcher.h
+HEADERS += decodepool.h
+HEADERS += slidecache.h
+HEADERS += jpegdecoder.h
+HEADERS += stripdecoder.h
+HEADERS += slidediskcache.h
+HEADERS += slideindex.h
+HEADERS += slidetable.h
+HEADERS += slidescanner.h
+HEADERS += framestats.h
+HEADERS += letterbox.h
+HEADERS += slidemesh.h
+HEADERS += transition.h
+HEADERS += transitions.h
+HEADERS += transitionregistry.h
+HEADERS += programcache.h
+HEADERS += rendersurface.h
+HEADERS += dispmanxsurface.h
+HEADERS += headlesssurface.h
+HEADERS += tracer.h
+HEADERS += inputdevices.h
+HEADERS += playlist.h
+HEADERS += animatedslide.h
+HEADERS += kenburns.h
+HEADERS += etc1.h
+HEADERS += etc1encoder.h
+HEADERS += rgb565.h
+HEADERS += framepool.h
 
 RESOURCES += shaders.qrc
 
 INCLUDEPATH += /usr/local/include
 INCLUDEPATH += /opt/vc/include
 LIBS += -L"/opt/vc/lib" -lbrcmGLESv2 -lbrcmEGL -lopenmaxil -lbcm_host -lvcos -lvchiq_arm -lpthread -lrt -lm
+LIBS += -ljpeg
+LIBS += -lpng
 
 OTHER_FILES += slidewindow.xml
 
@@ -0,0 +1,315 @@
+#include "animatedslide.h"
+#include "tracer.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+
+#define DEFAULT_FRAME_DELAY 100 // ms, for frames without (or with a too short) delay
+#define MIN_FRAME_DELAY      20
+#define MJPEG_FRAME_DELAY    40 // Motion JPEG has no timing: 25 fps
+#define LATE_FRAME_TIME   20000 // us after the due time
+
+
+AnimatedSlide::AnimatedSlide(QObject* parent)
+    : QThread(parent)
+{
+    iHead       = 0;
+    nReady      = 0;
+    bTaken      = false;
+    bAbort      = false;
+    frameWidth  = 0;
+    frameHeight = 0;
+    pMjpeg      = Q_NULLPTR;
+    mjpegLength = 0;
+    mjpegOffset = 0;
+    bOpen       = false;
+    bPlaying    = false;
+    nextFrameTime = 0;
+    nLate       = 0;
+}
+
+
+AnimatedSlide::~AnimatedSlide() {
+    close();
+}
+
+
+bool
+AnimatedSlide::isMjpeg(QString sFile) {
+    QString sSuffix = QFileInfo(sFile).suffix().toLower();
+    return (sSuffix == "mjpg") || (sSuffix == "mjpeg");
+}
+
+
+// Only files with more than one frame are played
+bool
+AnimatedSlide::isAnimation(QString sFile) {
+    if(isMjpeg(sFile))
+        return true;
+    QImageReader probe(sFile);
+    return probe.supportsAnimation() && (probe.imageCount() != 1);
+}
+
+
+// Start decoding the frames of sFile letterboxed to width x height
+bool
+AnimatedSlide::open(QString sFile, int width, int height) {
+    close();
+    if((width <= 0) || (height <= 0))
+        return false;
+    sFileName   = sFile;
+    frameWidth  = width;
+    frameHeight = height;
+    iHead    = 0;
+    nReady   = 0;
+    bTaken   = false;
+    bAbort   = false;
+    bOpen    = true;
+    bPlaying = false;
+    start(QThread::LowPriority);
+    return true;
+}
+
+
+void
+AnimatedSlide::close() {
+    if(!bOpen)
+        return;
+    mutex.lock();
+    bAbort = true;
+    slotFree.wakeAll();
+    mutex.unlock();
+    wait();
+    bOpen    = false;
+    bPlaying = false;
+}
+
+
+bool
+AnimatedSlide::isOpen() {
+    return bOpen;
+}
+
+
+// The first frame is due now
+void
+AnimatedSlide::play(qint64 nowUs) {
+    bPlaying = bOpen;
+    nextFrameTime = nowUs;
+}
+
+
+bool
+AnimatedSlide::isPlaying() {
+    return bPlaying;
+}
+
+
+int
+AnimatedSlide::decodedFrames() {
+    return nDecoded.loadAcquire();
+}
+
+
+int
+AnimatedSlide::lateFrames() {
+    return nLate;
+}
+
+
+// The next frame, if it is due and ready, with the rows changed from
+// the previous one. It stays valid until releaseFrame().
+const QImage*
+AnimatedSlide::takeDueFrame(qint64 nowUs, int* pFirstRow, int* pRows) {
+    if(!bPlaying || (nowUs < nextFrameTime))
+        return Q_NULLPTR;
+    QMutexLocker locker(&mutex);
+    if((nReady == 0) || bTaken)
+        return Q_NULLPTR;// The worker is behind
+    RingFrame& current = ring[iHead];
+    bTaken = true;
+    qint64 lateness = nowUs - nextFrameTime;
+    if(lateness > LATE_FRAME_TIME)
+        nLate++;
+    // More than a frame behind: the timing starts again from now
+    if(lateness > 1000*qint64(current.delay))
+        nextFrameTime = nowUs;
+    nextFrameTime += 1000*qint64(current.delay);
+    *pFirstRow = current.firstRow;
+    *pRows     = current.nRows;
+    return &current.frame;
+}
+
+
+void
+AnimatedSlide::releaseFrame() {
+    QMutexLocker locker(&mutex);
+    if(!bTaken)
+        return;
+    bTaken = false;
+    iHead  = (iHead + 1) % ANIMATION_RING_FRAMES;
+    nReady--;
+    slotFree.wakeAll();
+}
+
+
+bool
+AnimatedSlide::openStream() {
+    if(!isMjpeg(sFileName)) {
+        reader.setFileName(sFileName);
+        return reader.canRead();
+    }
+    int fd = ::open(QFile::encodeName(sFileName).constData(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return false;
+    struct stat fileStat;
+    if((fstat(fd, &fileStat) == -1) || (fileStat.st_size == 0)) {
+        ::close(fd);
+        return false;
+    }
+    mjpegLength = size_t(fileStat.st_size);
+    void* pMapped = mmap(Q_NULLPTR, mjpegLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(pMapped == MAP_FAILED)
+        return false;
+    madvise(pMapped, mjpegLength, MADV_SEQUENTIAL);
+    pMjpeg      = static_cast<const uchar*>(pMapped);
+    mjpegOffset = 0;
+    return true;
+}
+
+
+void
+AnimatedSlide::closeStream() {
+    if(pMjpeg)
+        munmap(const_cast<uchar*>(pMjpeg), mjpegLength);
+    pMjpeg      = Q_NULLPTR;
+    mjpegLength = 0;
+    reader.setDevice(Q_NULLPTR);
+}
+
+
+// Position of the 0xff, marker pair in [pStart, pEnd), if any
+static const uchar*
+findMarker(const uchar* pStart, const uchar* pEnd, uchar marker) {
+    while(pStart+1 < pEnd) {
+        const uchar* pFound = static_cast<const uchar*>(memchr(pStart, 0xff, size_t(pEnd-pStart-1)));
+        if(!pFound)
+            return Q_NULLPTR;
+        if(pFound[1] == marker)
+            return pFound;
+        pStart = pFound + 1;
+    }
+    return Q_NULLPTR;
+}
+
+
+// A Motion JPEG clip is just a sequence of JPEG images:
+// each frame goes from its SOI to its EOI marker
+bool
+AnimatedSlide::readMjpegFrame(QImage* pImage) {
+    const uchar* pEnd   = pMjpeg + mjpegLength;
+    const uchar* pStart = findMarker(pMjpeg+mjpegOffset, pEnd, 0xd8);
+    if(!pStart)
+        return false;
+    const uchar* pEoi = findMarker(pStart+2, pEnd, 0xd9);
+    if(!pEoi)
+        return false;
+    mjpegOffset = size_t(pEoi+2-pMjpeg);
+    return pImage->loadFromData(pStart, int(pEoi+2-pStart), "JPEG");
+}
+
+
+bool
+AnimatedSlide::readFrame(QImage* pImage, int* pDelay) {
+    if(pMjpeg) {
+        *pDelay = MJPEG_FRAME_DELAY;
+        return readMjpegFrame(pImage);
+    }
+    if(!reader.read(pImage))
+        return false;
+    // The time the image just read stays on
+    *pDelay = reader.nextImageDelay();
+    if(*pDelay < MIN_FRAME_DELAY)
+        *pDelay = DEFAULT_FRAME_DELAY;
+    return true;
+}
+
+
+// Rows [*pFirstRow, *pFirstRow + *pRows) are the only ones differing:
+// small animations over a still background need tiny uploads
+void
+AnimatedSlide::changedRows(const QImage& previous, const QImage& current,
+                           int* pFirstRow, int* pRows)
+{
+    int rowBytes = current.width()*4;
+    int first = 0;
+    int last  = current.height() - 1;
+    while((first <= last) && (memcmp(previous.constScanLine(first), current.constScanLine(first), size_t(rowBytes)) == 0))
+        first++;
+    while((last > first) && (memcmp(previous.constScanLine(last), current.constScanLine(last), size_t(rowBytes)) == 0))
+        last--;
+    *pFirstRow = first;
+    *pRows     = last - first + 1;
+}
+
+
+void
+AnimatedSlide::run() {
+    if(!openStream()) {
+        qDebug() << "Unable to play" << sFileName;
+        closeStream();
+        return;
+    }
+    QImage image;
+    int delay;
+    int iPrevious = -1;
+    forever {
+        mutex.lock();
+        while(!bAbort && (nReady == ANIMATION_RING_FRAMES))
+            slotFree.wait(&mutex);
+        if(bAbort) {
+            mutex.unlock();
+            break;
+        }
+        // Not visible to the consumer until nReady is incremented
+        int iTail = (iHead + nReady) % ANIMATION_RING_FRAMES;
+        mutex.unlock();
+
+        TraceSpan span("decodeAnimationFrame", "decode");
+        if(!readFrame(&image, &delay)) {
+            // At the end start again from the first frame
+            closeStream();
+            if(!openStream() || !readFrame(&image, &delay)) {
+                qDebug() << "Unable to read the frames of" << sFileName;
+                break;
+            }
+        }
+        RingFrame& slot = ring[iTail];
+        loader.compose(image, frameWidth, frameHeight, &slot.frame);
+        slot.delay = delay;
+        if(iPrevious < 0) {// The texture holds something else
+            slot.firstRow = 0;
+            slot.nRows    = frameHeight;
+        }
+        else {
+            changedRows(ring[iPrevious].frame, slot.frame, &slot.firstRow, &slot.nRows);
+        }
+        iPrevious = iTail;
+        nDecoded.fetchAndAddRelaxed(1);
+
+        mutex.lock();
+        nReady++;
+        mutex.unlock();
+    }
+    closeStream();
+}
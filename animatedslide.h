@@ -0,0 +1,84 @@
+#ifndef ANIMATEDSLIDE_H
+#define ANIMATEDSLIDE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImageReader>
+#include <QImage>
+#include <QAtomicInt>
+
+#include "slideloader.h"
+
+
+#define ANIMATION_RING_FRAMES 3 // Frames decoded ahead of each animation
+
+
+// The frames of an animated slide (GIF, WebP, ... or a Motion JPEG
+// clip) decoded as a stream by a worker thread into a small ring of
+// screen sized frames: an animation is never decoded all at once.
+// The consumer (the render loop) takes each frame when it is due,
+// as told by the file frame delays, uploads the rows that changed
+// and gives the frame back to the ring.
+class AnimatedSlide : public QThread
+{
+public:
+    AnimatedSlide(QObject* parent = Q_NULLPTR);
+    ~AnimatedSlide();
+    static bool isAnimation(QString sFile);
+    bool open(QString sFile, int width, int height);
+    void close();
+    bool isOpen();
+    void play(qint64 nowUs);
+    bool isPlaying();
+    const QImage* takeDueFrame(qint64 nowUs, int* pFirstRow, int* pRows);
+    void releaseFrame();
+    int  decodedFrames();
+    int  lateFrames();
+
+protected:
+    void run();
+
+private:
+    static bool isMjpeg(QString sFile);
+    bool openStream();
+    void closeStream();
+    bool readFrame(QImage* pImage, int* pDelay);
+    bool readMjpegFrame(QImage* pImage);
+    static void changedRows(const QImage& previous, const QImage& current,
+                            int* pFirstRow, int* pRows);
+
+private:
+    struct RingFrame {
+        QImage frame;
+        int delay;// ms
+        int firstRow;// Rows changed from the previous frame
+        int nRows;
+    };
+    QMutex mutex;
+    QWaitCondition slotFree;
+    RingFrame ring[ANIMATION_RING_FRAMES];
+    int  iHead;// The next frame to be shown
+    int  nReady;
+    bool bTaken;// ring[iHead] is being uploaded
+    bool bAbort;
+    QString sFileName;
+    int  frameWidth;
+    int  frameHeight;
+    QAtomicInt nDecoded;
+
+    // Used only by the worker
+    SlideLoader loader;
+    QImageReader reader;
+    const uchar* pMjpeg;
+    size_t mjpegLength;
+    size_t mjpegOffset;
+
+    // Used only by the consumer
+    bool   bOpen;
+    bool   bPlaying;
+    qint64 nextFrameTime;
+    int    nLate;
+};
+
+#endif // ANIMATEDSLIDE_H
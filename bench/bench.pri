@@ -0,0 +1,19 @@
+# Shared settings of the benchmark programs: they are built
+# from the sources of the slide show in the parent directory.
+
+QT += core
+QT += gui
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SLIDESHOW_DIR = $$PWD/..
+INCLUDEPATH += $$SLIDESHOW_DIR
+DEPENDPATH  += $$SLIDESHOW_DIR
+
+INCLUDEPATH += /usr/local/include
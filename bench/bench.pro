@@ -0,0 +1,4 @@
+TEMPLATE = subdirs
+
+SUBDIRS += slideshow-bench
+SUBDIRS += decode-bench
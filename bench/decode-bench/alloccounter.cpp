@@ -0,0 +1,78 @@
+#include "alloccounter.h"
+
+#include <stddef.h>
+#include <atomic>
+
+
+// The glibc allocator entry points: our malloc() & C.
+// take the place of the libc ones for the whole process
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nItems, size_t size);
+void* __libc_realloc(void* pBlock, size_t size);
+}
+
+
+static std::atomic<bool>      bCounting(false);
+static std::atomic<long long> minSize(0);
+static std::atomic<long long> nAllocations(0);
+static std::atomic<long long> nBytes(0);
+
+
+static inline void
+countAllocation(size_t size) {
+    if(bCounting.load(std::memory_order_relaxed) &&
+       (static_cast<long long>(size) >= minSize.load(std::memory_order_relaxed)))
+    {
+        nAllocations.fetch_add(1, std::memory_order_relaxed);
+        nBytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+    }
+}
+
+
+extern "C" void*
+malloc(size_t size) {
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+
+extern "C" void*
+calloc(size_t nItems, size_t size) {
+    countAllocation(nItems*size);
+    return __libc_calloc(nItems, size);
+}
+
+
+extern "C" void*
+realloc(void* pBlock, size_t size) {
+    countAllocation(size);
+    return __libc_realloc(pBlock, size);
+}
+
+
+void
+AllocCounter::start(qint64 minBytes) {
+    minSize      = minBytes;
+    nAllocations = 0;
+    nBytes       = 0;
+    bCounting    = true;
+}
+
+
+void
+AllocCounter::stop() {
+    bCounting = false;
+}
+
+
+qint64
+AllocCounter::allocations() {
+    return nAllocations;
+}
+
+
+qint64
+AllocCounter::bytes() {
+    return nBytes;
+}
@@ -0,0 +1,19 @@
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+#include <QtGlobal>
+
+
+// Counts the heap allocations (malloc, calloc, realloc and so
+// operator new) made by the whole process between start() and stop():
+// all of them or only those of at least minBytes bytes
+class AllocCounter
+{
+public:
+    static void   start(qint64 minBytes = 0);
+    static void   stop();
+    static qint64 allocations();
+    static qint64 bytes();
+};
+
+#endif // ALLOCCOUNTER_H
@@ -0,0 +1,45 @@
+# Times the stages of the slide preparation (file read, decoding,
+# scaling, letterboxing, format conversion) on a synthetic corpus.
+# Output is one JSON object per line, to compare runs.
+
+include(../bench.pri)
+
+TARGET = decode-bench
+
+SOURCES += main.cpp
+SOURCES += alloccounter.cpp
+SOURCES += $$SLIDESHOW_DIR/slideloader.cpp
+SOURCES += $$SLIDESHOW_DIR/jpegdecoder.cpp
+SOURCES += $$SLIDESHOW_DIR/stripdecoder.cpp
+SOURCES += $$SLIDESHOW_DIR/letterbox.cpp
+SOURCES += $$SLIDESHOW_DIR/framepool.cpp
+SOURCES += $$SLIDESHOW_DIR/rgb565.cpp
+SOURCES += $$SLIDESHOW_DIR/tracer.cpp
+SOURCES += $$SLIDESHOW_DIR/decodepool.cpp
+SOURCES += $$SLIDESHOW_DIR/slideprefetcher.cpp
+SOURCES += $$SLIDESHOW_DIR/slidecache.cpp
+SOURCES += $$SLIDESHOW_DIR/slidediskcache.cpp
+SOURCES += $$SLIDESHOW_DIR/framestats.cpp
+SOURCES += $$SLIDESHOW_DIR/animatedslide.cpp
+SOURCES += $$SLIDESHOW_DIR/etc1.cpp
+SOURCES += $$SLIDESHOW_DIR/etc1encoder.cpp
+
+HEADERS += alloccounter.h
+HEADERS += $$SLIDESHOW_DIR/slideloader.h
+HEADERS += $$SLIDESHOW_DIR/jpegdecoder.h
+HEADERS += $$SLIDESHOW_DIR/stripdecoder.h
+HEADERS += $$SLIDESHOW_DIR/letterbox.h
+HEADERS += $$SLIDESHOW_DIR/framepool.h
+HEADERS += $$SLIDESHOW_DIR/rgb565.h
+HEADERS += $$SLIDESHOW_DIR/tracer.h
+HEADERS += $$SLIDESHOW_DIR/decodepool.h
+HEADERS += $$SLIDESHOW_DIR/slideprefetcher.h
+HEADERS += $$SLIDESHOW_DIR/slidecache.h
+HEADERS += $$SLIDESHOW_DIR/slidediskcache.h
+HEADERS += $$SLIDESHOW_DIR/framestats.h
+HEADERS += $$SLIDESHOW_DIR/animatedslide.h
+HEADERS += $$SLIDESHOW_DIR/etc1.h
+HEADERS += $$SLIDESHOW_DIR/etc1encoder.h
+
+LIBS += -ljpeg
+LIBS += -lpng
@@ -0,0 +1,1183 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QStringList>
+#include <QVector>
+#include <QImage>
+#include <QPainter>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <QDebug>
+
+#include <algorithm>
+#include <stdio.h>
+#include <setjmp.h>
+#include <string.h>
+#include <jpeglib.h>
+#include <png.h>
+#include "unistd.h"
+
+#include "alloccounter.h"
+#include "jpegdecoder.h"
+#include "letterbox.h"
+#include "rgb565.h"
+#include "slideloader.h"
+#include "decodepool.h"
+#include "slideprefetcher.h"
+#include "animatedslide.h"
+#include "framepool.h"
+#include "stripdecoder.h"
+#include "slidediskcache.h"
+#include "etc1.h"
+#include "etc1encoder.h"
+
+
+#define DEFAULT_ITERATIONS    5
+#define FRAME_SIZED_BYTES     (256*1024) // Pixel buffers: what the bookkeeping of the decoders never reaches
+#define MAX_SLIDE_ALLOCATIONS 64         // Steady state, per slide: libjpeg alone makes 11 to 13 of them
+#define MAX_SLIDE_ALLOC_BYTES (256*1024) // and about 100 KB, the file and the Qt reader add a few more
+
+
+// Runs the stages of the slide preparation path, the current ones and
+// the ones they replaced, one by one on a synthetic corpus and prints
+// a JSON object per line for each (image, screen, stage).
+class DecodeBench
+{
+public:
+    DecodeBench(int nIterations, FILE* pOutput);
+    bool createCorpus(QString sDir);
+    void run();
+    void runPoolChecks();
+    void runAnimationChecks(QString sDir);
+    void runStripChecks(QString sDir);
+    void runEtc1Checks();
+    void runDiskCacheChecks();
+    void runRgb565Checks();
+    void runLetterboxChecks();
+    void runSteadyStateChecks();
+    int  failedChecks();
+
+private:
+    struct Screen {
+        int width;
+        int height;
+    };
+    template <typename Stage>
+    void measure(QString sImage, const Screen& screen, QString sStage, Stage stage);
+    void report(QString sImage, const Screen& screen, QString sStage,
+                QVector<qint64> times, qint64 nAllocations, qint64 allocBytes);
+    void check(QString sImage, const Screen& screen, QString sCheck, bool bPassed, QString sDetail);
+    static QImage syntheticImage(int width, int height);
+    static void syntheticRow(int y, int width, int height, uchar* pRow);
+    static QImage translucentImage(int width, int height);
+    static QImage nearestScaled(const QImage& image, int width, int height);
+    static bool writeLargeJpeg(QString sFile, int width, int height, bool bProgressive = false);
+    static bool writeLargePng(QString sFile, int width, int height);
+    static qint64 statusBytes(const char* sField);
+    static QImage paintFrame(const QImage& scaled, const Screen& screen);
+    static int maxDifference(const QImage& a, const QImage& b);
+
+private:
+    int nIterations;
+    FILE* pOut;
+    QStringList corpus;
+    QVector<Screen> screens;
+    int nFailed;
+};
+
+
+DecodeBench::DecodeBench(int iterations, FILE* pOutput) {
+    nIterations = qMax(1, iterations);
+    pOut        = pOutput;
+    nFailed     = 0;
+    Screen screen;
+    screen.width = 800;  screen.height = 480;  screens.append(screen);// Pi LCD
+    screen.width = 1280; screen.height = 720;  screens.append(screen);
+    screen.width = 1920; screen.height = 1080; screens.append(screen);
+}
+
+
+// Gradients and noise: something not too easy to compress
+QImage
+DecodeBench::syntheticImage(int width, int height) {
+    QImage image(width, height, QImage::Format_RGB32);
+    quint32 seed = 12345;
+    for(int y=0; y<height; y++) {
+        QRgb* pRow = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for(int x=0; x<width; x++) {
+            seed = seed*1103515245 + 12345;
+            int noise = int((seed >> 16) & 0x1f) - 16;
+            pRow[x] = qRgb(qBound(0, 255*x/width + noise, 255),
+                           qBound(0, 255*y/height + noise, 255),
+                           qBound(0, ((x/64 + y/64) & 1)*160 + noise + 48, 255));
+        }
+    }
+    return image;
+}
+
+
+// The same kind of content, one RGB row at a time
+void
+DecodeBench::syntheticRow(int y, int width, int height, uchar* pRow) {
+    quint32 seed = 12345 + quint32(y);
+    for(int x=0; x<width; x++, pRow+=3) {
+        seed = seed*1103515245 + 12345;
+        int noise = int((seed >> 16) & 0x1f) - 16;
+        pRow[0] = uchar(qBound(0, int(255*qint64(x)/width) + noise, 255));
+        pRow[1] = uchar(qBound(0, int(255*qint64(y)/height) + noise, 255));
+        pRow[2] = uchar(qBound(0, ((x/64 + y/64) & 1)*160 + noise + 48, 255));
+    }
+}
+
+
+// Random premultiplied pixels: opaque, fully transparent and translucent
+QImage
+DecodeBench::translucentImage(int width, int height) {
+    QImage image(width, height, QImage::Format_RGBA8888_Premultiplied);
+    quint32 seed = 54321;
+    for(int y=0; y<height; y++) {
+        uchar* pRow = image.scanLine(y);
+        for(int x=0; x<width; x++, pRow+=4) {
+            seed = seed*1103515245 + 12345;
+            int kind = int((seed >> 16) & 3);
+            seed = seed*1103515245 + 12345;
+            int alpha = (kind == 0) ? 255 : (kind == 1) ? 0 : int((seed >> 16) & 0xff);
+            for(int c=0; c<3; c++) {
+                seed = seed*1103515245 + 12345;
+                pRow[c] = uchar(int((seed >> 16) & 0x7fff) % (alpha+1));
+            }
+            pRow[3] = uchar(alpha);
+        }
+    }
+    return image;
+}
+
+
+// Nearest neighbour, pixel centers on pixel centers: the
+// scaling expected from letterboxScaleFlip()
+QImage
+DecodeBench::nearestScaled(const QImage& image, int width, int height) {
+    QImage scaled(width, height, image.format());
+    for(int y=0; y<height; y++) {
+        int iSrcRow = int(((2LL*y + 1)*image.height()) / (2LL*height));
+        const quint32* pSrc = reinterpret_cast<const quint32*>(image.constScanLine(iSrcRow));
+        quint32* pDst = reinterpret_cast<quint32*>(scaled.scanLine(y));
+        for(int x=0; x<width; x++)
+            pDst[x] = pSrc[((2LL*x + 1)*image.width()) / (2LL*width)];
+    }
+    return scaled;
+}
+
+
+// Images too large to be held in memory are written a row at a time
+bool
+DecodeBench::writeLargeJpeg(QString sFile, int width, int height, bool bProgressive) {
+    FILE* pFile = fopen(QFile::encodeName(sFile).constData(), "wb");
+    if(!pFile)
+        return false;
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, pFile);
+    cinfo.image_width      = JDIMENSION(width);
+    cinfo.image_height     = JDIMENSION(height);
+    cinfo.input_components = 3;
+    cinfo.in_color_space   = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 85, TRUE);
+    if(bProgressive)
+        jpeg_simple_progression(&cinfo);
+    jpeg_start_compress(&cinfo, TRUE);
+    QByteArray row(3*width, 0);
+    JSAMPROW pRow = reinterpret_cast<JSAMPROW>(row.data());
+    while(cinfo.next_scanline < cinfo.image_height) {
+        syntheticRow(int(cinfo.next_scanline), width, height, pRow);
+        jpeg_write_scanlines(&cinfo, &pRow, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    fclose(pFile);
+    return true;
+}
+
+
+bool
+DecodeBench::writeLargePng(QString sFile, int width, int height) {
+    FILE* pFile = fopen(QFile::encodeName(sFile).constData(), "wb");
+    if(!pFile)
+        return false;
+    png_structp pPng = png_create_write_struct(PNG_LIBPNG_VER_STRING, Q_NULLPTR, Q_NULLPTR, Q_NULLPTR);
+    png_infop pInfo  = png_create_info_struct(pPng);
+    if(setjmp(png_jmpbuf(pPng))) {
+        png_destroy_write_struct(&pPng, &pInfo);
+        fclose(pFile);
+        return false;
+    }
+    png_init_io(pPng, pFile);
+    png_set_compression_level(pPng, 1);
+    png_set_IHDR(pPng, pInfo, png_uint_32(width), png_uint_32(height), 8,
+                 PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(pPng, pInfo);
+    QByteArray row(3*width, 0);
+    for(int y=0; y<height; y++) {
+        syntheticRow(y, width, height, reinterpret_cast<uchar*>(row.data()));
+        png_write_row(pPng, reinterpret_cast<png_const_bytep>(row.constData()));
+    }
+    png_write_end(pPng, pInfo);
+    png_destroy_write_struct(&pPng, &pInfo);
+    fclose(pFile);
+    return true;
+}
+
+
+// A "Vm..." field of /proc/self/status in bytes (-1 if unknown)
+qint64
+DecodeBench::statusBytes(const char* sField) {
+    QFile status("/proc/self/status");
+    if(!status.open(QIODevice::ReadOnly))
+        return -1;
+    QList<QByteArray> lines = status.readAll().split('\n');
+    for(int i=0; i<lines.count(); i++) {
+        if(lines.at(i).startsWith(sField))
+            return lines.at(i).mid(int(strlen(sField))).trimmed().split(' ').first().toLongLong()*1024;
+    }
+    return -1;
+}
+
+
+// 2, 12 and 24 Mpixel images, landscape and portrait, as JPEG and PNG.
+// Files already present in sDir are reused.
+bool
+DecodeBench::createCorpus(QString sDir) {
+    const int sizes[][3] = {
+        {  2, 1600, 1200 },
+        { 12, 4000, 3000 },
+        { 24, 6000, 4000 }
+    };
+    const char* formats[] = { "jpg", "png" };
+    QDir().mkpath(sDir);
+    for(int i=0; i<3; i++) {
+        for(int portrait=0; portrait<2; portrait++) {
+            int width  = portrait ? sizes[i][2] : sizes[i][1];
+            int height = portrait ? sizes[i][1] : sizes[i][2];
+            QImage image;
+            for(int f=0; f<2; f++) {
+                QString sFile = QString("%1/%2mp-%3.%4")
+                        .arg(sDir)
+                        .arg(sizes[i][0])
+                        .arg(portrait ? "portrait" : "landscape")
+                        .arg(formats[f]);
+                corpus.append(sFile);
+                if(QFile::exists(sFile))
+                    continue;
+                if(image.isNull())
+                    image = syntheticImage(width, height);
+                if(!image.save(sFile, formats[f], 90)) {
+                    qCritical() << "Unable to write" << sFile;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+// The composition made by SlideWindow before letterboxFlip()
+QImage
+DecodeBench::paintFrame(const QImage& scaled, const Screen& screen) {
+    QImage frame(screen.width, screen.height, QImage::Format_RGBA8888_Premultiplied);
+    QImage mirrored = scaled.mirrored();
+    QPainter painter(&frame);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(0, 0, screen.width, screen.height, Qt::white);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.drawImage((screen.width-mirrored.width())/2, (screen.height-mirrored.height())/2, mirrored);
+    painter.end();
+    return frame;
+}
+
+
+int
+DecodeBench::maxDifference(const QImage& a, const QImage& b) {
+    if((a.size() != b.size()) || (a.format() != b.format()))
+        return 256;
+    int maxDiff = 0;
+    for(int y=0; y<a.height(); y++) {
+        const uchar* pA = a.constScanLine(y);
+        const uchar* pB = b.constScanLine(y);
+        for(int x=0; x<4*a.width(); x++)
+            maxDiff = qMax(maxDiff, qAbs(int(pA[x]) - int(pB[x])));
+    }
+    return maxDiff;
+}
+
+
+void
+DecodeBench::report(QString sImage, const Screen& screen, QString sStage,
+                    QVector<qint64> times, qint64 nAllocations, qint64 allocBytes)
+{
+    std::sort(times.begin(), times.end());
+    fprintf(pOut,
+            "{\"image\":\"%s\",\"screen\":\"%dx%d\",\"stage\":\"%s\","
+            "\"iterations\":%d,\"min_us\":%lld,\"median_us\":%lld,\"max_us\":%lld,"
+            "\"allocs\":%lld,\"alloc_bytes\":%lld}\n",
+            sImage.toUtf8().constData(), screen.width, screen.height,
+            sStage.toUtf8().constData(),
+            times.count(), times.first(), times.at(times.count()/2), times.last(),
+            nAllocations, allocBytes);
+    fflush(pOut);
+}
+
+
+void
+DecodeBench::check(QString sImage, const Screen& screen, QString sCheck, bool bPassed, QString sDetail) {
+    if(!bPassed)
+        nFailed++;
+    fprintf(pOut,
+            "{\"image\":\"%s\",\"screen\":\"%dx%d\",\"check\":\"%s\",\"passed\":%s,\"detail\":\"%s\"}\n",
+            sImage.toUtf8().constData(), screen.width, screen.height,
+            sCheck.toUtf8().constData(), bPassed ? "true" : "false",
+            sDetail.toUtf8().constData());
+    fflush(pOut);
+}
+
+
+// Time nIterations runs of stage(); allocations are those of a single run
+template <typename Stage>
+void
+DecodeBench::measure(QString sImage, const Screen& screen, QString sStage, Stage stage) {
+    QVector<qint64> times;
+    qint64 nAllocations = 0;
+    qint64 allocBytes   = 0;
+    QElapsedTimer timer;
+    for(int i=0; i<nIterations; i++) {
+        if(i == 0)
+            AllocCounter::start();
+        timer.start();
+        stage();
+        times.append(timer.nsecsElapsed()/1000);
+        if(i == 0) {
+            AllocCounter::stop();
+            nAllocations = AllocCounter::allocations();
+            allocBytes   = AllocCounter::bytes();
+        }
+    }
+    report(sImage, screen, sStage, times, nAllocations, allocBytes);
+}
+
+
+void
+DecodeBench::run() {
+    for(int i=0; i<corpus.count(); i++) {
+        QString sFile  = corpus.at(i);
+        QString sImage = QFileInfo(sFile).fileName();
+        bool bJpeg = JpegDecoder::isJpeg(sFile);
+        QByteArray content;
+        QImage full;
+        for(int s=0; s<screens.count(); s++) {
+            const Screen& screen = screens.at(s);
+            // Screen independent stages: only once per image
+            if(s == 0) {
+                measure(sImage, screen, "read", [&]() {
+                    QFile file(sFile);
+                    file.open(QIODevice::ReadOnly);
+                    content = file.readAll();
+                });
+                measure(sImage, screen, "qimage_load", [&]() {
+                    full = QImage::fromData(content);
+                });
+            }
+            QImage decoded;
+            if(bJpeg) {
+                measure(sImage, screen, "jpeg_dct_scaled", [&]() {
+                    JpegDecoder::decode(sFile, screen.width, screen.height, &decoded);
+                });
+            }
+            QImage scaled;
+            measure(sImage, screen, "scaled", [&]() {
+                scaled = full.scaled(screen.width, screen.height, Qt::KeepAspectRatio);
+            });
+            if(bJpeg) {
+                measure(sImage, screen, "scaled_from_dct", [&]() {
+                    decoded.scaled(screen.width, screen.height, Qt::KeepAspectRatio);
+                });
+            }
+            measure(sImage, screen, "mirrored", [&]() {
+                scaled.mirrored();
+            });
+            measure(sImage, screen, "qpainter_letterbox", [&]() {
+                paintFrame(scaled, screen);
+            });
+            QImage converted;
+            measure(sImage, screen, "convert_rgba_premultiplied", [&]() {
+                converted = scaled.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+            });
+            QImage flipped(screen.width, screen.height, QImage::Format_RGBA8888_Premultiplied);
+            measure(sImage, screen, "letterbox_flip", [&]() {
+                letterboxFlip(converted.constBits(), converted.width(), converted.height(),
+                              converted.bytesPerLine(), false,
+                              flipped.bits(), flipped.width(), flipped.height(),
+                              flipped.bytesPerLine());
+            });
+            SlideLoader loader;
+            loader.setScreenSize(screen.width, screen.height);
+            QImage frame;
+            measure(sImage, screen, "slideloader_total", [&]() {
+                loader.load(sFile, &frame);
+            });
+            QVector<unsigned short> rgb565(frame.width()*frame.height());
+            measure(sImage, screen, "rgb565_dither", [&]() {
+                for(int y=0; y<frame.height(); y++)
+                    rgb565Row(frame.constScanLine(y), rgb565.data()+y*frame.width(), frame.width(), y);
+            });
+            measure(sImage, screen, "qimage_rgb16", [&]() {
+                frame.convertToFormat(QImage::Format_RGB16);
+            });
+
+            check(sImage, screen, "slideloader_frame_size",
+                  (frame.width() == screen.width) && (frame.height() == screen.height),
+                  QString("%1x%2").arg(frame.width()).arg(frame.height()));
+            // Exactly the decoded image scaled to fit (nearest pixels),
+            // flipped and letterboxed: a wrong orientation, a mirrored
+            // or shifted picture is caught
+            QImage loaded;
+            loader.decode(sFile, screen.width, screen.height, &loaded);
+            QSize fitted = loaded.size().scaled(screen.width, screen.height, Qt::KeepAspectRatio);
+            QImage expectedScaled = nearestScaled(loaded.convertToFormat(QImage::Format_RGBA8888_Premultiplied),
+                                                  fitted.width(), fitted.height());
+            QImage expected(screen.width, screen.height, QImage::Format_RGBA8888_Premultiplied);
+            letterboxFlip(expectedScaled.constBits(), expectedScaled.width(), expectedScaled.height(),
+                          expectedScaled.bytesPerLine(), false,
+                          expected.bits(), expected.width(), expected.height(),
+                          expected.bytesPerLine());
+            int frameDiff = maxDifference(frame, expected);
+            check(sImage, screen, "slideloader_vs_letterbox_flip", frameDiff == 0,
+                  QString("max channel difference %1").arg(frameDiff));
+        }
+    }
+}
+
+
+// Several outputs sharing a DecodePool: a file wanted by all of them
+// must be decoded once and scaled once for each distinct resolution
+void
+DecodeBench::runPoolChecks() {
+    QStringList sFiles;
+    for(int i=0; i<corpus.count(); i++) {
+        if(QFileInfo(corpus.at(i)).fileName().startsWith("2mp"))
+            sFiles.append(corpus.at(i));
+    }
+    const Screen& small = screens.first();
+    const Screen& large = screens.last();
+
+    // Two outputs with the same resolution
+    {
+        DecodePool pool(2);
+        int iFirst  = pool.addClient();
+        int iSecond = pool.addClient();
+        pool.setScreenSize(iFirst,  small.width, small.height);
+        pool.setScreenSize(iSecond, small.width, small.height);
+        pool.schedule(iFirst,  sFiles);
+        pool.schedule(iSecond, sFiles);
+        bool bSizesOk = true;
+        for(int i=0; i<sFiles.count(); i++) {
+            QImage first  = pool.takeSlide(iFirst,  sFiles.at(i));
+            QImage second = pool.takeSlide(iSecond, sFiles.at(i));
+            bSizesOk &= (first.size()  == QSize(small.width, small.height)) &&
+                        (second.size() == QSize(small.width, small.height));
+        }
+        // A cache miss is counted once, by the worker (not again
+        // by a takeSlide() waiting for it)
+        check("pool", small, "pool_same_resolution_decodes",
+              bSizesOk &&
+              (pool.decodedFiles() == sFiles.count()) &&
+              (pool.slideCache()->misses() == sFiles.count()),
+              QString("%1 files %2 decodes %3 cache misses")
+                  .arg(sFiles.count()).arg(pool.decodedFiles()).arg(pool.slideCache()->misses()));
+    }
+
+    // Two outputs with different resolutions, as their own timers
+    // drive them: the second one shows every slide two slides later,
+    // its prefetch window slides at other times. Every file must
+    // still be decoded only once (the cache holds all the frames).
+    {
+        DecodePool pool(2);
+        pool.slideCache()->setBudget(2*4*qint64(small.width*small.height + large.width*large.height)*sFiles.count());
+        int iFirst  = pool.addClient();
+        int iSecond = pool.addClient();
+        pool.setScreenSize(iFirst,  small.width, small.height);
+        pool.setScreenSize(iSecond, large.width, large.height);
+        const int depth = 2;
+        const int lag   = 2;
+        bool bSizesOk = true;
+        for(int i=0; i<sFiles.count()+lag; i++) {
+            if(i < sFiles.count()) {
+                pool.schedule(iFirst, sFiles.mid(i, depth));
+                QImage first = pool.takeSlide(iFirst, sFiles.at(i));
+                bSizesOk &= first.size() == QSize(small.width, small.height);
+            }
+            if(i >= lag) {
+                pool.schedule(iSecond, sFiles.mid(i-lag, depth));
+                QImage second = pool.takeSlide(iSecond, sFiles.at(i-lag));
+                bSizesOk &= second.size() == QSize(large.width, large.height);
+            }
+        }
+        check("pool", large, "pool_mixed_resolution_decodes",
+              bSizesOk &&
+              (pool.decodedFiles() == sFiles.count()) &&
+              (pool.composedFrames() == 2*sFiles.count()),
+              QString("%1 files %2 decodes %3 frames")
+                  .arg(sFiles.count()).arg(pool.decodedFiles()).arg(pool.composedFrames()));
+    }
+
+    // One decode for several screens gives the frames of single
+    // screen loads (exactly for the largest: same decoded image)
+    SlideLoader loader;
+    QVector<QSize> sizes;
+    for(int s=0; s<screens.count(); s++)
+        sizes.append(QSize(screens.at(s).width, screens.at(s).height));
+    for(int i=0; i<sFiles.count(); i++) {
+        QVector<QImage> frames;
+        loader.load(sFiles.at(i), sizes, &frames);
+        QImage single;
+        loader.setScreenSize(large.width, large.height);
+        loader.load(sFiles.at(i), &single);
+        bool bSizesOk = frames.count() == sizes.count();
+        for(int s=0; bSizesOk && (s<sizes.count()); s++)
+            bSizesOk = frames.at(s).size() == sizes.at(s);
+        int maxDiff = bSizesOk ? maxDifference(frames.last(), single) : 256;
+        check(QFileInfo(sFiles.at(i)).fileName(), large, "slideloader_multi_vs_single",
+              bSizesOk && (maxDiff == 0),
+              QString("max channel difference %1").arg(maxDiff));
+    }
+}
+
+
+// A synthetic Motion JPEG clip streamed through an AnimatedSlide:
+// the frames come in order and are never decoded much ahead
+void
+DecodeBench::runAnimationChecks(QString sDir) {
+    const int nClipFrames = 24;
+    const Screen& screen = screens.first();
+    QString sClip = sDir + QString("/clip.mjpeg");
+    QFile clip(sClip);
+    if(!clip.open(QIODevice::WriteOnly)) {
+        check("clip.mjpeg", screen, "animation_clip_written", false, sClip);
+        return;
+    }
+    QImage background = syntheticImage(640, 360);
+    for(int i=0; i<nClipFrames; i++) {
+        QImage frame = background;
+        QPainter painter(&frame);// A moving square over a still background
+        painter.fillRect(20*i, 100, 40, 40, Qt::red);
+        painter.end();
+        frame.save(&clip, "JPEG", 90);
+    }
+    clip.close();
+
+    AnimatedSlide animation;
+    animation.open(sClip, screen.width, screen.height);
+    animation.play(0);
+    int nShown = 0;
+    int maxAhead = 0;
+    int maxRows  = 0;
+    bool bSizesOk = true;
+    QElapsedTimer timeout;
+    timeout.start();
+    qint64 now = 0;
+    while((nShown < 2*nClipFrames) && (timeout.elapsed() < 30000)) {
+        int firstRow, nRows;
+        const QImage* pFrame = animation.takeDueFrame(now, &firstRow, &nRows);
+        if(!pFrame) {
+            QThread::msleep(1);
+            continue;
+        }
+        bSizesOk &= (pFrame->width() == screen.width) && (pFrame->height() == screen.height);
+        if(nShown > 0)
+            maxRows = qMax(maxRows, nRows);
+        maxAhead = qMax(maxAhead, animation.decodedFrames() - nShown);
+        animation.releaseFrame();
+        nShown++;
+        now += 40000;// The clip frame time
+    }
+    animation.close();
+    check("clip.mjpeg", screen, "animation_frames_streamed",
+          bSizesOk && (nShown == 2*nClipFrames),
+          QString("%1 frames shown (clip played twice)").arg(nShown));
+    check("clip.mjpeg", screen, "animation_ring_bounded",
+          maxAhead <= ANIMATION_RING_FRAMES,
+          QString("at most %1 frames decoded ahead").arg(maxAhead));
+    check("clip.mjpeg", screen, "animation_changed_rows",
+          (maxRows > 0) && (maxRows < screen.height),
+          QString("at most %1 rows uploaded after the first frame").arg(maxRows));
+}
+
+
+// A 108 Mpixel panorama, as JPEG and PNG, prepared for the largest
+// screen: the peak resident memory must stay below the loader limit
+void
+DecodeBench::runStripChecks(QString sDir) {
+    const int width  = 18000;
+    const int height = 6000;
+    const qint64 memoryLimit = 64*1024*1024;
+    const Screen& screen = screens.last();
+    QStringList sFiles;
+    sFiles << sDir + QString("/panorama.jpg") << sDir + QString("/panorama.png");
+    if(!QFile::exists(sFiles.at(0)) && !writeLargeJpeg(sFiles.at(0), width, height))
+        qCritical() << "Unable to write" << sFiles.at(0);
+    if(!QFile::exists(sFiles.at(1)) && !writeLargePng(sFiles.at(1), width, height))
+        qCritical() << "Unable to write" << sFiles.at(1);
+    for(int i=0; i<sFiles.count(); i++) {
+        QString sImage = QFileInfo(sFiles.at(i)).fileName();
+        SlideLoader loader;
+        loader.setScreenSize(screen.width, screen.height);
+        loader.setMemoryLimit(memoryLimit);
+        QImage frame;
+        // Writing 5 resets the peak resident set size (VmHWM)
+        QFile clearRefs("/proc/self/clear_refs");
+        bool bReset = clearRefs.open(QIODevice::WriteOnly) && (clearRefs.write("5") == 1);
+        clearRefs.close();
+        qint64 baseRss = statusBytes("VmRSS:");
+        QElapsedTimer timer;
+        timer.start();
+        bool bLoaded = loader.load(sFiles.at(i), &frame);
+        qint64 elapsed = timer.elapsed();
+        qint64 peakRss = statusBytes("VmHWM:");
+        check(sImage, screen, "strip_decode_frame",
+              bLoaded && (frame.width() == screen.width) && (frame.height() == screen.height),
+              QString("%1x%2 in %3 ms").arg(frame.width()).arg(frame.height()).arg(elapsed));
+        if(!bReset || (baseRss < 0) || (peakRss < 0)) {
+            check(sImage, screen, "strip_decode_peak_rss", true, "not measurable here: skipped");
+            continue;
+        }
+        check(sImage, screen, "strip_decode_peak_rss",
+              peakRss - baseRss <= memoryLimit,
+              QString("peak growth %1 MB, limit %2 MB")
+                  .arg((peakRss - baseRss)/(1024*1024))
+                  .arg(memoryLimit/(1024*1024)));
+    }
+
+    // A 24 MP progressive JPEG keeps 72 MB of coefficients whatever the
+    // scale: with 100 MB it is decoded smaller, to stay within the
+    // limit, and with 64 MB it goes over it rather than being lost
+    QTemporaryDir progressiveDir;
+    QString sProgressive = progressiveDir.path() + QString("/progressive.jpg");
+    QString sImage = QFileInfo(sProgressive).fileName();
+    if(!writeLargeJpeg(sProgressive, 6000, 4000, true)) {
+        check(sImage, screen, "strip_decode_progressive", false, "unable to write the image");
+        return;
+    }
+    const qint64 progressiveLimits[] = { 100*1024*1024, 64*1024*1024 };
+    for(int i=0; i<2; i++) {
+        SlideLoader loader;
+        loader.setScreenSize(screen.width, screen.height);
+        loader.setMemoryLimit(progressiveLimits[i]);
+        QImage frame;
+        QFile clearRefs("/proc/self/clear_refs");
+        bool bReset = clearRefs.open(QIODevice::WriteOnly) && (clearRefs.write("5") == 1);
+        clearRefs.close();
+        qint64 baseRss = statusBytes("VmRSS:");
+        bool bLoaded = loader.load(sProgressive, &frame);
+        qint64 peakRss = statusBytes("VmHWM:");
+        bool bMeasured = bReset && (baseRss >= 0) && (peakRss >= 0);
+        bool bWithin = !bMeasured || (i > 0) || (peakRss - baseRss <= progressiveLimits[i]);
+        check(sImage, screen, "strip_decode_progressive",
+              bLoaded && (frame.width() == screen.width) && (frame.height() == screen.height) && bWithin,
+              QString("limit %1 MB: %2x%3, peak growth %4 MB")
+                  .arg(progressiveLimits[i]/(1024*1024)).arg(frame.width()).arg(frame.height())
+                  .arg(bMeasured ? (peakRss - baseRss)/(1024*1024) : -1));
+    }
+}
+
+
+// The ETC1 encoder: size, quality on the synthetic slides at every
+// screen, time, and the compressed slides kept in the disk cache
+void
+DecodeBench::runEtc1Checks() {
+    for(int s=0; s<screens.count(); s++) {
+        const Screen& screen = screens.at(s);
+        QImage frame = syntheticImage(screen.width, screen.height)
+                       .convertToFormat(QImage::Format_RGBX8888);
+        Etc1Texture texture;
+        QElapsedTimer timer;
+        timer.start();
+        bool bOk = Etc1Encoder::compress(frame, false, &texture);
+        qint64 elapsed = timer.elapsed();
+        int expectedBytes = ((screen.width+3)/4) * ((screen.height+3)/4) * ETC1_BLOCK_BYTES;
+        check("synthetic", screen, "etc1_data_size",
+              bOk && (texture.levels.count() == 1) && (texture.levels.first().size() == expectedBytes),
+              QString("%1 bytes (RGBA %2) in %3 ms")
+                  .arg(bOk ? texture.levels.first().size() : 0)
+                  .arg(4*screen.width*screen.height).arg(elapsed));
+        double quality = bOk ? Etc1Encoder::psnr(frame, texture) : 0.0;
+        check("synthetic", screen, "etc1_psnr", quality >= 30.0,
+              QString("%1 dB").arg(quality, 0, 'f', 2));
+    }
+
+    // A solid color survives the round trip almost unchanged
+    const Screen& screen = screens.first();
+    QImage solid(screen.width, screen.height, QImage::Format_RGBX8888);
+    solid.fill(QColor(200, 120, 40));
+    Etc1Texture texture;
+    Etc1Encoder::compress(solid, true, &texture);
+    QImage decoded(screen.width, screen.height, QImage::Format_RGBX8888);
+    etc1Decode(reinterpret_cast<const unsigned char*>(texture.levels.first().constData()),
+               screen.width, screen.height, decoded.bits(), decoded.bytesPerLine());
+    int maxDiff = maxDifference(solid, decoded);
+    check("solid", screen, "etc1_solid_round_trip", maxDiff <= 4,
+          QString("max channel difference %1, %2 levels").arg(maxDiff).arg(texture.levels.count()));
+
+    // Stored and found again, level by level, in a cache of its own
+    // (not left in the corpus). The ETC1 lookups have their own counts.
+    QTemporaryDir cacheDir;
+    SlideDiskCache cache;
+    cache.setDirectory(cacheDir.path());
+    QString sFile = corpus.isEmpty() ? QString() : corpus.first();
+    QVector<QByteArray> levels;
+    bool bMissed = !cache.findCompressed(sFile, screen.width, screen.height, texture.levels.count(), &levels);
+    bool bStored = cache.storeCompressed(sFile, screen.width, screen.height, texture.levels);
+    bool bFound  = cache.findCompressed(sFile, screen.width, screen.height, texture.levels.count(), &levels);
+    check("solid", screen, "etc1_disk_cache_round_trip",
+          cacheDir.isValid() && bMissed && bStored && bFound && (levels == texture.levels),
+          QString("missed %1 stored %2 found %3").arg(bMissed).arg(bStored).arg(bFound));
+    bool bCounted = (cache.compressedHits() == 1) && (cache.compressedMisses() == 1) &&
+                    (cache.staleCompressedEntries() == 0) &&
+                    (cache.hits() == 0) && (cache.misses() == 0) && (cache.staleEntries() == 0);
+    check("solid", screen, "etc1_disk_cache_counts", bCounted,
+          QString("ETC1 %1 hits %2 misses, slides %3 hits %4 misses")
+              .arg(cache.compressedHits()).arg(cache.compressedMisses())
+              .arg(cache.hits()).arg(cache.misses()));
+
+    // Pure noise is rejected by the quality check, and only
+    // compressed the first time it is shown
+    QImage noise(256, 256, QImage::Format_RGBX8888);
+    quint32 seed = 54321;
+    for(int y=0; y<noise.height(); y++) {
+        uchar* pRow = noise.scanLine(y);
+        for(int x=0; x<4*noise.width(); x++) {
+            seed = seed*1103515245 + 12345;
+            pRow[x] = ((x & 3) == 3) ? 255 : uchar(seed >> 16);
+        }
+    }
+    Etc1Encoder encoder;
+    Etc1Texture taken;
+    encoder.encode(sFile, noise);
+    bool bFirstTaken = encoder.takeTexture(&taken);
+    encoder.encode(sFile, noise);
+    bool bAgainTaken = encoder.takeTexture(&taken);
+    encoder.stop();
+    check("noise", screen, "etc1_rejection_remembered",
+          !bFirstTaken && !bAgainTaken &&
+          (encoder.rejectedSlides() == 1) && (encoder.encodeStatistics()->frames() == 1),
+          QString("%1 rejected, %2 compressed")
+              .arg(encoder.rejectedSlides()).arg(encoder.encodeStatistics()->frames()));
+}
+
+
+// The disk cache within its budget: room for two and a half small
+// frames, so that writing a third removes the least recently used,
+// a changed slide has its entry removed as soon as found stale and
+// the entries left are counted again at the next start
+void
+DecodeBench::runDiskCacheChecks() {
+    const Screen& screen = screens.first();
+    QTemporaryDir sourceDir;
+    QTemporaryDir cacheDir;
+    QImage frame(64, 48, QImage::Format_RGBX8888);
+    frame.fill(Qt::gray);
+    const qint64 entryBytes = 4096 + qint64(frame.bytesPerLine())*frame.height();
+    QStringList sFiles;
+    for(int i=0; i<3; i++) {
+        sFiles.append(sourceDir.path()+QString("/slide%1.jpg").arg(i));
+        QFile source(sFiles.last());
+        source.open(QIODevice::WriteOnly);
+        source.write(QByteArray(100, char(i)));
+    }
+    SlideDiskCache cache;
+    cache.setBudget(2*entryBytes + entryBytes/2);
+    cache.setDirectory(cacheDir.path());
+    QImage found;
+    cache.store(sFiles.at(0), frame);
+    cache.store(sFiles.at(1), frame);
+    bool bFirst = cache.find(sFiles.at(0), frame.width(), frame.height(), &found);
+    cache.store(sFiles.at(2), frame);
+    bool bEvicted = !cache.find(sFiles.at(1), frame.width(), frame.height(), &found);
+    bool bKept    = cache.find(sFiles.at(0), frame.width(), frame.height(), &found) &&
+                    cache.find(sFiles.at(2), frame.width(), frame.height(), &found);
+    check("gray", screen, "disk_cache_evicts_oldest",
+          cacheDir.isValid() && bFirst && bEvicted && bKept &&
+          (cache.evictions() == 1) && (cache.bytesUsed() == 2*entryBytes),
+          QString("%1 evictions, %2 bytes used of %3")
+              .arg(cache.evictions()).arg(cache.bytesUsed()).arg(cache.budget()));
+
+    // A changed slide: its entry goes at once
+    QFile source(sFiles.at(0));
+    source.open(QIODevice::Append);
+    source.write(QByteArray(10, 'x'));
+    source.close();
+    bool bStale = !cache.find(sFiles.at(0), frame.width(), frame.height(), &found);
+    check("gray", screen, "disk_cache_removes_stale",
+          bStale && (cache.staleEntries() == 1) && (cache.bytesUsed() == entryBytes),
+          QString("%1 stale, %2 bytes used").arg(cache.staleEntries()).arg(cache.bytesUsed()));
+
+    // Restarted: the entry left is found on disk, and a smaller budget removes it
+    SlideDiskCache restarted;
+    restarted.setDirectory(cacheDir.path());
+    qint64 scannedBytes = restarted.bytesUsed();
+    restarted.setBudget(0);
+    check("gray", screen, "disk_cache_rescanned",
+          (scannedBytes == entryBytes) && (restarted.bytesUsed() == 0) && (restarted.evictions() == 1) &&
+          !restarted.find(sFiles.at(2), frame.width(), frame.height(), &found),
+          QString("%1 bytes found at start, %2 evictions").arg(scannedBytes).arg(restarted.evictions()));
+}
+
+
+// A slow gradient from black to white, four pixels for every level:
+// the dither must keep the average of every 4x4 block (expanded back
+// to 8 bits as the GPU does) within half a 5 or 6 bit step of the
+// original, where plain truncation is off by up to a whole step (the
+// bands)
+void
+DecodeBench::runRgb565Checks() {
+    const int width  = 1024;
+    const int height = 64;
+    const Screen& screen = screens.first();
+    QImage gradient(width, height, QImage::Format_RGBX8888);
+    for(int y=0; y<height; y++) {
+        uchar* pRow = gradient.scanLine(y);
+        for(int x=0; x<width; x++) {
+            pRow[4*x] = pRow[4*x+1] = pRow[4*x+2] = uchar(x*256/width);
+            pRow[4*x+3] = 255;
+        }
+    }
+    QVector<unsigned short> converted(width*height);
+    for(int y=0; y<height; y++)
+        rgb565Row(gradient.constScanLine(y), converted.data()+y*width, width, y);
+    double maxError[3] = { 0.0, 0.0, 0.0 };
+    for(int by=0; by<height; by+=4) {
+        for(int bx=0; bx<width; bx+=4) {
+            double original = 0.0;
+            double sums[3]  = { 0.0, 0.0, 0.0 };
+            for(int y=by; y<by+4; y++) {
+                for(int x=bx; x<bx+4; x++) {
+                    unsigned short pixel = converted.at(y*width+x);
+                    original += gradient.constScanLine(y)[4*x];
+                    sums[0] += (pixel >> 11)*255.0/31.0;
+                    sums[1] += ((pixel >> 5) & 63)*255.0/63.0;
+                    sums[2] += (pixel & 31)*255.0/31.0;
+                }
+            }
+            for(int c=0; c<3; c++)
+                maxError[c] = qMax(maxError[c], qAbs(sums[c]-original)/16.0);
+        }
+    }
+    check("gradient", screen, "rgb565_dither_block_average",
+          (maxError[0] <= 4.0) && (maxError[1] <= 2.0) && (maxError[2] <= 4.0),
+          QString("max block average error R %1 G %2 B %3")
+              .arg(maxError[0]).arg(maxError[1]).arg(maxError[2]));
+
+    // Converting a band must give the rows of the whole frame
+    QVector<unsigned short> band(width*4);
+    for(int y=0; y<4; y++)
+        rgb565Row(gradient.constScanLine(21+y), band.data()+y*width, width, 21+y);
+    bool bSame = memcmp(band.constData(), converted.constData()+21*width, band.size()*sizeof(unsigned short)) == 0;
+    check("gradient", screen, "rgb565_band_matches_frame", bSame, bSame ? "identical" : "different");
+
+    // The vector body (8 pixels with SSE2, 16 with NEON) and the tail
+    // must give exactly the scalar result: every width up to three
+    // vectors and more, all the dither rows, random and extreme bytes
+    const int maxWidth = 67;
+    QVector<uchar> pixels(4*maxWidth);
+    QVector<unsigned short> vectorRow(maxWidth+1);
+    QVector<unsigned short> scalarRow(maxWidth+1);
+    quint32 seed = 4321;
+    int nDifferent = 0;
+    for(int n=1; n<=maxWidth; n++) {
+        for(int y=0; y<4; y++) {
+            for(int i=0; i<pixels.count(); i++) {
+                seed = seed*1103515245 + 12345;
+                int value = int((seed >> 16) & 0x3ff);
+                pixels[i] = uchar((value < 256) ? 0 : (value < 512) ? 255 : value & 0xff);
+            }
+            vectorRow.fill(0xdead);
+            scalarRow.fill(0xdead);
+            rgb565Row(pixels.constData(), vectorRow.data(), n, y);
+            rgb565RowScalar(pixels.constData(), scalarRow.data(), n, y);
+            if(vectorRow != scalarRow)
+                nDifferent++;
+        }
+    }
+    check("random", screen, "rgb565_vector_matches_scalar", nDifferent == 0,
+          QString("%1 of %2 rows different").arg(nDifferent).arg(4*maxWidth));
+}
+
+
+// letterboxFlip() must give exactly the QPainter composition: opaque
+// slides scaled by Qt (as SlideLoader did before it) on every screen,
+// letterboxed and pillarboxed, and translucent premultiplied pixels,
+// from RGBA and from BGRA bytes. letterboxScaleFlip() must give exactly
+// the nearest scaled image composed by letterboxFlip(): reduced,
+// enlarged (repeated rows), stretched one way only.
+void
+DecodeBench::runLetterboxChecks() {
+    const int slideSizes[][2] = {
+        { 1000, 700 },// Landscape
+        { 700, 1000 } // Portrait
+    };
+    for(int i=0; i<2; i++) {
+        QImage full = syntheticImage(slideSizes[i][0], slideSizes[i][1]);
+        QString sImage = QString("synthetic-%1x%2").arg(full.width()).arg(full.height());
+        for(int s=0; s<screens.count(); s++) {
+            const Screen& current = screens.at(s);
+            QImage scaled = full.scaled(current.width, current.height, Qt::KeepAspectRatio);
+            QImage converted = scaled.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+            QImage flipped(current.width, current.height, QImage::Format_RGBA8888_Premultiplied);
+            letterboxFlip(converted.constBits(), converted.width(), converted.height(),
+                          converted.bytesPerLine(), false,
+                          flipped.bits(), flipped.width(), flipped.height(),
+                          flipped.bytesPerLine());
+            int maxDiff = maxDifference(flipped, paintFrame(scaled, current));
+            check(sImage, current, "letterbox_flip_vs_qpainter", maxDiff == 0,
+                  QString("max channel difference %1").arg(maxDiff));
+        }
+    }
+
+    const Screen& screen = screens.first();
+    QImage source = translucentImage(333, 217);
+    QImage painted = paintFrame(source, screen);
+    for(int swap=0; swap<2; swap++) {
+        QImage converted = swap ? source.convertToFormat(QImage::Format_ARGB32_Premultiplied) : source;
+        QImage flipped(screen.width, screen.height, QImage::Format_RGBA8888_Premultiplied);
+        letterboxFlip(converted.constBits(), converted.width(), converted.height(),
+                      converted.bytesPerLine(), swap != 0,
+                      flipped.bits(), flipped.width(), flipped.height(),
+                      flipped.bytesPerLine());
+        int maxDiff = maxDifference(flipped, painted);
+        check("translucent-333x217", screen,
+              swap ? "letterbox_flip_swap_rb_vs_qpainter" : "letterbox_flip_translucent_vs_qpainter",
+              maxDiff == 0, QString("max channel difference %1").arg(maxDiff));
+    }
+    const int sizes[][2] = {
+        { 200, 130 },// Reduced
+        { 700, 456 },// Enlarged
+        { 800, 150 },// Wider and shorter
+        { 333, 217 },// Same size
+        {   1,   1 }
+    };
+    for(int i=0; i<5; i++) {
+        int width  = sizes[i][0];
+        int height = sizes[i][1];
+        QImage scaled = nearestScaled(source, width, height);
+        for(int swap=0; swap<2; swap++) {
+            QImage expected(screen.width, screen.height, QImage::Format_RGBA8888_Premultiplied);
+            letterboxFlip(scaled.constBits(), scaled.width(), scaled.height(),
+                          scaled.bytesPerLine(), swap != 0,
+                          expected.bits(), expected.width(), expected.height(),
+                          expected.bytesPerLine());
+            QImage frame(screen.width, screen.height, QImage::Format_RGBA8888_Premultiplied);
+            letterboxScaleFlip(source.constBits(), source.width(), source.height(),
+                               source.bytesPerLine(), swap != 0, width, height,
+                               frame.bits(), frame.width(), frame.height(),
+                               frame.bytesPerLine());
+            int maxDiff = maxDifference(frame, expected);
+            check(QString("translucent-333x217-to-%1x%2").arg(width).arg(height), screen,
+                  swap ? "letterbox_scale_flip_swap_rb_exact" : "letterbox_scale_flip_exact",
+                  maxDiff == 0, QString("max channel difference %1").arg(maxDiff));
+        }
+    }
+}
+
+
+// Once the FramePool holds the working set, preparing a slide must
+// allocate no pixel buffer: no new pool buffer, no allocation of
+// FRAME_SIZED_BYTES or more and only a few small ones (the file, the
+// reader, the decoder state), whether the slides are loaded directly
+// or go through the prefetcher, the SlideCache and the RGB565 upload
+// conversion. Progressive JPEGs are the exception libjpeg imposes.
+// Images decoded in strips are left out: they have their own buffers.
+void
+DecodeBench::runSteadyStateChecks() {
+    const Screen& screen = screens.last();
+    SlideLoader loader;
+    loader.setScreenSize(screen.width, screen.height);
+    qint64 decodeLimit = loader.memoryLimit() - 2*4*qint64(screen.width)*screen.height;
+    QStringList sFiles;
+    for(int i=0; i<corpus.count(); i++) {
+        if(JpegDecoder::isJpeg(corpus.at(i)) || (StripDecoder::fullDecodeBytes(corpus.at(i)) <= decodeLimit))
+            sFiles.append(corpus.at(i));
+    }
+    int nSlides = qMax(1, sFiles.count());
+    qint64 frameBytes = 4*qint64(screen.width)*screen.height;
+    FramePool* pPool = FramePool::instance();
+    qint64 oldBudget = pPool->budget();
+    pPool->setBudget(qint64(512)*1024*1024);
+    QImage frame;
+    for(int pass=0; pass<2; pass++) {// Warm up
+        for(int i=0; i<sFiles.count(); i++)
+            loader.load(sFiles.at(i), &frame);
+    }
+    int nPoolAllocations = pPool->allocations();
+    AllocCounter::start(FRAME_SIZED_BYTES);
+    for(int i=0; i<sFiles.count(); i++)
+        loader.load(sFiles.at(i), &frame);
+    AllocCounter::stop();
+    qint64 nLarge = AllocCounter::allocations();
+    nPoolAllocations = pPool->allocations() - nPoolAllocations;
+    check("corpus", screen, "steady_state_frame_allocations",
+          (nLarge == 0) && (nPoolAllocations == 0),
+          QString("%1 slides: %2 allocations of %3 KB or more, %4 new pool buffers")
+              .arg(sFiles.count()).arg(nLarge).arg(FRAME_SIZED_BYTES/1024).arg(nPoolAllocations));
+
+    AllocCounter::start();
+    for(int i=0; i<sFiles.count(); i++)
+        loader.load(sFiles.at(i), &frame);
+    AllocCounter::stop();
+    qint64 slideAllocations = AllocCounter::allocations()/nSlides;
+    qint64 slideBytes       = AllocCounter::bytes()/nSlides;
+    check("corpus", screen, "steady_state_allocations_per_slide",
+          (slideAllocations <= MAX_SLIDE_ALLOCATIONS) && (slideBytes <= MAX_SLIDE_ALLOC_BYTES),
+          QString("%1 allocations, %2 KB per slide (at most %3, %4 KB)")
+              .arg(slideAllocations).arg(slideBytes/1024)
+              .arg(MAX_SLIDE_ALLOCATIONS).arg(MAX_SLIDE_ALLOC_BYTES/1024));
+    frame = QImage();
+
+    // The show: every slide is taken from the prefetcher while the next
+    // ones are decoded, then converted for an RGB565 texture upload.
+    // The frames evicted from the SlideCache go back to the pool.
+    {
+        DecodePool decodePool(1);
+        decodePool.slideCache()->setBudget(3*frameBytes);
+        SlidePrefetcher prefetcher(&decodePool);
+        prefetcher.setScreenSize(screen.width, screen.height);
+        QVector<unsigned short> rgb565(screen.width*screen.height);
+        QImage shown;
+        for(int pass=0; pass<3; pass++) {
+            if(pass == 2) {// After two warm up passes
+                nPoolAllocations = pPool->allocations();
+                AllocCounter::start(FRAME_SIZED_BYTES);
+            }
+            for(int i=0; i<sFiles.count(); i++) {
+                shown = prefetcher.takeSlide(sFiles.at(i));
+                QStringList sUpcoming;
+                for(int j=1; j<=prefetcher.depth(); j++)
+                    sUpcoming.append(sFiles.at((i+j) % sFiles.count()));
+                prefetcher.schedule(sUpcoming);
+                for(int y=0; y<shown.height(); y++)
+                    rgb565Row(shown.constScanLine(y), rgb565.data()+y*shown.width(), shown.width(), y);
+            }
+        }
+        AllocCounter::stop();
+        nLarge = AllocCounter::allocations();
+        nPoolAllocations = pPool->allocations() - nPoolAllocations;
+        check("corpus", screen, "steady_state_prefetcher_allocations",
+              (nLarge == 0) && (nPoolAllocations == 0),
+              QString("%1 slides: %2 allocations of %3 KB or more, %4 new pool buffers, %5 cache evictions")
+                  .arg(sFiles.count()).arg(nLarge).arg(FRAME_SIZED_BYTES/1024)
+                  .arg(nPoolAllocations).arg(decodePool.slideCache()->evictions()));
+    }
+
+    // Progressive JPEGs: libjpeg keeps the DCT coefficients of the whole
+    // image (2 bytes each, an array per component) at every decode.
+    // Nothing else may be large.
+    QTemporaryDir progressiveDir;
+    const int progressiveSizes[][2] = {
+        { 1600, 1200 },
+        { 4000, 3000 }
+    };
+    for(int i=0; i<2; i++) {
+        int width  = progressiveSizes[i][0];
+        int height = progressiveSizes[i][1];
+        QString sFile = QString("%1/%2x%3-progressive.jpg").arg(progressiveDir.path()).arg(width).arg(height);
+        QString sImage = QFileInfo(sFile).fileName();
+        if(!writeLargeJpeg(sFile, width, height, true)) {
+            check(sImage, screen, "steady_state_progressive_jpeg", false, "unable to write the image");
+            continue;
+        }
+        for(int pass=0; pass<2; pass++)// Warm up
+            loader.load(sFile, &frame);
+        nPoolAllocations = pPool->allocations();
+        AllocCounter::start(FRAME_SIZED_BYTES);
+        loader.load(sFile, &frame);
+        AllocCounter::stop();
+        nPoolAllocations = pPool->allocations() - nPoolAllocations;
+        // 4:2:0 (the libjpeg default): six 8x8 blocks of each 16x16 pixels
+        qint64 coefficientBytes = 6*64*2*qint64((width+15)/16)*((height+15)/16);
+        check(sImage, screen, "steady_state_progressive_jpeg",
+              (AllocCounter::allocations() <= 3) &&
+              (AllocCounter::bytes() <= coefficientBytes + MAX_SLIDE_ALLOC_BYTES) &&
+              (nPoolAllocations == 0),
+              QString("%1 allocations of %2 KB or more, %3 KB (coefficients %4 KB), %5 new pool buffers")
+                  .arg(AllocCounter::allocations()).arg(FRAME_SIZED_BYTES/1024)
+                  .arg(AllocCounter::bytes()/1024).arg(coefficientBytes/1024).arg(nPoolAllocations));
+        frame = QImage();
+    }
+    pPool->setBudget(oldBudget);
+}
+
+
+int
+DecodeBench::failedChecks() {
+    return nFailed;
+}
+
+
+// Usage: decode-bench [-c corpus dir] [-i iterations] [-o output file]
+int
+main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    int nIterations = DEFAULT_ITERATIONS;
+    QString sCorpusDir;
+    QString sOutput;
+    int c;
+    while ((c = getopt(argc, argv, "c:i:o:")) != -1) {
+        switch (c)
+        {
+            case 'c':// Where the synthetic images are (or will be) kept
+                sCorpusDir = QString(optarg);
+                break;
+            case 'i':// Timed runs of every stage
+                nIterations = QString(optarg).toInt();
+                break;
+            case 'o':// JSON lines output (default stdout)
+                sOutput = QString(optarg);
+                break;
+            default:
+                break;
+        }
+    }
+    QTemporaryDir tempDir;
+    if(sCorpusDir.isEmpty())
+        sCorpusDir = tempDir.path();
+    FILE* pOutput = stdout;
+    if(!sOutput.isEmpty()) {
+        pOutput = fopen(QFile::encodeName(sOutput).constData(), "w");
+        if(!pOutput) {
+            qCritical() << "Unable to write" << sOutput;
+            return EXIT_FAILURE;
+        }
+    }
+    DecodeBench bench(nIterations, pOutput);
+    if(!bench.createCorpus(sCorpusDir))
+        return EXIT_FAILURE;
+    bench.run();
+    bench.runPoolChecks();
+    bench.runAnimationChecks(sCorpusDir);
+    bench.runStripChecks(sCorpusDir);
+    bench.runEtc1Checks();
+    bench.runDiskCacheChecks();
+    bench.runRgb565Checks();
+    bench.runLetterboxChecks();
+    bench.runSteadyStateChecks();
+    if(pOutput != stdout)
+        fclose(pOutput);
+    if(bench.failedChecks() > 0) {
+        qCritical() << bench.failedChecks() << "checks failed";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
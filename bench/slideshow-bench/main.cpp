@@ -0,0 +1,262 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QImage>
+#include <QThread>
+#include <QVector>
+#include <QDebug>
+
+#include <stdio.h>
+#include <time.h>
+#include "unistd.h"
+#include "math.h"
+
+#include "headlesssurface.h"
+#include "transitionregistry.h"
+#include "framestats.h"
+#include "kenburns.h"
+
+
+#define DEFAULT_BENCH_FRAMES  300
+#define DEFAULT_BENCH_WIDTH  1920
+#define DEFAULT_BENCH_HEIGHT 1080
+#define BENCH_FRAME_PERIOD  16667 // us of the Ken Burns motion between frames
+#define BENCH_KEN_BURNS_ZOOM 1.5f
+
+
+// Of the calling thread: every output renders in its own
+static qint64
+threadCpuTimeUs() {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return qint64(now.tv_sec)*1000000 + now.tv_nsec/1000;
+}
+
+
+// A slide sized texture with some content to sample,
+// mipmapped and trilinear filtered as in SlideWindow
+static GLuint
+createSlideTexture(int width, int height, int seed) {
+    QImage slide(width, height, QImage::Format_RGBA8888);
+    for(int y=0; y<height; y++) {
+        uchar* pRow = slide.scanLine(y);
+        for(int x=0; x<width; x++) {
+            pRow[4*x]   = uchar(x + seed);
+            pRow[4*x+1] = uchar(y + seed);
+            pRow[4*x+2] = uchar((x ^ y) + seed);
+            pRow[4*x+3] = 255;
+        }
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, slide.constBits());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+
+// Renders every transition on its own off screen surface (and its
+// own GL context): several of them run at once like the outputs of
+// a multi display slide show.
+class OutputBench : public QThread
+{
+public:
+    OutputBench(int iOutputNumber, int surfaceWidth, int surfaceHeight, int frames, QString sTransition)
+        : QThread()
+        , iOutput(iOutputNumber)
+        , width(surfaceWidth)
+        , height(surfaceHeight)
+        , nFrames(frames)
+        , sOnly(sTransition)
+        , bSucceeded(false)
+    {
+    }
+    bool succeeded() {
+        return bSucceeded;
+    }
+
+protected:
+    void run() {
+        bSucceeded = renderTransitions();
+    }
+
+private:
+    bool renderTransitions();
+    void renderFrames(QString sName, Transition* pTransition,
+                      TransitionContext* pContext, KenBurns* pMotion,
+                      HeadlessSurface* pSurface);
+
+private:
+    int iOutput;
+    int width;
+    int height;
+    int nFrames;
+    QString sOnly;
+    bool bSucceeded;
+};
+
+
+bool
+OutputBench::renderTransitions() {
+    HeadlessSurface surface(width, height);
+    if(!surface.open()) {
+        qCritical() << surface.errorString();
+        return false;
+    }
+    printf("# output %d renderer: %s %s\n",
+           iOutput,
+           reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+           reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+    TransitionRegistry transitions;
+    GLfloat aspect = GLfloat(width)/GLfloat(height);
+    QElapsedTimer initTimer;
+    initTimer.start();
+    if(!transitions.init(aspect, Q_NULLPTR)) {
+        qCritical() << transitions.errorString();
+        surface.close();
+        return false;
+    }
+    printf("# output %d programs linked: %d in %.2f ms\n",
+           iOutput, transitions.linkedPrograms(), double(initTimer.nsecsElapsed())/1.0e6);
+
+    // The same view of SlideWindow::initializeGL()
+    TransitionContext context;
+    context.viewingDistance = 20.0f;
+    context.aspect          = aspect;
+    float verticalAngle = 2.0*atan(1.0/context.viewingDistance)*180.0/M_PI;
+    context.projection.perspective(verticalAngle,
+                                   aspect,
+                                   context.viewingDistance - 2.0,
+                                   context.viewingDistance + 0.1);
+    context.texture0 = createSlideTexture(width, height, 0);
+    context.texture1 = createSlideTexture(width, height, 128);
+    context.window0  = KenBurns::fullWindow();
+    context.window1  = KenBurns::fullWindow();
+    glViewport(0, 0, width, height);
+    glClearDepthf(1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+
+    for(int i=0; i<transitions.count(); i++) {
+        Transition* pTransition = transitions.at(i);
+        if(!sOnly.isEmpty() && (pTransition->name().compare(sOnly, Qt::CaseInsensitive) != 0))
+            continue;
+        renderFrames(pTransition->name(), pTransition, &context, Q_NULLPTR, &surface);
+    }
+    // The steady slide panning and zooming between the transitions
+    QString sKenBurns("Ken Burns");
+    Transition* pSteady = transitions.find("Fade");
+    if(pSteady && (sOnly.isEmpty() || (sKenBurns.compare(sOnly, Qt::CaseInsensitive) == 0))) {
+        KenBurns motion;
+        motion.start(0, qint64(nFrames)*BENCH_FRAME_PERIOD, BENCH_KEN_BURNS_ZOOM);
+        renderFrames(sKenBurns, pSteady, &context, &motion, &surface);
+        context.window0 = KenBurns::fullWindow();
+    }
+
+    transitions.release();
+    glDeleteTextures(1, &context.texture0);
+    glDeleteTextures(1, &context.texture1);
+    surface.close();
+    return true;
+}
+
+
+// Without pMotion the transition runs from start to end, otherwise
+// it stays at its start while the outgoing slide pans and zooms
+void
+OutputBench::renderFrames(QString sName, Transition* pTransition,
+                          TransitionContext* pContext, KenBurns* pMotion,
+                          HeadlessSurface* pSurface)
+{
+    FrameStats frameStats;
+    qint64 swapTime = 0;
+    pTransition->begin();
+    QElapsedTimer clock;
+    clock.start();
+    qint64 cpuStart  = threadCpuTimeUs();
+    qint64 lastFrame = 0;
+    for(int frame=0; frame<nFrames; frame++) {
+        if(pMotion)
+            pContext->window0 = pMotion->window(qint64(frame)*BENCH_FRAME_PERIOD);
+        else
+            pTransition->update(GLfloat(frame)/GLfloat(nFrames));
+        glClearColor(1.0, 1.0, 1.0, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        pTransition->draw(*pContext);
+        qint64 swapStart = clock.nsecsElapsed();
+        pSurface->swapBuffers();
+        qint64 now = clock.nsecsElapsed();
+        swapTime += now - swapStart;
+        frameStats.addFrame((now-lastFrame)/1000);
+        lastFrame = now;
+    }
+    double elapsed = double(clock.nsecsElapsed())/1.0e9;
+    qint64 cpuTime = threadCpuTimeUs() - cpuStart;
+    printf("%6d %-24s %8d %10.1f %10lld %10lld %10lld %10lld\n",
+           iOutput,
+           sName.toLatin1().constData(),
+           nFrames,
+           double(nFrames)/elapsed,
+           cpuTime/nFrames,
+           swapTime/1000/nFrames,
+           frameStats.percentile(0.5),
+           frameStats.percentile(0.99));
+    fflush(stdout);
+}
+
+
+// Usage: slideshow-bench [-f frames] [-w width] [-h height] [-t transition] [-n outputs]
+int
+main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    int nFrames  = DEFAULT_BENCH_FRAMES;
+    int width    = DEFAULT_BENCH_WIDTH;
+    int height   = DEFAULT_BENCH_HEIGHT;
+    int nOutputs = 1;
+    QString sOnly;
+    int c;
+    while ((c = getopt(argc, argv, "f:h:n:t:w:")) != -1) {
+        switch (c)
+        {
+            case 'f':// Frames rendered for each transition
+                nFrames = qMax(1, QString(optarg).toInt());
+                break;
+            case 'h':// Surface height
+                height = QString(optarg).toInt();
+                break;
+            case 'n':// Surfaces rendered at the same time, each by its own thread
+                nOutputs = qMax(1, QString(optarg).toInt());
+                break;
+            case 't':// Only the transition with this name
+                sOnly = QString(optarg);
+                break;
+            case 'w':// Surface width
+                width = QString(optarg).toInt();
+                break;
+            default:
+                break;
+        }
+    }
+
+    printf("%6s %-24s %8s %10s %10s %10s %10s %10s\n",
+           "output", "transition", "frames", "fps", "cpu_us", "swap_us", "p50_us", "p99_us");
+    QVector<OutputBench*> outputs;
+    for(int i=0; i<nOutputs; i++) {
+        outputs.append(new OutputBench(i, width, height, nFrames, sOnly));
+        outputs.last()->start();
+    }
+    bool bSucceeded = true;
+    for(int i=0; i<nOutputs; i++) {
+        outputs.at(i)->wait();
+        bSucceeded &= outputs.at(i)->succeeded();
+    }
+    qDeleteAll(outputs);
+    return bSucceeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,31 @@
+# Renders every transition for a fixed number of frames on an
+# off screen EGL pbuffer (e.g. Mesa llvmpipe): no Raspberry Pi needed.
+
+include(../bench.pri)
+
+TARGET = slideshow-bench
+
+SOURCES += main.cpp
+SOURCES += $$SLIDESHOW_DIR/rendersurface.cpp
+SOURCES += $$SLIDESHOW_DIR/headlesssurface.cpp
+SOURCES += $$SLIDESHOW_DIR/programcache.cpp
+SOURCES += $$SLIDESHOW_DIR/slidemesh.cpp
+SOURCES += $$SLIDESHOW_DIR/transition.cpp
+SOURCES += $$SLIDESHOW_DIR/transitions.cpp
+SOURCES += $$SLIDESHOW_DIR/transitionregistry.cpp
+SOURCES += $$SLIDESHOW_DIR/framestats.cpp
+SOURCES += $$SLIDESHOW_DIR/kenburns.cpp
+
+HEADERS += $$SLIDESHOW_DIR/rendersurface.h
+HEADERS += $$SLIDESHOW_DIR/headlesssurface.h
+HEADERS += $$SLIDESHOW_DIR/programcache.h
+HEADERS += $$SLIDESHOW_DIR/slidemesh.h
+HEADERS += $$SLIDESHOW_DIR/transition.h
+HEADERS += $$SLIDESHOW_DIR/transitions.h
+HEADERS += $$SLIDESHOW_DIR/transitionregistry.h
+HEADERS += $$SLIDESHOW_DIR/framestats.h
+HEADERS += $$SLIDESHOW_DIR/kenburns.h
+
+RESOURCES += $$SLIDESHOW_DIR/shaders.qrc
+
+LIBS += -lEGL -lGLESv2
@@ -0,0 +1,417 @@
+#include "decodepool.h"
+#include "slideloader.h"
+#include "animatedslide.h"
+#include "tracer.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+
+#define MAX_DECODE_WORKERS 3 // Leave a core to the render loops
+
+
+DecodePool::Worker::Worker(DecodePool* pParentPool)
+    : QThread()
+{
+    pPool = pParentPool;
+}
+
+
+void
+DecodePool::Worker::run() {
+    pPool->work();
+}
+
+
+// nWorkers = 0: one less than the cores (at least one)
+DecodePool::DecodePool(int nWorkers)
+    : decodeStats(FrameStats::LogScale)
+{
+    if(nWorkers <= 0)
+        nWorkers = qBound(1, QThread::idealThreadCount()-1, MAX_DECODE_WORKERS);
+    for(int i=0; i<nWorkers; i++)
+        workerThreads.append(new Worker(this));
+    nextClient  = 0;
+    memoryLimit = 0;
+    bAbort      = false;
+}
+
+
+DecodePool::~DecodePool() {
+    stop();
+    qDeleteAll(workerThreads);
+}
+
+
+// The pool of the process: shared by all the outputs
+DecodePool*
+DecodePool::instance() {
+    static DecodePool pool;
+    return &pool;
+}
+
+
+void
+DecodePool::stop() {
+    mutex.lock();
+    bAbort = true;
+    workAvailable.wakeAll();
+    frameReady.wakeAll();
+    mutex.unlock();
+    for(int i=0; i<workerThreads.count(); i++)
+        workerThreads.at(i)->wait();
+}
+
+
+int
+DecodePool::addClient() {
+    QMutexLocker locker(&mutex);
+    Client newClient;
+    newClient.nMisses = 0;
+    clients.insert(nextClient, newClient);
+    return nextClient++;
+}
+
+
+void
+DecodePool::removeClient(int iClient) {
+    QMutexLocker locker(&mutex);
+    clients.remove(iClient);
+    dropUnwanted();
+}
+
+
+void
+DecodePool::setScreenSize(int iClient, int width, int height) {
+    QMutexLocker locker(&mutex);
+    if(!clients.contains(iClient) || (clients[iClient].screen == QSize(width, height)))
+        return;
+    clients[iClient].screen = QSize(width, height);
+    // Frames prepared for a different screen may be useless now
+    dropUnwanted();
+    workAvailable.wakeAll();
+}
+
+
+// Peak memory for preparing each slide: with more workers
+// up to this many bytes are used by each of them
+void
+DecodePool::setMemoryLimit(qint64 bytes) {
+    QMutexLocker locker(&mutex);
+    memoryLimit = bytes;
+}
+
+
+int
+DecodePool::prefetchMisses(int iClient) {
+    QMutexLocker locker(&mutex);
+    return clients.value(iClient).nMisses;
+}
+
+
+int
+DecodePool::workers() {
+    return workerThreads.count();
+}
+
+
+// Files decoded (cache hits excluded)
+int
+DecodePool::decodedFiles() {
+    return nDecoded.loadAcquire();
+}
+
+
+// Screen sized frames made out of the decoded files
+int
+DecodePool::composedFrames() {
+    return nComposed.loadAcquire();
+}
+
+
+SlideCache*
+DecodePool::slideCache() {
+    return &cache;
+}
+
+
+SlideDiskCache*
+DecodePool::slideDiskCache() {
+    return &diskCache;
+}
+
+
+// Time spent by the workers in decoding and letterboxing
+// each slide (cache hits excluded). Lock free, as FrameStats.
+FrameStats*
+DecodePool::decodeStatistics() {
+    return &decodeStats;
+}
+
+
+// By path and screen: no stat() with the mutex locked (the render
+// threads wait for it). The workers key the caches by SlideCache::key().
+QString
+DecodePool::jobKey(QString sFile, QSize screen) {
+    return QString("%1|%2x%3").arg(sFile).arg(screen.width()).arg(screen.height());
+}
+
+
+// Must be called with the mutex locked
+bool
+DecodePool::isWanted(QString sFile, QSize screen) {
+    QHashIterator<int, Client> client(clients);
+    while(client.hasNext()) {
+        client.next();
+        if((client.value().screen == screen) && client.value().sScheduled.contains(sFile))
+            return true;
+    }
+    return false;
+}
+
+
+// Must be called with the mutex locked
+void
+DecodePool::dropUnwanted() {
+    QHash<QString, ReadyFrame>::iterator it = readyFrames.begin();
+    while(it != readyFrames.end()) {
+        if(isWanted(it.value().sFile, it.value().screen))
+            ++it;
+        else
+            it = readyFrames.erase(it);
+    }
+}
+
+
+// Must be called with the mutex locked
+void
+DecodePool::startWorkers() {
+    for(int i=0; i<workerThreads.count(); i++) {
+        if(!workerThreads.at(i)->isRunning())
+            workerThreads.at(i)->start(QThread::LowPriority);
+    }
+}
+
+
+// Replace the list of the slides that iClient will show next.
+// Ready frames no more scheduled by any client are dropped.
+void
+DecodePool::schedule(int iClient, QStringList sUpcoming) {
+    QMutexLocker locker(&mutex);
+    if(!clients.contains(iClient))
+        return;
+    sUpcoming.removeDuplicates();
+    clients[iClient].sScheduled = sUpcoming;
+    dropUnwanted();
+    startWorkers();
+    workAvailable.wakeAll();
+}
+
+
+// Return the prepared frame of sFile waiting for the workers
+// if it is not yet ready (a "prefetch miss"). *pAnimated tells
+// whether the file has more frames: probed by the workers, so
+// that the render thread never opens the file.
+QImage
+DecodePool::takeSlide(int iClient, QString sFile, bool* pAnimated) {
+    QMutexLocker locker(&mutex);
+    if(pAnimated)
+        *pAnimated = false;
+    if(!clients.contains(iClient))
+        return QImage();
+    QSize screen = clients.value(iClient).screen;
+    QString sJob = jobKey(sFile, screen);
+    if(!readyFrames.contains(sJob)) {
+        // Not prefetched but maybe cached: looked up without the lock
+        // (stat() may be slow). A miss is counted by the worker.
+        locker.unlock();
+        QImage frame;
+        bool bCached = cache.find(SlideCache::key(sFile, screen.width(), screen.height()), &frame, false);
+        locker.relock();
+        if(!clients.contains(iClient))
+            return QImage();
+        if(bCached) {
+            clients[iClient].sScheduled.removeOne(sFile);
+            if(pAnimated)
+                *pAnimated = animatedFiles.value(sFile, false);
+            return frame;
+        }
+    }
+    if(!readyFrames.contains(sJob)) {
+        clients[iClient].nMisses++;
+        qDebug() << "Prefetch miss:" << sFile;
+        if(!clients[iClient].sScheduled.contains(sFile))
+            clients[iClient].sScheduled.prepend(sFile);
+        startWorkers();
+        workAvailable.wakeAll();
+        while(!readyFrames.contains(sJob) && !bAbort)
+            frameReady.wait(&mutex);
+    }
+    clients[iClient].sScheduled.removeOne(sFile);
+    if(pAnimated)
+        *pAnimated = animatedFiles.value(sFile, false);
+    QImage frame = readyFrames.value(sJob).frame;
+    if(!isWanted(sFile, screen))
+        readyFrames.remove(sJob);
+    return frame;
+}
+
+
+// The first slide (in the order of the schedules) not yet prepared
+// together with all the resolutions it is wanted at (the first
+// *pWanted screens) and then those of the other clients: the outputs
+// run their own timers, so their prefetch windows slide at different
+// times. Must be called with the mutex locked
+bool
+DecodePool::nextJob(QString* pFile, QVector<QSize>* pScreens, int* pWanted) {
+    int maxLength = 0;
+    QHashIterator<int, Client> client(clients);
+    while(client.hasNext())
+        maxLength = qMax(maxLength, client.next().value().sScheduled.count());
+    for(int i=0; i<maxLength; i++) {
+        client.toFront();
+        while(client.hasNext()) {
+            const Client& current = client.next().value();
+            if(i >= current.sScheduled.count())
+                continue;
+            QString sFile = current.sScheduled.at(i);
+            QString sJob  = jobKey(sFile, current.screen);
+            if(readyFrames.contains(sJob) || busyKeys.contains(sJob))
+                continue;
+            // Found: now every screen waiting for the same file
+            pScreens->clear();
+            QHashIterator<int, Client> other(clients);
+            while(other.hasNext()) {
+                const Client& wanting = other.next().value();
+                QString sOtherJob = jobKey(sFile, wanting.screen);
+                if(wanting.sScheduled.contains(sFile) &&
+                   !pScreens->contains(wanting.screen) &&
+                   !readyFrames.contains(sOtherJob) &&
+                   !busyKeys.contains(sOtherJob))
+                {
+                    pScreens->append(wanting.screen);
+                }
+            }
+            *pWanted = pScreens->count();
+            other.toFront();
+            while(other.hasNext()) {
+                QSize screen = other.next().value().screen;
+                QString sOtherJob = jobKey(sFile, screen);
+                if(!screen.isEmpty() &&
+                   !pScreens->contains(screen) &&
+                   !readyFrames.contains(sOtherJob) &&
+                   !busyKeys.contains(sOtherJob))
+                {
+                    pScreens->append(screen);
+                }
+            }
+            *pFile = sFile;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void
+DecodePool::work() {
+    SlideLoader loader;
+    QString sFile;
+    QVector<QSize> screens;
+    int nWanted;
+    QElapsedTimer decodeTimer;
+    forever {
+        mutex.lock();
+        while(!bAbort && !nextJob(&sFile, &screens, &nWanted))
+            workAvailable.wait(&mutex);
+        if(bAbort) {
+            mutex.unlock();
+            return;
+        }
+        if(memoryLimit > 0)
+            loader.setMemoryLimit(memoryLimit);
+        QStringList sJobs;
+        for(int i=0; i<screens.count(); i++) {
+            sJobs.append(jobKey(sFile, screens.at(i)));
+            busyKeys.insert(sJobs.at(i));
+        }
+        bool bProbe = !animatedFiles.contains(sFile);
+        mutex.unlock();
+
+        TraceSpan span("prefetchSlide", "decode");
+        // The file is stat()ed once for all the screens
+        QString sStamp = SlideCache::fileStamp(sFile);
+        QStringList sKeys;
+        for(int i=0; i<screens.count(); i++)
+            sKeys.append(SlideCache::stampedKey(sStamp, screens.at(i).width(), screens.at(i).height()));
+        QVector<QImage> frames(screens.count());
+        QVector<QSize> missing;
+        for(int i=0; i<screens.count(); i++) {
+            // The screens not (yet) wanted only if decoded anyway
+            bool bWanted = i < nWanted;
+            if(cache.find(sKeys.at(i), &frames[i], bWanted))
+                continue;
+            if(!bWanted) {
+                if(!missing.isEmpty())
+                    missing.append(screens.at(i));
+                continue;
+            }
+            bool bCached;
+            {
+                TraceSpan diskSpan("diskCacheFind", "decode");
+                bCached = diskCache.find(sFile, screens.at(i).width(), screens.at(i).height(), &frames[i]);
+            }
+            if(bCached)
+                cache.insert(sKeys.at(i), frames.at(i));
+            else
+                missing.append(screens.at(i));
+        }
+        // Probed again when decoded: the file may have been replaced
+        bProbe |= !missing.isEmpty();
+        bool bAnimated = bProbe && AnimatedSlide::isAnimation(sFile);
+        if(!missing.isEmpty()) {
+            QVector<QImage> decoded;
+            decodeTimer.start();
+            bool bLoaded = loader.load(sFile, missing, &decoded);
+            decodeStats.addFrame(decodeTimer.nsecsElapsed()/1000);
+            nDecoded.fetchAndAddRelaxed(1);
+            nComposed.fetchAndAddRelaxed(decoded.count());
+            for(int i=0, j=0; (i<screens.count()) && (j<decoded.count()); i++) {
+                if(screens.at(i) != missing.at(j))
+                    continue;
+                frames[i] = decoded.at(j++);
+                if(bLoaded && !frames.at(i).isNull()) {
+                    cache.insert(sKeys.at(i), frames.at(i));
+                    TraceSpan storeSpan("diskCacheStore", "decode");
+                    diskCache.store(sFile, frames.at(i));
+                }
+            }
+        }
+
+        mutex.lock();
+        if(bProbe)
+            animatedFiles.insert(sFile, bAnimated);
+        // Keep the frames only if still wanted. A screen wanted
+        // meanwhile but not made here is a new job.
+        bool bRetry = false;
+        for(int i=0; i<screens.count(); i++) {
+            busyKeys.remove(sJobs.at(i));
+            if(!isWanted(sFile, screens.at(i)))
+                continue;
+            if((i >= nWanted) && frames.at(i).isNull()) {
+                bRetry = true;
+                continue;
+            }
+            ReadyFrame ready;
+            ready.sFile  = sFile;
+            ready.screen = screens.at(i);
+            ready.frame  = frames.at(i);
+            readyFrames.insert(sJobs.at(i), ready);
+        }
+        if(bRetry)
+            workAvailable.wakeAll();
+        frameReady.wakeAll();
+        mutex.unlock();
+    }
+}
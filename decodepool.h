@@ -0,0 +1,93 @@
+#ifndef DECODEPOOL_H
+#define DECODEPOOL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QSize>
+#include <QImage>
+#include <QAtomicInt>
+
+#include "slidecache.h"
+#include "slidediskcache.h"
+#include "framestats.h"
+
+
+// The decoding workers and the frame caches shared by all the
+// outputs (SlidePrefetcher clients) of the process. Every client
+// tells which slides it will show next and at which resolution:
+// a decoded file is scaled once for each distinct resolution of
+// the clients, also those that will want it only later, so that
+// it is decoded once.
+class DecodePool
+{
+public:
+    DecodePool(int nWorkers = 0);
+    ~DecodePool();
+    static DecodePool* instance();
+    int  addClient();
+    void removeClient(int iClient);
+    void setScreenSize(int iClient, int width, int height);
+    void setMemoryLimit(qint64 bytes);
+    void schedule(int iClient, QStringList sUpcoming);
+    QImage takeSlide(int iClient, QString sFile, bool* pAnimated = Q_NULLPTR);
+    int  prefetchMisses(int iClient);
+    int  workers();
+    int  decodedFiles();
+    int  composedFrames();
+    SlideCache* slideCache();
+    SlideDiskCache* slideDiskCache();
+    FrameStats* decodeStatistics();
+    void stop();
+
+private:
+    class Worker : public QThread
+    {
+    public:
+        Worker(DecodePool* pParentPool);
+    protected:
+        void run();
+    private:
+        DecodePool* pPool;
+    };
+    struct Client {
+        QSize screen;
+        QStringList sScheduled;
+        int nMisses;
+    };
+    struct ReadyFrame {
+        QString sFile;
+        QSize   screen;
+        QImage  frame;
+    };
+    void work();
+    static QString jobKey(QString sFile, QSize screen);
+    bool nextJob(QString* pFile, QVector<QSize>* pScreens, int* pWanted);
+    bool isWanted(QString sFile, QSize screen);
+    void dropUnwanted();
+    void startWorkers();
+
+private:
+    QMutex mutex;
+    QWaitCondition workAvailable;
+    QWaitCondition frameReady;
+    QHash<int, Client> clients;
+    QHash<QString, ReadyFrame> readyFrames;// By jobKey()
+    QSet<QString> busyKeys;// Being decoded, by jobKey()
+    QHash<QString, bool> animatedFiles;// By file, probed by the workers
+    QVector<Worker*> workerThreads;
+    int  nextClient;
+    qint64 memoryLimit;// 0: the SlideLoader default
+    bool bAbort;
+    SlideCache cache;
+    SlideDiskCache diskCache;
+    FrameStats decodeStats;
+    QAtomicInt nDecoded;
+    QAtomicInt nComposed;
+};
+
+#endif // DECODEPOOL_H
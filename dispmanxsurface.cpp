@@ -0,0 +1,133 @@
+#include "dispmanxsurface.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QByteArray>
+
+
+// bcm_host_init() is per process: the last surface deinitializes
+static QMutex hostMutex;
+static int nHostUsers = 0;
+
+
+DispmanxSurface::DispmanxSurface(int iDisplay) {
+    iDisplayNumber   = iDisplay;
+    bHostInitialized = false;
+    dispman_display  = DISPMANX_NO_HANDLE;
+    dispman_element  = DISPMANX_NO_HANDLE;
+}
+
+
+bool
+DispmanxSurface::openNative() {
+    {
+        QMutexLocker locker(&hostMutex);
+        if(nHostUsers++ == 0)
+            bcm_host_init();
+    }
+    bHostInitialized = true;
+    // Let's find the max display size
+    uint32_t screen_width, screen_height;
+    int32_t success = graphics_get_display_size(uint16_t(iDisplayNumber),
+                                                &screen_width,
+                                                &screen_height);
+    if(success < 0)
+        return fail("Error in graphics_get_display_size()");
+    surfaceWidth  = int(screen_width);
+    surfaceHeight = int(screen_height);
+    return true;
+}
+
+
+// The gpu_mem split of the firmware, asked to the VideoCore
+// (e.g. "gpu=64M"): valid once the surface is open
+qint64
+DispmanxSurface::gpuMemory() {
+    if(!bHostInitialized)
+        return -1;
+    char response[64];
+    if(vc_gencmd(response, sizeof(response), "get_mem gpu") != 0)
+        return -1;
+    QByteArray value = QByteArray(response).trimmed();
+    int iStart = value.indexOf('=');
+    if((iStart < 0) || !value.endsWith('M'))
+        return -1;
+    bool bOk = false;
+    qint64 megaBytes = value.mid(iStart+1, value.length()-iStart-2).toLongLong(&bOk);
+    return bOk ? megaBytes*1024*1024 : -1;
+}
+
+
+EGLint
+DispmanxSurface::surfaceType() {
+    return EGL_WINDOW_BIT;
+}
+
+
+EGLSurface
+DispmanxSurface::createSurface(EGLConfig config) {
+    VC_RECT_T dst_rect;
+    dst_rect.x      = 0;
+    dst_rect.y      = 0;
+    dst_rect.width  = surfaceWidth;
+    dst_rect.height = surfaceHeight;
+
+    VC_RECT_T src_rect;
+    src_rect.x      = 0;
+    src_rect.y      = 0;
+    src_rect.width  = surfaceWidth << 16;
+    src_rect.height = surfaceHeight << 16;
+
+    // open our display (0 being the LCD), there are also
+    // some other versions of this function where we can pass
+    // in a mode however the mode is not documented as far as
+    // I can see
+    dispman_display = vc_dispmanx_display_open(uint32_t(iDisplayNumber));
+    // now we signal to the video core we are going to start
+    // updating the config
+    DISPMANX_UPDATE_HANDLE_T dispman_update = vc_dispmanx_update_start(0);
+
+    // this is the main setup function where we add an element
+    // to the display, this is filled in to the src / dst rectangles
+    dispman_element = vc_dispmanx_element_add(dispman_update,
+                                              dispman_display,
+                                              0, // layer
+                                              &dst_rect,
+                                              0, // src
+                                              &src_rect,
+                                              DISPMANX_PROTECTION_NONE,
+                                              0, // alpha
+                                              0, // clamp
+                                              DISPMANX_TRANSFORM_T(0));// transform
+
+    // having created this element we pass it to the native window
+    // structure ready to create our new EGL surface
+    nativewindow.element = dispman_element;
+    nativewindow.width   = surfaceWidth;
+    nativewindow.height  = surfaceHeight;
+    // we now tell the vc we have finished our update
+    vc_dispmanx_update_submit_sync(dispman_update);
+
+    // finally we can create a new surface using this config and window
+    return eglCreateWindowSurface(display, config, &nativewindow, NULL);
+}
+
+
+void
+DispmanxSurface::closeNative() {
+    if(dispman_element != DISPMANX_NO_HANDLE) {
+        DISPMANX_UPDATE_HANDLE_T dispman_update = vc_dispmanx_update_start(0);
+        vc_dispmanx_element_remove(dispman_update, dispman_element);
+        vc_dispmanx_update_submit_sync(dispman_update);
+    }
+    if(dispman_display != DISPMANX_NO_HANDLE)
+        vc_dispmanx_display_close(dispman_display);
+    dispman_element = DISPMANX_NO_HANDLE;
+    dispman_display = DISPMANX_NO_HANDLE;
+    if(bHostInitialized) {
+        QMutexLocker locker(&hostMutex);
+        if(--nHostUsers == 0)
+            bcm_host_deinit();
+    }
+    bHostInitialized = false;
+}
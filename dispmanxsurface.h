@@ -0,0 +1,31 @@
+#ifndef DISPMANXSURFACE_H
+#define DISPMANXSURFACE_H
+
+#include "rendersurface.h"
+
+#include "bcm_host.h"
+
+
+// Full screen window on a Raspberry Pi display through dispmanx
+// (0: the LCD, 2: HDMI 0, 7: HDMI 1)
+class DispmanxSurface : public RenderSurface
+{
+public:
+    DispmanxSurface(int iDisplay = 0);
+    qint64 gpuMemory();
+
+protected:
+    bool openNative();
+    void closeNative();
+    EGLint surfaceType();
+    EGLSurface createSurface(EGLConfig config);
+
+private:
+    int  iDisplayNumber;
+    bool bHostInitialized;
+    EGL_DISPMANX_WINDOW_T nativewindow;
+    DISPMANX_DISPLAY_HANDLE_T dispman_display;
+    DISPMANX_ELEMENT_HANDLE_T dispman_element;
+};
+
+#endif // DISPMANXSURFACE_H
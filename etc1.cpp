@@ -0,0 +1,334 @@
+#include "etc1.h"
+
+#include <limits.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+// The modifiers of each table in pixel index order:
+// (msb, lsb) = 00: +small, 01: +large, 10: -small, 11: -large
+static const int etc1Modifiers[8][4] = {
+    {  2,   8,   -2,   -8 },
+    {  5,  17,   -5,  -17 },
+    {  9,  29,   -9,  -29 },
+    { 13,  42,  -13,  -42 },
+    { 18,  60,  -18,  -60 },
+    { 24,  80,  -24,  -80 },
+    { 33, 106,  -33, -106 },
+    { 47, 183,  -47, -183 }
+};
+
+
+int
+etc1DataSize(int width, int height) {
+    return ((width+3)/4) * ((height+3)/4) * ETC1_BLOCK_BYTES;
+}
+
+
+static inline int
+clampColor(int value) {
+    return (value < 0) ? 0 : ((value > 255) ? 255 : value);
+}
+
+
+static inline int
+expand4(int value) {
+    return (value << 4) | value;
+}
+
+
+static inline int
+expand5(int value) {
+    return (value << 3) | (value >> 2);
+}
+
+
+// A modifier m moves the three channels of the base color together.
+// With d = the sum of the three channel differences of a pixel from
+// the base, the squared error is (3m-d)^2/3 plus a part not depending
+// on m: the best table is the one with the smallest sum over the half
+// block of min |3m-d|^2. Returns the table and that sum in *pError.
+
+#if defined(__SSE2__)
+
+static int
+bestTable(const short* pDiff, int* pError) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDiff));
+    int best = 0;
+    *pError = INT_MAX;
+    for(int t=0; t<8; t++) {
+        __m128i minimum = _mm_set1_epi16(SHRT_MAX);
+        for(int k=0; k<4; k++) {
+            __m128i m = _mm_set1_epi16(short(3*etc1Modifiers[t][k]));
+            __m128i distance = _mm_max_epi16(_mm_sub_epi16(d, m), _mm_sub_epi16(m, d));
+            minimum = _mm_min_epi16(minimum, distance);
+        }
+        __m128i squares = _mm_madd_epi16(minimum, minimum);
+        squares = _mm_add_epi32(squares, _mm_shuffle_epi32(squares, 0x4e));
+        squares = _mm_add_epi32(squares, _mm_shuffle_epi32(squares, 0xb1));
+        int error = _mm_cvtsi128_si32(squares);
+        if(error < *pError) {
+            *pError = error;
+            best = t;
+        }
+    }
+    return best;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static int
+bestTable(const short* pDiff, int* pError) {
+    int16x8_t d = vld1q_s16(pDiff);
+    int best = 0;
+    *pError = INT_MAX;
+    for(int t=0; t<8; t++) {
+        int16x8_t minimum = vdupq_n_s16(SHRT_MAX);
+        for(int k=0; k<4; k++)
+            minimum = vminq_s16(minimum, vabdq_s16(d, vdupq_n_s16(short(3*etc1Modifiers[t][k]))));
+        int32x4_t squares = vmull_s16(vget_low_s16(minimum), vget_low_s16(minimum));
+        squares = vmlal_s16(squares, vget_high_s16(minimum), vget_high_s16(minimum));
+        int32x2_t sum = vadd_s32(vget_low_s32(squares), vget_high_s32(squares));
+        sum = vpadd_s32(sum, sum);
+        int error = vget_lane_s32(sum, 0);
+        if(error < *pError) {
+            *pError = error;
+            best = t;
+        }
+    }
+    return best;
+}
+
+#else
+
+static int
+bestTable(const short* pDiff, int* pError) {
+    int best = 0;
+    *pError = INT_MAX;
+    for(int t=0; t<8; t++) {
+        int error = 0;
+        for(int i=0; i<8; i++) {
+            int minimum = INT_MAX;
+            for(int k=0; k<4; k++) {
+                int distance = 3*etc1Modifiers[t][k] - pDiff[i];
+                if(distance < 0)
+                    distance = -distance;
+                if(distance < minimum)
+                    minimum = distance;
+            }
+            error += minimum*minimum;
+        }
+        if(error < *pError) {
+            *pError = error;
+            best = t;
+        }
+    }
+    return best;
+}
+
+#endif
+
+
+// The choices made for one of the two block orientations
+struct BlockMode {
+    bool bDiff;
+    int  quantized[2][3];// 5 bit (differential) or 4 bit colors
+    int  base[2][3];// The same expanded to 8 bit
+    int  table[2];
+    int  cost;// 3 times the squared error
+};
+
+
+// Half block s of the orientation: left/right (flip = 0) or top/bottom
+static inline int
+halfBlock(int x, int y, int flip) {
+    return flip ? (y >> 1) : (x >> 1);
+}
+
+
+static void
+chooseMode(const int block[4][4][3], int flip, BlockMode* pMode) {
+    int average[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+    for(int y=0; y<4; y++)
+        for(int x=0; x<4; x++)
+            for(int c=0; c<3; c++)
+                average[halfBlock(x, y, flip)][c] += block[y][x][c];
+    // Differential mode (two 5 bit colors) when they are close enough
+    pMode->bDiff = true;
+    for(int c=0; c<3; c++) {
+        for(int s=0; s<2; s++)
+            pMode->quantized[s][c] = (average[s][c]*31 + 4*255) / (8*255);
+        int delta = pMode->quantized[1][c] - pMode->quantized[0][c];
+        if((delta < -4) || (delta > 3))
+            pMode->bDiff = false;
+    }
+    for(int s=0; s<2; s++) {
+        for(int c=0; c<3; c++) {
+            if(!pMode->bDiff)
+                pMode->quantized[s][c] = (average[s][c]*15 + 4*255) / (8*255);
+            pMode->base[s][c] = pMode->bDiff ? expand5(pMode->quantized[s][c])
+                                             : expand4(pMode->quantized[s][c]);
+        }
+    }
+    pMode->cost = 0;
+    for(int s=0; s<2; s++) {
+        short diff[8];
+        int n = 0;
+        int residual = 0;
+        for(int y=0; y<4; y++) {
+            for(int x=0; x<4; x++) {
+                if(halfBlock(x, y, flip) != s)
+                    continue;
+                int squares = 0;
+                int sum = 0;
+                for(int c=0; c<3; c++) {
+                    int e = block[y][x][c] - pMode->base[s][c];
+                    squares += e*e;
+                    sum += e;
+                }
+                diff[n++] = short(sum);
+                residual += 3*squares - sum*sum;
+            }
+        }
+        int error;
+        pMode->table[s] = bestTable(diff, &error);
+        pMode->cost += error + residual;
+    }
+}
+
+
+static void
+encodeBlock(const int block[4][4][3], unsigned char* pDst) {
+    BlockMode modes[2];
+    chooseMode(block, 0, &modes[0]);
+    chooseMode(block, 1, &modes[1]);
+    int flip = (modes[1].cost < modes[0].cost) ? 1 : 0;
+    const BlockMode& mode = modes[flip];
+
+    unsigned int high = 0;
+    if(mode.bDiff) {
+        for(int c=0; c<3; c++) {
+            int delta = mode.quantized[1][c] - mode.quantized[0][c];
+            high |= unsigned(mode.quantized[0][c]) << (27-8*c);
+            high |= unsigned(delta & 7) << (24-8*c);
+        }
+    }
+    else {
+        for(int c=0; c<3; c++) {
+            high |= unsigned(mode.quantized[0][c]) << (28-8*c);
+            high |= unsigned(mode.quantized[1][c]) << (24-8*c);
+        }
+    }
+    high |= unsigned(mode.table[0]) << 5;
+    high |= unsigned(mode.table[1]) << 2;
+    high |= unsigned(mode.bDiff ? 1 : 0) << 1;
+    high |= unsigned(flip);
+
+    // Now the exact (clamped) best modifier of each pixel
+    unsigned int low = 0;
+    for(int y=0; y<4; y++) {
+        for(int x=0; x<4; x++) {
+            int s = halfBlock(x, y, flip);
+            const int* pBase = mode.base[s];
+            const int* pModifiers = etc1Modifiers[mode.table[s]];
+            int best = 0;
+            int bestError = INT_MAX;
+            for(int k=0; k<4; k++) {
+                int error = 0;
+                for(int c=0; c<3; c++) {
+                    int e = clampColor(pBase[c] + pModifiers[k]) - block[y][x][c];
+                    error += e*e;
+                }
+                if(error < bestError) {
+                    bestError = error;
+                    best = k;
+                }
+            }
+            int bit = 4*x + y;// Pixels are numbered by column
+            low |= unsigned(best >> 1) << (bit+16);
+            low |= unsigned(best & 1) << bit;
+        }
+    }
+    // Big endian 64 bit word
+    for(int i=0; i<4; i++) {
+        pDst[i]   = (unsigned char)(high >> (24-8*i));
+        pDst[4+i] = (unsigned char)(low  >> (24-8*i));
+    }
+}
+
+
+void
+etc1Encode(const unsigned char* pSrc, int width, int height, int srcStride,
+           unsigned char* pDst)
+{
+    int block[4][4][3];
+    for(int by=0; by<height; by+=4) {
+        for(int bx=0; bx<width; bx+=4) {
+            // Partial blocks repeat the last row and column
+            for(int y=0; y<4; y++) {
+                int yPixel = (by+y < height) ? by+y : height-1;
+                const unsigned char* pRow = pSrc + long(yPixel)*srcStride;
+                for(int x=0; x<4; x++) {
+                    int xPixel = (bx+x < width) ? bx+x : width-1;
+                    for(int c=0; c<3; c++)
+                        block[y][x][c] = pRow[4*xPixel+c];
+                }
+            }
+            encodeBlock(block, pDst);
+            pDst += ETC1_BLOCK_BYTES;
+        }
+    }
+}
+
+
+void
+etc1Decode(const unsigned char* pSrc, int width, int height,
+           unsigned char* pDst, int dstStride)
+{
+    for(int by=0; by<height; by+=4) {
+        for(int bx=0; bx<width; bx+=4) {
+            unsigned int high = 0;
+            unsigned int low  = 0;
+            for(int i=0; i<4; i++) {
+                high = (high << 8) | pSrc[i];
+                low  = (low  << 8) | pSrc[4+i];
+            }
+            pSrc += ETC1_BLOCK_BYTES;
+            bool bDiff = (high & 2) != 0;
+            int  flip  = int(high & 1);
+            int  base[2][3];
+            for(int c=0; c<3; c++) {
+                if(bDiff) {
+                    int color = int(high >> (27-8*c)) & 31;
+                    int delta = int(high >> (24-8*c)) & 7;
+                    if(delta > 3)
+                        delta -= 8;
+                    base[0][c] = expand5(color);
+                    base[1][c] = expand5((color + delta) & 31);
+                }
+                else {
+                    base[0][c] = expand4(int(high >> (28-8*c)) & 15);
+                    base[1][c] = expand4(int(high >> (24-8*c)) & 15);
+                }
+            }
+            int table[2] = { int(high >> 5) & 7, int(high >> 2) & 7 };
+            for(int y=0; (y<4) && (by+y<height); y++) {
+                unsigned char* pRow = pDst + long(by+y)*dstStride;
+                for(int x=0; (x<4) && (bx+x<width); x++) {
+                    int s   = halfBlock(x, y, flip);
+                    int bit = 4*x + y;
+                    int k   = int(((low >> (bit+16)) & 1) << 1 | ((low >> bit) & 1));
+                    int modifier = etc1Modifiers[table[s]][k];
+                    unsigned char* pPixel = pRow + 4*(bx+x);
+                    for(int c=0; c<3; c++)
+                        pPixel[c] = (unsigned char)clampColor(base[s][c] + modifier);
+                    pPixel[3] = 255;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef ETC1_H
+#define ETC1_H
+
+#define ETC1_BLOCK_BYTES 8 // Each of 4x4 pixels
+
+
+// Bytes of a width x height ETC1 image: 4 bits per pixel, in 4x4 pixel
+// blocks stored row of blocks after row of blocks (partial blocks at
+// the right and bottom edges included)
+int etc1DataSize(int width, int height);
+
+// Encode an image in R,G,B,X byte order (the fourth byte is ignored:
+// ETC1 has no alpha) into pDst, etc1DataSize() bytes long.
+// A fast single pass encoder: the base colors are the averages of the
+// two half blocks and only the modifier tables are searched (with
+// SSE2 or NEON, where available).
+void etc1Encode(const unsigned char* pSrc, int width, int height, int srcStride,
+                unsigned char* pDst);
+
+// The software decoder (R,G,B,255 pixels): the reference for the
+// quality checks of the encoder, no GPU needed
+void etc1Decode(const unsigned char* pSrc, int width, int height,
+                unsigned char* pDst, int dstStride);
+
+#endif // ETC1_H
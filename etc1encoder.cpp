@@ -0,0 +1,307 @@
+#include "etc1encoder.h"
+#include "etc1.h"
+#include "slidecache.h"
+#include "tracer.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include "math.h"
+
+
+#define MIN_ETC1_PSNR 30.0 // dB: below that the slide stays uncompressed
+
+
+Etc1Encoder::Etc1Encoder(QObject* parent)
+    : QThread(parent)
+    , encodeStats(FrameStats::LogScale)
+{
+    pDiskCache = Q_NULLPTR;
+    bMipmaps   = false;
+    bAbort     = false;
+    iRequested = 0;
+    iFinished  = 0;
+    iTaken     = 0;
+    bAccepted  = false;
+}
+
+
+Etc1Encoder::~Etc1Encoder() {
+    stop();
+}
+
+
+// Compressed slides are kept there too (Q_NULLPTR: never on disk)
+void
+Etc1Encoder::setDiskCache(SlideDiskCache* pCache) {
+    QMutexLocker locker(&mutex);
+    pDiskCache = pCache;
+}
+
+
+// With mipmaps every level is compressed: the GPU
+// can not generate them for compressed textures
+void
+Etc1Encoder::setMipmaps(bool bEnabled) {
+    QMutexLocker locker(&mutex);
+    bMipmaps = bEnabled;
+}
+
+
+// Start compressing frame: a job not yet taken is replaced
+void
+Etc1Encoder::encode(QString sFile, const QImage& frame) {
+    QMutexLocker locker(&mutex);
+    iRequested++;
+    if(frame.isNull()) {// Nothing to wait for
+        iFinished = iTaken = iRequested;
+        return;
+    }
+    sJobFile  = sFile;
+    jobFrame  = frame;
+    bAccepted = false;
+    result.levels.clear();
+    if(!isRunning() && !bAbort)
+        start(QThread::LowPriority);
+    jobChanged.wakeAll();
+}
+
+
+// The current slide will not be compressed
+void
+Etc1Encoder::cancel() {
+    QMutexLocker locker(&mutex);
+    iRequested++;
+    iFinished = iTaken = iRequested;
+    jobFrame  = QImage();
+    bAccepted = false;
+    result.levels.clear();
+}
+
+
+// A job has been given and its result not yet taken
+bool
+Etc1Encoder::isPending() {
+    QMutexLocker locker(&mutex);
+    return iTaken != iRequested;
+}
+
+
+bool
+Etc1Encoder::isReady() {
+    QMutexLocker locker(&mutex);
+    return (iTaken != iRequested) && (iFinished == iRequested);
+}
+
+
+// The compressed slide, waiting for the worker if not yet ready.
+// False if there is none or it has been rejected.
+bool
+Etc1Encoder::takeTexture(Etc1Texture* pTexture) {
+    QMutexLocker locker(&mutex);
+    if(iTaken == iRequested)
+        return false;
+    while(!bAbort && (iFinished != iRequested))
+        jobChanged.wait(&mutex);
+    if(bAbort)
+        return false;
+    iTaken = iRequested;
+    if(!bAccepted)
+        return false;
+    *pTexture = result;
+    result.levels.clear();
+    return true;
+}
+
+
+// Never waits: the compressed slide if already done (e.g. found
+// in the disk cache), else the job is cancelled. For a slide to
+// be shown at once (keys, D-Bus jumps).
+bool
+Etc1Encoder::takeReadyTexture(Etc1Texture* pTexture) {
+    QMutexLocker locker(&mutex);
+    if(iTaken == iRequested)
+        return false;
+    if(iFinished != iRequested) {// As cancel()
+        iRequested++;
+        iFinished = iTaken = iRequested;
+        jobFrame  = QImage();
+        bAccepted = false;
+        result.levels.clear();
+        return false;
+    }
+    iTaken = iRequested;
+    if(!bAccepted)
+        return false;
+    *pTexture = result;
+    result.levels.clear();
+    return true;
+}
+
+
+void
+Etc1Encoder::stop() {
+    mutex.lock();
+    bAbort = true;
+    jobChanged.wakeAll();
+    mutex.unlock();
+    wait();
+}
+
+
+// Slides compressed (disk cache hits excluded)
+int
+Etc1Encoder::encodedSlides() {
+    return nEncoded.loadAcquire();
+}
+
+
+// Slides left uncompressed by the quality check (each one once)
+int
+Etc1Encoder::rejectedSlides() {
+    return nRejected.loadAcquire();
+}
+
+
+FrameStats*
+Etc1Encoder::encodeStatistics() {
+    return &encodeStats;
+}
+
+
+static int
+mipmapLevels(int width, int height) {
+    int nLevels = 1;
+    while((width > 1) || (height > 1)) {
+        width  = qMax(1, width/2);
+        height = qMax(1, height/2);
+        nLevels++;
+    }
+    return nLevels;
+}
+
+
+// Every level is halved (box filtered) from the previous one
+bool
+Etc1Encoder::compress(const QImage& frame, bool bMipmaps, Etc1Texture* pTexture) {
+    QImage level = frame;
+    switch(level.format()) {
+        case QImage::Format_RGBX8888:
+        case QImage::Format_RGBA8888:
+        case QImage::Format_RGBA8888_Premultiplied:
+            break;
+        default:
+            level = level.convertToFormat(QImage::Format_RGBX8888);
+            break;
+    }
+    if(level.isNull())
+        return false;
+    pTexture->width  = level.width();
+    pTexture->height = level.height();
+    pTexture->levels.clear();
+    forever {
+        QByteArray data(etc1DataSize(level.width(), level.height()), Qt::Uninitialized);
+        etc1Encode(level.constBits(), level.width(), level.height(), level.bytesPerLine(),
+                   reinterpret_cast<unsigned char*>(data.data()));
+        pTexture->levels.append(data);
+        if(!bMipmaps || ((level.width() == 1) && (level.height() == 1)))
+            break;
+        level = level.scaled(qMax(1, level.width()/2), qMax(1, level.height()/2),
+                             Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    return true;
+}
+
+
+// Of the level 0 decoded in software against the original frame (RGB only)
+double
+Etc1Encoder::psnr(const QImage& frame, const Etc1Texture& texture) {
+    if(texture.levels.isEmpty() || (frame.size() != QSize(texture.width, texture.height)))
+        return 0.0;
+    QImage original = frame.convertToFormat(QImage::Format_RGBX8888);
+    QImage decoded(texture.width, texture.height, QImage::Format_RGBX8888);
+    etc1Decode(reinterpret_cast<const unsigned char*>(texture.levels.first().constData()),
+               texture.width, texture.height, decoded.bits(), decoded.bytesPerLine());
+    double squares = 0.0;
+    for(int y=0; y<texture.height; y++) {
+        const uchar* pOriginal = original.constScanLine(y);
+        const uchar* pDecoded  = decoded.constScanLine(y);
+        qint64 rowSquares = 0;
+        for(int x=0; x<4*texture.width; x++) {
+            if((x & 3) == 3)
+                continue;
+            int e = int(pOriginal[x]) - int(pDecoded[x]);
+            rowSquares += e*e;
+        }
+        squares += double(rowSquares);
+    }
+    double mse = squares/(3.0*texture.width*texture.height);
+    if(mse <= 0.0)
+        return 99.0;
+    return 10.0*log10(255.0*255.0/mse);
+}
+
+
+void
+Etc1Encoder::run() {
+    QElapsedTimer encodeTimer;
+    forever {
+        mutex.lock();
+        while(!bAbort && jobFrame.isNull())
+            jobChanged.wait(&mutex);
+        if(bAbort) {
+            mutex.unlock();
+            break;
+        }
+        int iJob = iRequested;
+        QString sFile = sJobFile;
+        QImage frame  = jobFrame;
+        jobFrame = QImage();
+        bool bLevels = bMipmaps;
+        SlideDiskCache* pCache = pDiskCache;
+        mutex.unlock();
+
+        TraceSpan span("encodeEtc1", "upload");
+        Etc1Texture texture;
+        texture.width  = frame.width();
+        texture.height = frame.height();
+        // Rejected before (and not changed since): straight to the uncompressed upload
+        QString sKey = SlideCache::key(sFile, frame.width(), frame.height());
+        mutex.lock();
+        bool bRejected = rejected.contains(sKey);
+        mutex.unlock();
+        int nLevels = bLevels ? mipmapLevels(frame.width(), frame.height()) : 1;
+        bool bOk = !bRejected && pCache &&
+                   pCache->findCompressed(sFile, frame.width(), frame.height(),
+                                          nLevels, &texture.levels);
+        if(!bOk && !bRejected) {
+            encodeTimer.start();
+            bOk = compress(frame, bLevels, &texture);
+            double quality = bOk ? psnr(frame, texture) : 0.0;
+            encodeStats.addFrame(encodeTimer.nsecsElapsed()/1000);
+            if(bOk && (quality < MIN_ETC1_PSNR)) {
+                qDebug() << sFile << "ETC1 PSNR" << quality << "dB: left uncompressed";
+                nRejected.fetchAndAddRelaxed(1);
+                bOk = false;
+                mutex.lock();
+                rejected.insert(sKey);
+                mutex.unlock();
+            }
+            else if(bOk) {
+                nEncoded.fetchAndAddRelaxed(1);
+                if(pCache)
+                    pCache->storeCompressed(sFile, texture.width, texture.height, texture.levels);
+            }
+        }
+
+        mutex.lock();
+        if(iJob == iRequested) {// Not replaced in the meantime
+            result    = texture;
+            bAccepted = bOk;
+            iFinished = iJob;
+            jobChanged.wakeAll();
+        }
+        mutex.unlock();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ETC1ENCODER_H
+#define ETC1ENCODER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QSet>
+
+#include "slidediskcache.h"
+#include "framestats.h"
+
+
+// An ETC1 compressed slide: level 0 and, if wanted, all its mipmaps
+struct Etc1Texture {
+    int width;
+    int height;
+    QVector<QByteArray> levels;
+};
+
+
+// Compresses the slide frames to ETC1 on a worker thread while the
+// previous slide is on screen. A slide whose compressed version
+// (checked with the software decoder) is too far from the original
+// is rejected: it will be uploaded uncompressed, now and at every
+// later showing (without being compressed again).
+class Etc1Encoder : public QThread
+{
+public:
+    Etc1Encoder(QObject* parent = Q_NULLPTR);
+    ~Etc1Encoder();
+    void setDiskCache(SlideDiskCache* pCache);
+    void setMipmaps(bool bEnabled);
+    void encode(QString sFile, const QImage& frame);
+    void cancel();
+    bool isPending();
+    bool isReady();
+    bool takeTexture(Etc1Texture* pTexture);
+    bool takeReadyTexture(Etc1Texture* pTexture);
+    void stop();
+    int  encodedSlides();
+    int  rejectedSlides();
+    FrameStats* encodeStatistics();
+    static bool compress(const QImage& frame, bool bMipmaps, Etc1Texture* pTexture);
+    static double psnr(const QImage& frame, const Etc1Texture& texture);
+
+protected:
+    void run();
+
+private:
+    QMutex mutex;
+    QWaitCondition jobChanged;
+    SlideDiskCache* pDiskCache;
+    bool bMipmaps;
+    bool bAbort;
+    // Jobs are numbered: results of replaced ones are dropped
+    int  iRequested;
+    int  iFinished;
+    int  iTaken;
+    QString sJobFile;
+    QImage  jobFrame;
+    Etc1Texture result;
+    bool bAccepted;
+    QSet<QString> rejected;// SlideCache keys of the rejected slides
+    QAtomicInt nEncoded;
+    QAtomicInt nRejected;
+    FrameStats encodeStats;
+};
+
+#endif // ETC1ENCODER_H
@@ -0,0 +1,167 @@
+#include "framepool.h"
+
+#include <stdlib.h>
+
+#include <QDebug>
+#include <QMutexLocker>
+
+
+#define DEFAULT_POOL_BUDGET (64*1024*1024) // Bytes of free buffers kept
+#define POOL_GRANULE        (256*1024)     // Buffers are allocated in multiples of this
+#define POOL_BUFFERS        32             // Free list slots reserved up front
+#define MAX_POOL_SLACK      2              // Free buffers over this many times the size needed are not taken
+
+
+FramePool::FramePool() {
+    maxFreeBytes = DEFAULT_POOL_BUDGET;
+    nFreeBytes   = 0;
+    nUsedBytes   = 0;
+    nAllocations = 0;
+    nReuses      = 0;
+    freeBuffers.reserve(POOL_BUFFERS);
+}
+
+
+// The pool of the process. Never destroyed: pooled images
+// (e.g. in other static objects) may outlive it otherwise.
+FramePool*
+FramePool::instance() {
+    static FramePool* pPool = new FramePool();
+    return pPool;
+}
+
+
+// An image on a recycled buffer: the smallest free one large enough
+// (but not much larger: a small image does not hold a screen sized
+// buffer) or, if there is none, a new one. Null if out of memory.
+QImage
+FramePool::image(int width, int height, QImage::Format format) {
+    if((width <= 0) || (height <= 0) || (format == QImage::Format_Invalid))
+        return QImage();
+    int bytesPerLine = ((width*QImage::toPixelFormat(format).bitsPerPixel() + 31) / 32) * 4;
+    qint64 needed = qint64(bytesPerLine)*height;
+    qint64 rounded = ((needed + POOL_GRANULE - 1) / POOL_GRANULE) * POOL_GRANULE;
+    Buffer* pBuffer = Q_NULLPTR;
+    {
+        QMutexLocker locker(&mutex);
+        int iBest = -1;
+        for(int i=0; i<freeBuffers.count(); i++) {
+            qint64 capacity = freeBuffers.at(i)->capacity;
+            if((capacity < needed) || (capacity > MAX_POOL_SLACK*rounded))
+                continue;
+            if((iBest < 0) || (capacity < freeBuffers.at(iBest)->capacity))
+                iBest = i;
+        }
+        if(iBest >= 0) {
+            pBuffer = freeBuffers.at(iBest);
+            freeBuffers[iBest] = freeBuffers.last();
+            freeBuffers.removeLast();
+            nFreeBytes -= pBuffer->capacity;
+            nUsedBytes += pBuffer->capacity;
+            nReuses++;
+        }
+    }
+    if(!pBuffer) {
+        uchar* pData = static_cast<uchar*>(malloc(size_t(rounded)));
+        if(!pData) {
+            qDebug() << "Unable to allocate" << rounded << "bytes for a" << width << "x" << height << "image";
+            return QImage();
+        }
+        pBuffer = new Buffer;
+        pBuffer->pPool    = this;
+        pBuffer->pData    = pData;
+        pBuffer->capacity = rounded;
+        QMutexLocker locker(&mutex);
+        nUsedBytes += rounded;
+        nAllocations++;
+    }
+    return QImage(pBuffer->pData, width, height, bytesPerLine, format, release, pBuffer);
+}
+
+
+QImage
+FramePool::image(QSize size, QImage::Format format) {
+    return image(size.width(), size.height(), format);
+}
+
+
+// Called by QImage when the last copy of a pooled image is gone
+void
+FramePool::release(void* pInfo) {
+    Buffer* pBuffer = static_cast<Buffer*>(pInfo);
+    pBuffer->pPool->recycle(pBuffer);
+}
+
+
+// Kept for the next image, unless the free buffers are over budget
+void
+FramePool::recycle(Buffer* pBuffer) {
+    QMutexLocker locker(&mutex);
+    nUsedBytes -= pBuffer->capacity;
+    if(nFreeBytes + pBuffer->capacity > maxFreeBytes) {
+        free(pBuffer->pData);
+        delete pBuffer;
+        return;
+    }
+    freeBuffers.append(pBuffer);
+    nFreeBytes += pBuffer->capacity;
+}
+
+
+// Bytes of free buffers kept for reuse: the largest free buffers are
+// released first when it shrinks
+void
+FramePool::setBudget(qint64 bytes) {
+    QMutexLocker locker(&mutex);
+    maxFreeBytes = qMax(qint64(0), bytes);
+    while((nFreeBytes > maxFreeBytes) && !freeBuffers.isEmpty()) {
+        int iLargest = 0;
+        for(int i=1; i<freeBuffers.count(); i++) {
+            if(freeBuffers.at(i)->capacity > freeBuffers.at(iLargest)->capacity)
+                iLargest = i;
+        }
+        Buffer* pBuffer = freeBuffers.at(iLargest);
+        freeBuffers[iLargest] = freeBuffers.last();
+        freeBuffers.removeLast();
+        nFreeBytes -= pBuffer->capacity;
+        free(pBuffer->pData);
+        delete pBuffer;
+    }
+}
+
+
+qint64
+FramePool::budget() {
+    QMutexLocker locker(&mutex);
+    return maxFreeBytes;
+}
+
+
+qint64
+FramePool::freeBytes() {
+    QMutexLocker locker(&mutex);
+    return nFreeBytes;
+}
+
+
+// Held by the images still alive
+qint64
+FramePool::usedBytes() {
+    QMutexLocker locker(&mutex);
+    return nUsedBytes;
+}
+
+
+// New buffers allocated (reuses excluded)
+int
+FramePool::allocations() {
+    QMutexLocker locker(&mutex);
+    return nAllocations;
+}
+
+
+int
+FramePool::reuses() {
+    QMutexLocker locker(&mutex);
+    return nReuses;
+}
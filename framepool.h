@@ -0,0 +1,47 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QImage>
+#include <QMutex>
+#include <QVector>
+
+
+// Recycles the pixel buffers of the decoded images and of the screen
+// frames. A pooled QImage gives its buffer back when its last copy
+// goes away (e.g. evicted from the SlideCache): once the pool holds
+// the working set, preparing a slide allocates no more pixel buffers
+// and the heap does not fragment over days of slide changes.
+class FramePool
+{
+public:
+    static FramePool* instance();
+    QImage image(int width, int height, QImage::Format format);
+    QImage image(QSize size, QImage::Format format);
+    void   setBudget(qint64 bytes);
+    qint64 budget();
+    qint64 freeBytes();
+    qint64 usedBytes();
+    int    allocations();
+    int    reuses();
+
+private:
+    FramePool();
+    struct Buffer {
+        FramePool* pPool;
+        uchar*     pData;
+        qint64     capacity;
+    };
+    static void release(void* pInfo);
+    void recycle(Buffer* pBuffer);
+
+private:
+    QMutex mutex;
+    QVector<Buffer*> freeBuffers;
+    qint64 maxFreeBytes;
+    qint64 nFreeBytes;
+    qint64 nUsedBytes;
+    int nAllocations;
+    int nReuses;
+};
+
+#endif // FRAMEPOOL_H
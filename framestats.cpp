@@ -0,0 +1,155 @@
+#include "framestats.h"
+
+#include <QtMath>
+
+
+#define BUCKET_WIDTH            100 // Histogram resolution (us)
+#define N_BUCKETS FRAME_HISTOGRAM_BUCKETS // Longer than 100ms go in the last one
+#define LOG_FIRST_BOUND          10 // Upper bound of the first logarithmic bucket (us)
+#define LOG_OCTAVE_BUCKETS       48 // Logarithmic buckets per doubling: 1.5% wide, up to 18s
+#define DEFAULT_FRAME_PERIOD  16667 // 60Hz display (us)
+
+
+FrameStats::FrameStats(Scale histogramScale) {
+    scale       = histogramScale;
+    framePeriod = DEFAULT_FRAME_PERIOD;
+    reset();
+}
+
+
+// Not to be called while samples are being added
+void
+FrameStats::reset() {
+    for(int i=0; i<N_BUCKETS; i++)
+        buckets[i].store(0);
+    minTime.store(-1);// No samples yet
+    maxTime.store(0);
+    totalTime.store(0);
+    nFrames.store(0);
+    nLate.store(0);
+}
+
+
+void
+FrameStats::setFramePeriod(qint64 periodUs) {
+    framePeriod = periodUs;
+}
+
+
+// A frame is late when it has missed (at least) one vsync
+void
+FrameStats::addFrame(qint64 frameTimeUs) {
+    if(frameTimeUs < 0)
+        return;
+    qint64 current = minTime.loadAcquire();
+    while(((current < 0) || (frameTimeUs < current)) &&
+          !minTime.testAndSetOrdered(current, frameTimeUs))
+    {
+        current = minTime.loadAcquire();
+    }
+    current = maxTime.loadAcquire();
+    while((frameTimeUs > current) &&
+          !maxTime.testAndSetOrdered(current, frameTimeUs))
+    {
+        current = maxTime.loadAcquire();
+    }
+    totalTime.fetchAndAddRelaxed(frameTimeUs);
+    if(2*frameTimeUs > 3*framePeriod)
+        nLate.fetchAndAddRelaxed(1);
+    buckets[bucketOf(frameTimeUs)].fetchAndAddRelaxed(1);
+    nFrames.fetchAndAddRelease(1);
+}
+
+
+int
+FrameStats::frames() {
+    return nFrames.loadAcquire();
+}
+
+
+int
+FrameStats::lateFrames() {
+    return nLate.loadAcquire();
+}
+
+
+qint64
+FrameStats::minimum() {
+    return qMax(qint64(0), minTime.loadAcquire());
+}
+
+
+qint64
+FrameStats::maximum() {
+    return maxTime.loadAcquire();
+}
+
+
+qint64
+FrameStats::average() {
+    int nSamples = nFrames.loadAcquire();
+    if(nSamples == 0)
+        return 0;
+    return totalTime.loadAcquire()/nSamples;
+}
+
+
+// Upper bound of the histogram bucket holding the given fraction of the frames
+qint64
+FrameStats::percentile(double fraction) {
+    int nSamples = nFrames.loadAcquire();
+    if(nSamples == 0)
+        return 0;
+    qint64 maxSample = maximum();
+    int nWanted = qCeil(fraction*nSamples);
+    int nSeen = 0;
+    for(int i=0; i<N_BUCKETS; i++) {
+        nSeen += buckets[i].loadAcquire();
+        if(nSeen >= nWanted)
+            return qMin(bucketBound(i), maxSample);
+    }
+    return maxSample;
+}
+
+
+// The bucket counts up to the last non empty one
+QVector<int>
+FrameStats::histogram() {
+    QVector<int> counts;
+    int nUsed = 0;
+    for(int i=0; i<N_BUCKETS; i++) {
+        counts.append(buckets[i].loadAcquire());
+        if(counts.last() != 0)
+            nUsed = i+1;
+    }
+    counts.resize(nUsed);
+    return counts;
+}
+
+
+// Of the linear scale
+int
+FrameStats::bucketWidth() {
+    return BUCKET_WIDTH;
+}
+
+
+// Longer times go in the last bucket
+int
+FrameStats::bucketOf(qint64 timeUs) {
+    if(scale == LinearScale)
+        return int(qMin(timeUs/BUCKET_WIDTH, qint64(N_BUCKETS-1)));
+    if(timeUs <= LOG_FIRST_BOUND)
+        return 0;
+    int iBucket = qCeil(LOG_OCTAVE_BUCKETS*qLn(double(timeUs)/LOG_FIRST_BOUND)/M_LN2);
+    return qMin(iBucket, N_BUCKETS-1);
+}
+
+
+// The longest time counted in iBucket
+qint64
+FrameStats::bucketBound(int iBucket) {
+    if(scale == LinearScale)
+        return qint64(iBucket+1)*BUCKET_WIDTH;
+    return qCeil(LOG_FIRST_BOUND*qPow(2.0, double(iBucket)/LOG_OCTAVE_BUCKETS));
+}
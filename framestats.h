@@ -0,0 +1,53 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+
+#define FRAME_HISTOGRAM_BUCKETS 1000
+
+
+// Histogram of durations (frame times, decode and upload latencies).
+// Samples are added lock free so that more threads may feed and
+// read the same instance while the slide show is running.
+// Frame times use linear 100us buckets (up to 100ms): latencies
+// that may take seconds (decodes, uploads) a logarithmic scale.
+class FrameStats
+{
+public:
+    enum Scale {
+        LinearScale,
+        LogScale
+    };
+    FrameStats(Scale histogramScale = LinearScale);
+    void reset();
+    void setFramePeriod(qint64 periodUs);
+    void addFrame(qint64 frameTimeUs);
+    int    frames();
+    int    lateFrames();
+    qint64 minimum();
+    qint64 maximum();
+    qint64 average();
+    qint64 percentile(double fraction);
+    QVector<int> histogram();
+    static int bucketWidth();
+
+private:
+    int    bucketOf(qint64 timeUs);
+    qint64 bucketBound(int iBucket);
+
+private:
+    QAtomicInt buckets[FRAME_HISTOGRAM_BUCKETS];
+    Scale scale;
+    qint64 framePeriod;
+    QAtomicInteger<qint64> minTime;
+    QAtomicInteger<qint64> maxTime;
+    QAtomicInteger<qint64> totalTime;
+    QAtomicInt nFrames;
+    QAtomicInt nLate;
+};
+
+#endif // FRAMESTATS_H
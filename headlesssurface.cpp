@@ -0,0 +1,77 @@
+#include "headlesssurface.h"
+
+#include <string.h>
+
+#include "GLES2/gl2.h"
+
+
+HeadlessSurface::HeadlessSurface(int width, int height) {
+    surfaceWidth  = width;
+    surfaceHeight = height;
+}
+
+
+bool
+HeadlessSurface::openNative() {
+    return (surfaceWidth > 0) && (surfaceHeight > 0);
+}
+
+
+void
+HeadlessSurface::closeNative() {
+}
+
+
+// Without a window system prefer the Mesa surfaceless platform
+EGLDisplay
+HeadlessSurface::getDisplay() {
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    const char* sExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(sExtensions && strstr(sExtensions, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC pGetPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if(pGetPlatformDisplay) {
+            EGLDisplay surfacelessDisplay = pGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                                                EGL_DEFAULT_DISPLAY,
+                                                                Q_NULLPTR);
+            if(surfacelessDisplay != EGL_NO_DISPLAY)
+                return surfacelessDisplay;
+        }
+    }
+#endif
+    return RenderSurface::getDisplay();
+}
+
+
+EGLint
+HeadlessSurface::surfaceType() {
+    return EGL_PBUFFER_BIT;
+}
+
+
+EGLSurface
+HeadlessSurface::createSurface(EGLConfig config) {
+    const EGLint pbuffer_attributes[] =
+    {
+        EGL_WIDTH,  surfaceWidth,
+        EGL_HEIGHT, surfaceHeight,
+        EGL_NONE
+    };
+    return eglCreatePbufferSurface(display, config, pbuffer_attributes);
+}
+
+
+// Nothing to synchronize with
+EGLint
+HeadlessSurface::swapInterval() {
+    return 0;
+}
+
+
+// Swapping a pbuffer does nothing: wait for the
+// rendering to complete to have meaningful timings
+bool
+HeadlessSurface::swapBuffers() {
+    glFinish();
+    return RenderSurface::swapBuffers();
+}
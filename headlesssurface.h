@@ -0,0 +1,24 @@
+#ifndef HEADLESSSURFACE_H
+#define HEADLESSSURFACE_H
+
+#include "rendersurface.h"
+
+
+// Off screen pbuffer, e.g. on Mesa llvmpipe, to run the
+// renderer on machines without a display (or without a Pi)
+class HeadlessSurface : public RenderSurface
+{
+public:
+    HeadlessSurface(int width, int height);
+    bool swapBuffers();
+
+protected:
+    bool openNative();
+    void closeNative();
+    EGLDisplay getDisplay();
+    EGLint surfaceType();
+    EGLSurface createSurface(EGLConfig config);
+    EGLint swapInterval();
+};
+
+#endif // HEADLESSSURFACE_H
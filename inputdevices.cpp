@@ -0,0 +1,256 @@
+#include "inputdevices.h"
+
+#include <linux/input.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+
+#define INPUT_DIR  "/dev/input"
+#define BY_ID_DIR  "/dev/input/by-id"
+#define KEYBOARD_FILTER "*event-kbd*"
+
+
+InputDevices::InputDevices(QObject* parent)
+    : QObject(parent)
+{
+    inotifyFd        = -1;
+    byIdWatch        = -1;
+    inputWatch       = -1;
+    pInotifyNotifier = Q_NULLPTR;
+    nTypedIndex      = 0;
+}
+
+
+InputDevices::~InputDevices() {
+    close();
+}
+
+
+// Same clock of the event timestamps (see EVIOCSCLOCKID)
+qint64
+InputDevices::monotonicTimeUs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec)*1000000 + now.tv_nsec/1000;
+}
+
+
+bool
+InputDevices::open() {
+    close();
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotifyFd == -1) {
+        qDebug() << "inotify_init1() failed:" << strerror(errno);
+    }
+    else {
+        // by-id may appear only when the first device is plugged in
+        inputWatch = inotify_add_watch(inotifyFd, INPUT_DIR, IN_CREATE);
+        byIdWatch  = inotify_add_watch(inotifyFd, BY_ID_DIR, IN_CREATE | IN_DELETE);
+        pInotifyNotifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+        connect(pInotifyNotifier, SIGNAL(activated(int)),
+                this, SLOT(onInotifyEvent()));
+    }
+    scanDevices();
+    return !devices.isEmpty();
+}
+
+
+void
+InputDevices::close() {
+    QList<int> fds = devices.keys();
+    for(int i=0; i<fds.count(); i++)
+        closeDevice(fds.at(i));
+    if(pInotifyNotifier) {
+        pInotifyNotifier->setEnabled(false);
+        pInotifyNotifier->deleteLater();
+        pInotifyNotifier = Q_NULLPTR;
+    }
+    if(inotifyFd != -1)
+        ::close(inotifyFd);// Removes the watches too
+    inotifyFd  = -1;
+    byIdWatch  = -1;
+    inputWatch = -1;
+}
+
+
+int
+InputDevices::count() {
+    return devices.count();
+}
+
+
+// Open the keyboards not yet opened
+void
+InputDevices::scanDevices() {
+    QDir byIdDir(BY_ID_DIR);
+    if(!byIdDir.exists())
+        return;
+    byIdDir.setNameFilters(QStringList() << KEYBOARD_FILTER);
+    byIdDir.setFilter(QDir::Files | QDir::System);
+    QFileInfoList fileList = byIdDir.entryInfoList();
+    for(int i=0; i<fileList.count(); i++) {
+        QString sPath = fileList.at(i).absoluteFilePath();
+        bool bOpened = false;
+        QHash<int, InputDevice>::const_iterator it;
+        for(it=devices.constBegin(); it!=devices.constEnd(); ++it) {
+            if(it.value().sPath == sPath)
+                bOpened = true;
+        }
+        if(!bOpened)
+            openDevice(sPath);
+    }
+}
+
+
+void
+InputDevices::openDevice(QString sPath) {
+    int fd = ::open(QFile::encodeName(sPath).constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if(fd == -1) {
+        qDebug() << "Unable to open" << sPath << strerror(errno);
+        return;
+    }
+    if(ioctl(fd, EVIOCGRAB, 1) != 0)
+        qDebug() << "Unable to get exclusive access to" << sPath;
+    // Timestamps comparable with monotonicTimeUs()
+    int clockId = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clockId);
+    InputDevice device;
+    device.sPath     = sPath;
+    device.pNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(device.pNotifier, SIGNAL(activated(int)),
+            this, SLOT(onDeviceReadable(int)));
+    devices.insert(fd, device);
+    qDebug() << "Keyboard" << sPath << "connected";
+}
+
+
+void
+InputDevices::closeDevice(int fd) {
+    if(!devices.contains(fd))
+        return;
+    InputDevice device = devices.take(fd);
+    device.pNotifier->setEnabled(false);
+    device.pNotifier->deleteLater();
+    ioctl(fd, EVIOCGRAB, 0);
+    ::close(fd);
+}
+
+
+void
+InputDevices::onInotifyEvent() {
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    bool bChanged = false;
+    forever {
+        ssize_t len = read(inotifyFd, buffer, sizeof(buffer));
+        if(len <= 0)
+            break;
+        for(char* ptr=buffer; ptr<buffer+len; ) {
+            const struct inotify_event* pEvent = reinterpret_cast<const struct inotify_event*>(ptr);
+            if((pEvent->wd == inputWatch) &&
+               (pEvent->len > 0) &&
+               (strcmp(pEvent->name, "by-id") == 0))
+            {
+                byIdWatch = inotify_add_watch(inotifyFd, BY_ID_DIR, IN_CREATE | IN_DELETE);
+            }
+            bChanged = true;
+            ptr += sizeof(struct inotify_event) + pEvent->len;
+        }
+    }
+    if(!bChanged)
+        return;
+    // Unplugged keyboards are also noticed by read() (ENODEV)
+    QList<int> fds = devices.keys();
+    for(int i=0; i<fds.count(); i++) {
+        if(!QFileInfo::exists(devices.value(fds.at(i)).sPath))
+            closeDevice(fds.at(i));
+    }
+    scanDevices();
+}
+
+
+void
+InputDevices::onDeviceReadable(int fd) {
+    struct input_event events[64];
+    forever {
+        ssize_t rd = read(fd, events, sizeof(events));
+        if(rd < 0) {
+            if(errno == ENODEV) {
+                qDebug() << "Keyboard" << devices.value(fd).sPath << "disconnected";
+                closeDevice(fd);
+            }
+            return;// EAGAIN: nothing more to read
+        }
+        if(rd == 0)
+            return;
+        int count = int(rd / sizeof(struct input_event));
+        for(int n=0; n<count; n++) {
+            const struct input_event& event = events[n];
+            // value: 0 Released, 1 Pressed, 2 Autorepeat (ignored)
+            if((event.type == EV_KEY) && (event.value == 1)) {
+                qint64 eventTime = qint64(event.time.tv_sec)*1000000 + event.time.tv_usec;
+                keyPressed(event.code, eventTime);
+            }
+        }
+    }
+}
+
+
+void
+InputDevices::keyPressed(int code, qint64 eventTimeUs) {
+    switch(code) {
+        case KEY_ESC:
+        case KEY_Q:
+            emit exitRequested();
+            break;
+        case KEY_RIGHT:
+        case KEY_DOWN:
+        case KEY_PAGEDOWN:
+        case KEY_N:
+            nTypedIndex = 0;
+            emit nextRequested(eventTimeUs);
+            break;
+        case KEY_LEFT:
+        case KEY_UP:
+        case KEY_PAGEUP:
+        case KEY_BACKSPACE:
+            nTypedIndex = 0;
+            emit previousRequested(eventTimeUs);
+            break;
+        case KEY_SPACE:
+        case KEY_P:
+        case KEY_PAUSE:
+            nTypedIndex = 0;
+            emit pauseRequested(eventTimeUs);
+            break;
+        case KEY_HOME:
+            nTypedIndex = 0;
+            emit jumpRequested(0, eventTimeUs);
+            break;
+        case KEY_ENTER:
+        case KEY_KPENTER:// Jump to the (1 based) slide number just typed
+            if(nTypedIndex > 0)
+                emit jumpRequested(nTypedIndex-1, eventTimeUs);
+            nTypedIndex = 0;
+            break;
+        default: {
+            int digit = -1;
+            if((code >= KEY_1) && (code <= KEY_9))
+                digit = code - KEY_1 + 1;
+            else if(code == KEY_0)
+                digit = 0;
+            if(digit >= 0)
+                nTypedIndex = qMin(nTypedIndex*10 + digit, 10000000);
+            break;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef INPUTDEVICES_H
+#define INPUTDEVICES_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSocketNotifier>
+
+
+// The keyboards in /dev/input/by-id, grabbed for exclusive use.
+// Events are read as soon as they arrive (through QSocketNotifier)
+// and devices plugged or unplugged while running are followed
+// through inotify. Key presses are translated into slide show
+// commands carrying the (CLOCK_MONOTONIC) time of the key press.
+class InputDevices : public QObject
+{
+    Q_OBJECT
+public:
+    InputDevices(QObject* parent = Q_NULLPTR);
+    ~InputDevices();
+    bool open();
+    void close();
+    int  count();
+    static qint64 monotonicTimeUs();
+
+signals:
+    void nextRequested(qint64 eventTimeUs);
+    void previousRequested(qint64 eventTimeUs);
+    void pauseRequested(qint64 eventTimeUs);
+    void jumpRequested(int iSlide, qint64 eventTimeUs);
+    void exitRequested();
+
+private slots:
+    void onDeviceReadable(int fd);
+    void onInotifyEvent();
+
+private:
+    void scanDevices();
+    void openDevice(QString sPath);
+    void closeDevice(int fd);
+    void keyPressed(int code, qint64 eventTimeUs);
+
+private:
+    struct InputDevice {
+        QString sPath;
+        QSocketNotifier* pNotifier;
+    };
+    QHash<int, InputDevice> devices;// By file descriptor
+    int inotifyFd;
+    int byIdWatch;
+    int inputWatch;
+    QSocketNotifier* pInotifyNotifier;
+    int nTypedIndex;// Digits typed before Enter
+};
+
+#endif // INPUTDEVICES_H
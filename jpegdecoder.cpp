@@ -0,0 +1,263 @@
+#include "jpegdecoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+
+#include "framepool.h"
+#include "stripdecoder.h"
+
+
+#ifdef JCS_EXTENSIONS
+#define JPEG_OUT_COLOR_SPACE JCS_EXT_RGBX
+#define JPEG_IMAGE_FORMAT    QImage::Format_RGBX8888
+#define JPEG_OUT_PIXEL_BYTES 4
+#else
+#define JPEG_OUT_COLOR_SPACE JCS_RGB
+#define JPEG_IMAGE_FORMAT    QImage::Format_RGB888
+#define JPEG_OUT_PIXEL_BYTES 3
+#endif
+
+#define MAX_STRIP_ROWS 64 // Scanlines read at once by decodeStrips()
+#define JPEG_WORK_BYTES (1024*1024) // libjpeg tables and row buffers
+
+
+struct JpegErrorManager {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmpBuffer;
+};
+
+
+static void
+jpegErrorExit(j_common_ptr cinfo) {
+    JpegErrorManager* pError = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+    char sMessage[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, sMessage);
+    qDebug() << "libjpeg:" << sMessage;
+    longjmp(pError->setjmpBuffer, 1);
+}
+
+
+static void
+jpegOutputMessage(j_common_ptr cinfo) {
+    Q_UNUSED(cinfo)
+    // Corrupt data warnings are not worth a message for each slide
+}
+
+
+// The DCT coefficients a progressive file keeps until its last scan:
+// all of them (2 bytes each) and at full size, whatever the scale
+static qint64
+coefficientBytes(j_decompress_ptr cinfo) {
+    if(!cinfo->progressive_mode)
+        return 0;
+    qint64 bytes = 0;
+    for(int i=0; i<cinfo->num_components; i++) {
+        const jpeg_component_info* pComponent = &cinfo->comp_info[i];
+        qint64 columns = (pComponent->width_in_blocks + pComponent->h_samp_factor - 1)/
+                         pComponent->h_samp_factor*pComponent->h_samp_factor;
+        qint64 rows    = (pComponent->height_in_blocks + pComponent->v_samp_factor - 1)/
+                         pComponent->v_samp_factor*pComponent->v_samp_factor;
+        bytes += columns*rows*qint64(sizeof(JBLOCK));
+    }
+    return bytes;
+}
+
+
+bool
+JpegDecoder::isJpeg(QString sFile) {
+    QString sSuffix = QFileInfo(sFile).suffix().toLower();
+    return (sSuffix == "jpg") || (sSuffix == "jpeg");
+}
+
+
+// The largest libjpeg scale denominator (1, 2, 4 or 8) giving an image
+// still not smaller than the one that will be shown on the screen
+int
+JpegDecoder::scaleDenominator(int imageWidth, int imageHeight,
+                              int screenWidth, int screenHeight)
+{
+    if((imageWidth <= 0) || (imageHeight <= 0))
+        return 1;
+    double fScale = qMin(double(screenWidth)/double(imageWidth),
+                         double(screenHeight)/double(imageHeight));
+    int denominator = 1;
+    while((denominator < 8) && (2.0*denominator*fScale <= 1.0))
+        denominator *= 2;
+    return denominator;
+}
+
+
+// Decode a JPEG file directly in the pixel buffer of *pImage letting
+// libjpeg downscale it in the DCT domain. Returns false if the file has to
+// be decoded by the generic Qt path (or, with a memoryLimit, in strips).
+bool
+JpegDecoder::decode(QString sFile, int screenWidth, int screenHeight, QImage* pImage,
+                    qint64 memoryLimit)
+{
+    FILE* pFile = fopen(QFile::encodeName(sFile).constData(), "rb");
+    if(!pFile)
+        return false;
+
+    struct jpeg_decompress_struct cinfo;
+    JpegErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit     = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    if(setjmp(jerr.setjmpBuffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(pFile);
+        *pImage = QImage();
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, pFile);
+    jpeg_read_header(&cinfo, TRUE);
+    if((cinfo.jpeg_color_space == JCS_CMYK) ||
+       (cinfo.jpeg_color_space == JCS_YCCK))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(pFile);
+        return false;
+    }
+    cinfo.out_color_space = JPEG_OUT_COLOR_SPACE;
+    cinfo.scale_num       = 1;
+    cinfo.scale_denom     = scaleDenominator(cinfo.image_width, cinfo.image_height,
+                                             screenWidth, screenHeight);
+    if(memoryLimit > 0) {
+        // The image and libjpeg share the limit. A progressive file is
+        // decoded smaller (below the screen size if need be) to leave
+        // room for its coefficients.
+        qint64 jpegBytes = coefficientBytes(&cinfo) + JPEG_WORK_BYTES;
+        jpeg_calc_output_dimensions(&cinfo);
+        qint64 imageBytes = 4*qint64(cinfo.output_width)*cinfo.output_height;
+        while(cinfo.progressive_mode && (cinfo.scale_denom < 8) &&
+              (jpegBytes + imageBytes > memoryLimit))
+        {
+            cinfo.scale_denom *= 2;
+            jpeg_calc_output_dimensions(&cinfo);
+            imageBytes = 4*qint64(cinfo.output_width)*cinfo.output_height;
+        }
+        if(!cinfo.progressive_mode && (imageBytes > memoryLimit)) {// Decoded in strips
+            jpeg_destroy_decompress(&cinfo);
+            fclose(pFile);
+            return false;
+        }
+        // Without a backing store libjpeg fails instead of going over.
+        // The coefficients are needed in any case (the strips too would
+        // need them): better over the limit than an empty slide.
+        if(jpegBytes + imageBytes > memoryLimit)
+            qDebug() << sFile << "needs" << (jpegBytes + imageBytes)/(1024*1024)
+                     << "MB, over the memory limit, for its progressive coefficients";
+        cinfo.mem->max_memory_to_use = long(qMax(memoryLimit - imageBytes, jpegBytes));
+    }
+    jpeg_start_decompress(&cinfo);
+
+    *pImage = FramePool::instance()->image(int(cinfo.output_width), int(cinfo.output_height), JPEG_IMAGE_FORMAT);
+    if(pImage->isNull()) {
+        qDebug() << "Unable to allocate" << cinfo.output_width << "x" << cinfo.output_height << "pixels";
+        jpeg_destroy_decompress(&cinfo);
+        fclose(pFile);
+        return false;
+    }
+    JSAMPROW row;
+    while(cinfo.output_scanline < cinfo.output_height) {
+        row = pImage->scanLine(cinfo.output_scanline);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(pFile);
+    return true;
+}
+
+
+// The same DCT domain downscaling, then the rows are box filtered to
+// the screen size a strip at a time: the whole image is never in memory
+bool
+JpegDecoder::decodeStrips(QString sFile, int screenWidth, int screenHeight,
+                          qint64 memoryLimit, QImage* pImage)
+{
+    FILE* pFile = fopen(QFile::encodeName(sFile).constData(), "rb");
+    if(!pFile)
+        return false;
+
+    struct jpeg_decompress_struct cinfo;
+    JpegErrorManager jerr;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit     = jpegErrorExit;
+    jerr.pub.output_message = jpegOutputMessage;
+    // Volatile: they change after setjmp()
+    uchar* volatile pStrip = Q_NULLPTR;
+    RowScaler* volatile pScaler = Q_NULLPTR;
+    if(setjmp(jerr.setjmpBuffer)) {
+        delete pScaler;
+        free(pStrip);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(pFile);
+        *pImage = QImage();
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, pFile);
+    jpeg_read_header(&cinfo, TRUE);
+    if((cinfo.jpeg_color_space == JCS_CMYK) ||
+       (cinfo.jpeg_color_space == JCS_YCCK))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(pFile);
+        return false;
+    }
+    cinfo.out_color_space = JPEG_OUT_COLOR_SPACE;
+    cinfo.scale_num       = 1;
+    cinfo.scale_denom     = scaleDenominator(cinfo.image_width, cinfo.image_height,
+                                             screenWidth, screenHeight);
+    jpeg_calc_output_dimensions(&cinfo);
+    int width  = int(cinfo.output_width);
+    int height = int(cinfo.output_height);
+    QSize size = RowScaler::fitSize(width, height, screenWidth, screenHeight);
+    qint64 rowBytes   = JPEG_OUT_PIXEL_BYTES*qint64(width);
+    qint64 fixedBytes = 4*qint64(size.width())*size.height() +
+                        RowScaler::memoryBytes(width, size.width());
+    // libjpeg gets half of what is left, the strip rows the rest
+    qint64 stripBytes = (memoryLimit - fixedBytes)/2;
+    int nStripRows = int(qMin(qint64(MAX_STRIP_ROWS), stripBytes/qMax(rowBytes, qint64(1))));
+    if(nStripRows < int(cinfo.rec_outbuf_height)) {
+        qDebug() << sFile << "is too large to be shown";
+        jpeg_destroy_decompress(&cinfo);
+        fclose(pFile);
+        return false;
+    }
+    cinfo.mem->max_memory_to_use = long(stripBytes);
+    *pImage = FramePool::instance()->image(size, QImage::Format_RGBA8888_Premultiplied);
+    pStrip  = static_cast<uchar*>(malloc(size_t(rowBytes*nStripRows)));
+    if(pImage->isNull() || !pStrip) {
+        free(pStrip);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(pFile);
+        *pImage = QImage();
+        return false;
+    }
+    pScaler = new RowScaler(width, height, pImage);
+    jpeg_start_decompress(&cinfo);
+    JSAMPROW rows[MAX_STRIP_ROWS];
+    for(int i=0; i<nStripRows; i++)
+        rows[i] = pStrip + i*rowBytes;
+    while(cinfo.output_scanline < cinfo.output_height) {
+        int nRead = int(jpeg_read_scanlines(&cinfo, rows, JDIMENSION(nStripRows)));
+        for(int i=0; i<nRead; i++)
+            pScaler->addRow(rows[i], JPEG_OUT_PIXEL_BYTES, false);
+    }
+    pScaler->finish();
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    delete pScaler;
+    free(pStrip);
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,20 @@
+#ifndef JPEGDECODER_H
+#define JPEGDECODER_H
+
+#include <QString>
+#include <QImage>
+
+
+class JpegDecoder
+{
+public:
+    static bool isJpeg(QString sFile);
+    static int  scaleDenominator(int imageWidth, int imageHeight,
+                                 int screenWidth, int screenHeight);
+    static bool decode(QString sFile, int screenWidth, int screenHeight, QImage* pImage,
+                       qint64 memoryLimit = 0);
+    static bool decodeStrips(QString sFile, int screenWidth, int screenHeight,
+                             qint64 memoryLimit, QImage* pImage);
+};
+
+#endif // JPEGDECODER_H
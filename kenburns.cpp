@@ -0,0 +1,72 @@
+#include "kenburns.h"
+
+#include <stdlib.h>
+
+
+#define MIN_ZOOM_FRACTION 0.25f // Of the zoom range, at the widest end of the motion
+
+
+KenBurns::KenBurns() {
+    bActive   = false;
+    startTime = 0;
+    duration  = 1;
+    from = to = fullWindow();
+}
+
+
+// The whole slide
+QVector4D
+KenBurns::fullWindow() {
+    return QVector4D(0.0f, 0.0f, 1.0f, 1.0f);
+}
+
+
+// A window zoom times smaller than the slide, anywhere inside it
+QVector4D
+KenBurns::randomWindow(float zoom) {
+    float size = 1.0f/zoom;
+    float x = (1.0f-size)*float(qrand())/float(RAND_MAX);
+    float y = (1.0f-size)*float(qrand())/float(RAND_MAX);
+    return QVector4D(x, y, size, size);
+}
+
+
+// A random zoom in or out (up to maxZoom) with a random pan, lasting
+// durationUs: the time the slide stays on screen, transitions included
+void
+KenBurns::start(qint64 nowUs, qint64 durationUs, float maxZoom) {
+    maxZoom = qMax(1.0f, maxZoom);
+    float minZoom = 1.0f + MIN_ZOOM_FRACTION*(maxZoom-1.0f);
+    from = randomWindow(maxZoom);
+    to   = randomWindow(minZoom);
+    if(qrand() & 1)
+        qSwap(from, to);
+    startTime = nowUs;
+    duration  = qMax(qint64(1), durationUs);
+    bActive   = true;
+}
+
+
+void
+KenBurns::stop() {
+    bActive = false;
+}
+
+
+bool
+KenBurns::isActive() {
+    return bActive;
+}
+
+
+// Both the ends lie inside the slide and so does any window in
+// between: the screen is always covered. The motion eases in and out
+// and then stays still at the end.
+QVector4D
+KenBurns::window(qint64 nowUs) {
+    if(!bActive)
+        return fullWindow();
+    float t = qBound(0.0f, float(nowUs-startTime)/float(duration), 1.0f);
+    t = t*t*(3.0f-2.0f*t);
+    return from + (to-from)*t;
+}
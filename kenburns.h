@@ -0,0 +1,33 @@
+#ifndef KENBURNS_H
+#define KENBURNS_H
+
+#include <QtGlobal>
+#include <QVector4D>
+
+
+// The slow pan and zoom of a slide while it is on screen. The motion
+// goes from one window of the slide texture (x, y offset and width,
+// height in texture coordinates) to another: the slide is never
+// re-rendered, the sampling window just moves a little every frame.
+class KenBurns
+{
+public:
+    KenBurns();
+    static QVector4D fullWindow();
+    void start(qint64 nowUs, qint64 durationUs, float maxZoom);
+    void stop();
+    bool isActive();
+    QVector4D window(qint64 nowUs);
+
+private:
+    static QVector4D randomWindow(float zoom);
+
+private:
+    bool bActive;
+    qint64 startTime;
+    qint64 duration;
+    QVector4D from;
+    QVector4D to;
+};
+
+#endif // KENBURNS_H
@@ -0,0 +1,219 @@
+#include "letterbox.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+// Over a white background a premultiplied pixel becomes:
+//     color = color + (255 - alpha), alpha = 255
+// that is exactly what QPainter SourceOver gives.
+static inline unsigned char
+addSaturated(unsigned char a, unsigned char b) {
+    unsigned int sum = unsigned(a) + unsigned(b);
+    return (sum > 255) ? 255 : (unsigned char)(sum);
+}
+
+
+// All read before writing: pSrc may be pDst
+static inline void
+composePixel(const unsigned char* pSrc, unsigned char* pDst, bool bSwapRB) {
+    unsigned char k = 255 - pSrc[3];
+    unsigned char r = pSrc[bSwapRB ? 2 : 0];
+    unsigned char g = pSrc[1];
+    unsigned char b = pSrc[bSwapRB ? 0 : 2];
+    pDst[0] = addSaturated(r, k);
+    pDst[1] = addSaturated(g, k);
+    pDst[2] = addSaturated(b, k);
+    pDst[3] = 255;
+}
+
+
+#if defined(__AVX2__)
+
+static int
+composeRowSimd(const unsigned char* pSrc, unsigned char* pDst, int nPixels, bool bSwapRB) {
+    const __m256i alphaMask = _mm256_set1_epi32(int(0xff000000));
+    const __m256i spreadAlpha = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+                                                 3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+    const __m256i swapRB = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int i = 0;
+    for(; i+8<=nPixels; i+=8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + 4*i));
+        // 255-alpha in every byte (alpha itself becomes 255 in the sum)
+        __m256i k = _mm256_andnot_si256(_mm256_shuffle_epi8(pixels, spreadAlpha),
+                                        _mm256_set1_epi8(char(0xff)));
+        pixels = _mm256_or_si256(_mm256_adds_epu8(pixels, k), alphaMask);
+        if(bSwapRB)
+            pixels = _mm256_shuffle_epi8(pixels, swapRB);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + 4*i), pixels);
+    }
+    return i;
+}
+
+#elif defined(__SSE2__)
+
+static int
+composeRowSimd(const unsigned char* pSrc, unsigned char* pDst, int nPixels, bool bSwapRB) {
+    const __m128i alphaMask = _mm_set1_epi32(int(0xff000000));
+    const __m128i gaMask    = _mm_set1_epi32(int(0xff00ff00));
+    const __m128i byteMask  = _mm_set1_epi32(0x000000ff);
+    int i = 0;
+    for(; i+4<=nPixels; i+=4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 4*i));
+        __m128i alpha = _mm_srli_epi32(pixels, 24);
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        __m128i k = _mm_xor_si128(alpha, _mm_set1_epi8(char(0xff)));
+        pixels = _mm_or_si128(_mm_adds_epu8(pixels, k), alphaMask);
+        if(bSwapRB) {
+            __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask);
+            __m128i b = _mm_slli_epi32(_mm_and_si128(pixels, byteMask), 16);
+            pixels = _mm_or_si128(_mm_and_si128(pixels, gaMask), _mm_or_si128(r, b));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 4*i), pixels);
+    }
+    return i;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static int
+composeRowSimd(const unsigned char* pSrc, unsigned char* pDst, int nPixels, bool bSwapRB) {
+    const uint8x16_t opaque = vdupq_n_u8(255);
+    int i = 0;
+    for(; i+16<=nPixels; i+=16) {
+        uint8x16x4_t pixels = vld4q_u8(pSrc + 4*i);
+        uint8x16_t k = vmvnq_u8(pixels.val[3]);
+        uint8x16x4_t result;
+        result.val[0] = vqaddq_u8(pixels.val[bSwapRB ? 2 : 0], k);
+        result.val[1] = vqaddq_u8(pixels.val[1], k);
+        result.val[2] = vqaddq_u8(pixels.val[bSwapRB ? 0 : 2], k);
+        result.val[3] = opaque;
+        vst4q_u8(pDst + 4*i, result);
+    }
+    return i;
+}
+
+#else
+
+static int
+composeRowSimd(const unsigned char* pSrc, unsigned char* pDst, int nPixels, bool bSwapRB) {
+    (void)pSrc;
+    (void)pDst;
+    (void)nPixels;
+    (void)bSwapRB;
+    return 0;
+}
+
+#endif
+
+
+void
+composeRow(const unsigned char* pSrc, unsigned char* pDst, int nPixels, bool bSwapRB) {
+    int i = composeRowSimd(pSrc, pDst, nPixels, bSwapRB);
+    for(; i<nPixels; i++)
+        composePixel(pSrc + 4*i, pDst + 4*i, bSwapRB);
+}
+
+
+static inline void
+fillWhite(unsigned char* pDst, int nPixels) {
+    memset(pDst, 0xff, size_t(nPixels)*4);
+}
+
+
+void
+letterboxFlip(const unsigned char* pSrc, int srcWidth, int srcHeight, int srcStride,
+              bool bSwapRB,
+              unsigned char* pDst, int dstWidth, int dstHeight, int dstStride)
+{
+    if(srcWidth  > dstWidth)  srcWidth  = dstWidth;
+    if(srcHeight > dstHeight) srcHeight = dstHeight;
+    if(srcWidth  < 0)         srcWidth  = 0;
+    if(srcHeight < 0)         srcHeight = 0;
+    int x0 = (dstWidth-srcWidth)/2;
+    int y0 = (dstHeight-srcHeight)/2;
+    int xRight = dstWidth - x0 - srcWidth;
+
+    for(int y=0; y<dstHeight; y++) {
+        unsigned char* pRow = pDst + size_t(y)*dstStride;
+        int iSrcRow = srcHeight - 1 - (y-y0);
+        if((srcWidth == 0) || (y < y0) || (y >= y0+srcHeight)) {
+            fillWhite(pRow, dstWidth);
+            continue;
+        }
+        fillWhite(pRow, x0);
+        composeRow(pSrc + size_t(iSrcRow)*srcStride, pRow + 4*x0, srcWidth, bSwapRB);
+        fillWhite(pRow + 4*(x0+srcWidth), xRight);
+    }
+}
+
+
+// Pixel centers map to pixel centers: scaled pixel x picks source
+// column ((2x+1)*srcWidth)/(2*scaledWidth), stepped exactly as a
+// quotient and a remainder (rows the same way). The picked pixels
+// are gathered straight into the frame row and composed there.
+void
+letterboxScaleFlip(const unsigned char* pSrc, int srcWidth, int srcHeight, int srcStride,
+                   bool bSwapRB, int scaledWidth, int scaledHeight,
+                   unsigned char* pDst, int dstWidth, int dstHeight, int dstStride)
+{
+    if((scaledWidth == srcWidth) && (scaledHeight == srcHeight)) {
+        letterboxFlip(pSrc, srcWidth, srcHeight, srcStride, bSwapRB,
+                      pDst, dstWidth, dstHeight, dstStride);
+        return;
+    }
+    if(scaledWidth  > dstWidth)  scaledWidth  = dstWidth;
+    if(scaledHeight > dstHeight) scaledHeight = dstHeight;
+    if((srcWidth <= 0) || (srcHeight <= 0) || (scaledWidth <= 0) || (scaledHeight <= 0))
+        scaledWidth = scaledHeight = 0;
+    int x0 = (dstWidth-scaledWidth)/2;
+    int y0 = (dstHeight-scaledHeight)/2;
+    int xRight = dstWidth - x0 - scaledWidth;
+    long long xDenominator = 2LL*scaledWidth;
+    int xFirst = scaledWidth ? int(srcWidth/xDenominator) : 0;
+    int xStep  = scaledWidth ? int((2LL*srcWidth)/xDenominator) : 0;
+    long long xFirstRemainder = scaledWidth ? srcWidth % xDenominator : 0;
+    long long xRemainderStep  = scaledWidth ? (2LL*srcWidth) % xDenominator : 0;
+
+    int iLastSrcRow = -1;
+    for(int y=0; y<dstHeight; y++) {
+        unsigned char* pRow = pDst + size_t(y)*dstStride;
+        if((scaledWidth == 0) || (y < y0) || (y >= y0+scaledHeight)) {
+            fillWhite(pRow, dstWidth);
+            continue;
+        }
+        int iScaledRow = scaledHeight - 1 - (y-y0);
+        int iSrcRow = int(((2LL*iScaledRow + 1)*srcHeight) / (2LL*scaledHeight));
+        // Enlarged rows repeat the previous one
+        if(iSrcRow == iLastSrcRow) {
+            memcpy(pRow, pRow - dstStride, size_t(dstWidth)*4);
+            continue;
+        }
+        iLastSrcRow = iSrcRow;
+        fillWhite(pRow, x0);
+        const unsigned int* pSrcPixels = reinterpret_cast<const unsigned int*>(pSrc + size_t(iSrcRow)*srcStride);
+        unsigned int* pDstPixels = reinterpret_cast<unsigned int*>(pRow + 4*x0);
+        int iSrcColumn = xFirst;
+        long long remainder = xFirstRemainder;
+        for(int x=0; x<scaledWidth; x++) {
+            pDstPixels[x] = pSrcPixels[iSrcColumn];
+            iSrcColumn += xStep;
+            remainder  += xRemainderStep;
+            if(remainder >= xDenominator) {
+                remainder -= xDenominator;
+                iSrcColumn++;
+            }
+        }
+        composeRow(pRow + 4*x0, pRow + 4*x0, scaledWidth, bSwapRB);
+        fillWhite(pRow + 4*(x0+scaledWidth), xRight);
+    }
+}
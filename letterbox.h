@@ -0,0 +1,24 @@
+#ifndef LETTERBOX_H
+#define LETTERBOX_H
+
+// Compose a premultiplied 32 bit image, flipped upside down, centered
+// over a white dstWidth x dstHeight RGBA frame in a single pass.
+// Source pixels are in R,G,B,A byte order or, with bSwapRB, in B,G,R,A
+// (i.e. QImage::Format_ARGB32_Premultiplied on little endian machines).
+// Only the letterbox bars are filled with white.
+void letterboxFlip(const unsigned char* pSrc, int srcWidth, int srcHeight, int srcStride,
+                   bool bSwapRB,
+                   unsigned char* pDst, int dstWidth, int dstHeight, int dstStride);
+
+// The same composition with the image scaled (nearest neighbour) to
+// scaledWidth x scaledHeight on the way: no scaled copy is made.
+// Equal sizes give exactly letterboxFlip().
+void letterboxScaleFlip(const unsigned char* pSrc, int srcWidth, int srcHeight, int srcStride,
+                        bool bSwapRB, int scaledWidth, int scaledHeight,
+                        unsigned char* pDst, int dstWidth, int dstHeight, int dstStride);
+
+// The same composition of a single row of nPixels pixels
+// (pSrc may be pDst: the row is then composed in place)
+void composeRow(const unsigned char* pSrc, unsigned char* pDst, int nPixels, bool bSwapRB);
+
+#endif // LETTERBOX_H
@@ -1,72 +1,257 @@
 #include <QCoreApplication>
 #include <QCommandLineParser>
 #include <QDir>
+#include <QThread>
+#include <QSemaphore>
+#include <QVector>
 #include "slidewindow2.h"
 #include "slidewindow_adaptor.h"
+#include "dispmanxsurface.h"
+#include "headlesssurface.h"
 #include "unistd.h"
 
 int iCurrentSlide;
 
+
+// The command line settings: applied to every output (those of the
+// slide index to the first one: the others share its index)
+struct ShowOptions
+{
+    int  nUploadBands = 0;
+    int  cacheBudget = 0;
+    int  prefetchDepth = 0;
+    int  decodeMemory = 0;
+    float kenBurnsZoom = 0.0f;
+    bool bEtc1 = false;
+    QString sTextureFormat;
+    bool bRecursive = false;
+    QString sIndexDir;
+    QString sDiskCacheDir;
+    int  diskCacheBudget = 0;
+    QString sProgramDir;
+    QString sSlideDir;
+    QString sPlaylist;
+};
+
+
+static void
+applyOptions(SlideWindow* pSlideWindow, const ShowOptions& options) {
+    if(options.nUploadBands > 0)
+        pSlideWindow->setUploadBands(options.nUploadBands);
+    if(options.cacheBudget > 0)
+        pSlideWindow->setCacheBudget(options.cacheBudget);
+    if(options.prefetchDepth > 0)
+        pSlideWindow->setPrefetchDepth(options.prefetchDepth);
+    if(options.decodeMemory > 0)
+        pSlideWindow->setDecodeMemoryLimit(options.decodeMemory);
+    if(options.kenBurnsZoom > 0.0f)
+        pSlideWindow->setKenBurns(options.kenBurnsZoom);
+    if(options.bEtc1)
+        pSlideWindow->setCompressedTextures(true);
+    if(!options.sTextureFormat.isEmpty())
+        pSlideWindow->setTextureFormat(options.sTextureFormat);
+    if(options.diskCacheBudget > 0)
+        pSlideWindow->setDiskCacheBudget(options.diskCacheBudget);
+    if(!options.sDiskCacheDir.isEmpty())
+        pSlideWindow->setDiskCacheDir(options.sDiskCacheDir);
+    if(!options.sProgramDir.isEmpty())
+        pSlideWindow->setProgramCacheDir(options.sProgramDir);
+}
+
+
+// A further output: its own SlideWindow, GL context and render
+// loop in its own thread. The decode pool and the slide index are
+// shared and it follows the commands given to the first output.
+class OutputThread : public QThread
+{
+public:
+    OutputThread(RenderSurface* pRenderSurface, const ShowOptions& showOptions, SlideWindow* pLeaderWindow)
+        : QThread()
+        , pSurface(pRenderSurface)
+        , options(showOptions)
+        , pLeader(pLeaderWindow)
+    {
+    }
+
+    // Until the output follows its leader
+    void waitFollowing() {
+        following.acquire();
+    }
+
+protected:
+    void run() {
+        SlideWindow slideWindow(pSurface);
+        slideWindow.setInputEnabled(false);
+        applyOptions(&slideWindow, options);
+        slideWindow.follow(pLeader);
+        following.release();
+        exec();
+    }
+
+private:
+    RenderSurface* pSurface;
+    ShowOptions options;
+    SlideWindow* pLeader;
+    QSemaphore following;
+};
+
+
 class MyApp: public QCoreApplication
 {
 public:
     MyApp (int argc, char *argv[]);
+    ~MyApp();
     bool autoStart = false;
     int exec();
 
 private:
     SlideWindow *pSlideWindow;
-    QString sSlideDir;
+    QString sTraceFile;
+    ShowOptions options;
+    QVector<RenderSurface*> outputs;
+    QVector<OutputThread*> outputThreads;
 };
 
 
 MyApp::MyApp(int argc, char *argv[])
     : QCoreApplication(argc, argv)
 {
-    pSlideWindow = new SlideWindow();
-    new SlideShowInterfaceAdaptor(pSlideWindow);
-    QDBusConnection connection = QDBusConnection::sessionBus();  // Bus
-    if(!connection.registerObject("/SlideShow", pSlideWindow)) { // Path
-        qCritical() << Q_FUNC_INFO
-                    << "connection.registerObject() Failed !";
-        exit(EXIT_FAILURE);
-    }
-    if(!connection.registerService("org.salvato.gabriele.slideshow")) {// Service name
-        qCritical() << Q_FUNC_INFO
-                    << "connection.registerService() Failed !";
-        exit(EXIT_FAILURE);
-    }
-    sSlideDir = QDir::homePath()+QString("/slides");
+    options.sSlideDir = QDir::homePath()+QString("/slides");
     iCurrentSlide = 0;
     autoStart = false;
+    QStringList sDisplays;
     int c;
-    while ((c = getopt(argc, argv, "d:g")) != -1) {
+    while ((c = getopt(argc, argv, "b:c:d:ef:gi:k:l:m:o:p:q:rs:t:x:z:")) != -1) {
         switch (c)
         {
+            case 'b':// Number of bands for uploading each new slide
+                options.nUploadBands = QString(optarg).toInt();
+                break;
+            case 'c':// Memory budget (MB) of the decoded slides cache
+                options.cacheBudget = QString(optarg).toInt();
+                break;
             case 'd':
-                sSlideDir = QString(optarg);
+                options.sSlideDir = QString(optarg);
+                break;
+            case 'e':// Upload the still slides ETC1 compressed
+                options.bEtc1 = true;
+                break;
+            case 'f':// Slide texture format: rgba, rgb565 or auto (the default)
+                options.sTextureFormat = QString(optarg);
                 break;
             case 'g':
                 autoStart = true;
                 break;
+            case 'i':// Directory of the saved slide indexes
+                options.sIndexDir = QString(optarg);
+                break;
+            case 'k':// Directory of the prescaled slides cache
+                options.sDiskCacheDir = QString(optarg);
+                break;
+            case 'l':// Show the slides of this playlist
+                options.sPlaylist = QString(optarg);
+                break;
+            case 'm':// Memory limit (MB) for preparing each slide
+                options.decodeMemory = QString(optarg).toInt();
+                break;
+            case 'o':// Dispmanx displays to show on (e.g. "0,2")
+                sDisplays = QString(optarg).split(',', QString::SkipEmptyParts);
+                for(int i=0; i<sDisplays.count(); i++)
+                    outputs.append(new DispmanxSurface(sDisplays.at(i).toInt()));
+                break;
+            case 'p':// Number of slides decoded ahead of time
+                options.prefetchDepth = QString(optarg).toInt();
+                break;
+            case 'q':// Disk budget (MB) of the prescaled slides cache
+                options.diskCacheBudget = QString(optarg).toInt();
+                break;
+            case 'r':// Show the slides in the subdirectories too
+                options.bRecursive = true;
+                break;
+            case 's':// Directory of the linked shader programs cache
+                options.sProgramDir = QString(optarg);
+                break;
+            case 't':// Record a trace-event timeline into this file
+                sTraceFile = QString(optarg);
+                break;
+            case 'x':// An off screen output WxH (may be repeated)
+                {
+                    QStringList sSize = QString(optarg).split('x');
+                    if(sSize.count() == 2)
+                        outputs.append(new HeadlessSurface(sSize.at(0).toInt(), sSize.at(1).toInt()));
+                }
+                break;
+            case 'z':// Ken Burns pan and zoom, up to this zoom (e.g. 1.5)
+                options.kenBurnsZoom = QString(optarg).toFloat();
+                break;
             default:
                 break;
         }
     }
+
+    // The first output is controlled through D-Bus and the keyboards
+    pSlideWindow = new SlideWindow(outputs.isEmpty() ? Q_NULLPTR : outputs.first());
+    new SlideShowInterfaceAdaptor(pSlideWindow);
+    QDBusConnection connection = QDBusConnection::sessionBus();  // Bus
+    if(!connection.registerObject("/SlideShow", pSlideWindow)) { // Path
+        qCritical() << Q_FUNC_INFO
+                    << "connection.registerObject() Failed !";
+        exit(EXIT_FAILURE);
+    }
+    if(!connection.registerService("org.salvato.gabriele.slideshow")) {// Service name
+        qCritical() << Q_FUNC_INFO
+                    << "connection.registerService() Failed !";
+        exit(EXIT_FAILURE);
+    }
+    applyOptions(pSlideWindow, options);
+    if(options.bRecursive)
+        pSlideWindow->setRecursiveScan(true);
+    if(!options.sIndexDir.isEmpty())
+        pSlideWindow->setIndexCacheDir(options.sIndexDir);
+    if(!sTraceFile.isEmpty())
+        pSlideWindow->startTrace(sTraceFile);
+    // The others follow it
+    for(int i=1; i<outputs.count(); i++)
+        outputThreads.append(new OutputThread(outputs.at(i), options, pSlideWindow));
+}
+
+
+// Every output thread is done before the statics
+// (e.g. the shared decode pool) are destroyed
+MyApp::~MyApp() {
+    for(int i=0; i<outputThreads.count(); i++) {
+        outputThreads.at(i)->quit();
+        outputThreads.at(i)->wait();
+    }
+    qDeleteAll(outputThreads);
+    delete pSlideWindow;
 }
 
 
 int
 MyApp::exec() {
+    // Following before the first command to forward
+    for(int i=0; i<outputThreads.count(); i++) {
+        outputThreads.at(i)->start();
+        outputThreads.at(i)->waitFollowing();
+    }
+    if(!options.sPlaylist.isEmpty() && !pSlideWindow->loadPlaylist(options.sPlaylist)) {
+        qCritical() << "Unable to load the playlist" << options.sPlaylist << "...Exiting...";
+        return EXIT_FAILURE;
+    }
     if(!autoStart)
         return QCoreApplication::exec();
-    if(QDir(sSlideDir).exists()) {
-        pSlideWindow->setSlideDir(sSlideDir);
+    if(!options.sPlaylist.isEmpty()) {
+        pSlideWindow->startSlideShow();
+        return QCoreApplication::exec();
+    }
+    if(QDir(options.sSlideDir).exists()) {
+        pSlideWindow->setSlideDir(options.sSlideDir);
         pSlideWindow->startSlideShow();
         return QCoreApplication::exec();
     }
     else {
-        qCritical() << "Unexisting Slide Directory" << sSlideDir << "...Exiting...";
+        qCritical() << "Unexisting Slide Directory" << options.sSlideDir << "...Exiting...";
         return EXIT_FAILURE;
     }
 }
@@ -0,0 +1,219 @@
+#include "playlist.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+
+
+#define ENTRY_ABSOLUTE_PATH   0x01
+#define MAX_PLAYLIST_SIZE     0x7fffffffu // The arena is a QByteArray
+#define MAX_PATH_LENGTH       0xffff      // Bytes, as PlaylistEntry keeps them
+#define MAX_TRANSITION_LENGTH 0xff
+
+
+Playlist::Playlist() {
+}
+
+
+Playlist::~Playlist() {
+    close();
+}
+
+
+void
+Playlist::close() {
+    arena.clear();
+    entries.clear();
+    sPlaylistFile.clear();
+    sBaseDir.clear();
+}
+
+
+// A loaded playlist has at least one slide
+bool
+Playlist::isLoaded() {
+    return !entries.isEmpty();
+}
+
+
+QString
+Playlist::fileName() {
+    return sPlaylistFile;
+}
+
+
+QString
+Playlist::errorString() {
+    return sError;
+}
+
+
+// "5", "2.5" or ".75" seconds in ms; an empty field is 0 (the default)
+int
+Playlist::parseTime(const char* pField, int fieldLength, bool* pOk) {
+    qint64 ms = 0;
+    int scale = 1000;
+    bool bFraction = false;
+    *pOk = true;
+    for(int i=0; i<fieldLength; i++) {
+        char c = pField[i];
+        if((c == '.') && !bFraction) {
+            bFraction = true;
+        }
+        else if((c >= '0') && (c <= '9')) {
+            if(!bFraction)
+                ms = 10*ms + 1000*(c-'0');
+            else if(scale > 1)
+                ms += (c-'0') * (scale /= 10);
+            if(ms > 24*3600*1000)
+                *pOk = false;
+        }
+        else if((c != ' ') && (c != '\r')) {
+            *pOk = false;
+        }
+    }
+    return *pOk ? int(ms) : 0;
+}
+
+
+// Replaces the current playlist only if sFile is valid
+bool
+Playlist::load(QString sFile) {
+    sError.clear();
+    int fd = open(QFile::encodeName(sFile).constData(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1) {
+        sError = QString("Unable to open %1").arg(sFile);
+        return false;
+    }
+    struct stat fileStat;
+    if((fstat(fd, &fileStat) == -1) ||
+       (fileStat.st_size == 0) ||
+       (quint64(fileStat.st_size) > MAX_PLAYLIST_SIZE))
+    {
+        ::close(fd);
+        sError = QString("Invalid playlist size: %1").arg(sFile);
+        return false;
+    }
+    size_t newLength = size_t(fileStat.st_size);
+    void* pMapped = mmap(Q_NULLPTR, newLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(pMapped == MAP_FAILED) {
+        sError = QString("Unable to map %1").arg(sFile);
+        return false;
+    }
+    madvise(pMapped, newLength, MADV_SEQUENTIAL);
+
+    // One pass: the paths and the transition names are copied,
+    // the mapping is gone once the file has been parsed
+    const char* pText = static_cast<const char*>(pMapped);
+    const char* pEnd  = pText + newLength;
+    QVector<PlaylistEntry> newEntries;
+    QByteArray newArena;
+    int iLine = 0;
+    for(const char* pLine=pText; pLine<pEnd; ) {
+        iLine++;
+        const char* pEol = static_cast<const char*>(memchr(pLine, '\n', size_t(pEnd-pLine)));
+        if(!pEol)
+            pEol = pEnd;
+        const char* pNext = pEol + 1;
+        if((pEol > pLine) && (pEol[-1] == '\r'))
+            pEol--;
+        if((pEol == pLine) || (*pLine == '#')) {
+            pLine = pNext;
+            continue;
+        }
+        const char* pFields[4] = { pEol, pEol, pEol, pEol };
+        int fieldLengths[4] = { 0, 0, 0, 0 };
+        const char* pField = pLine;
+        for(int f=0; (f<4) && (pField<=pEol); f++) {
+            const char* pTab = static_cast<const char*>(memchr(pField, '\t', size_t(pEol-pField)));
+            if(!pTab)
+                pTab = pEol;
+            pFields[f] = pField;
+            fieldLengths[f] = int(pTab-pField);
+            pField = pTab + 1;
+        }
+        if((fieldLengths[0] > MAX_PATH_LENGTH) || (fieldLengths[2] > MAX_TRANSITION_LENGTH)) {
+            munmap(pMapped, newLength);
+            sError = QString("%1:%2: %3 too long").arg(sFile).arg(iLine)
+                     .arg((fieldLengths[0] > MAX_PATH_LENGTH) ? "path" : "transition name");
+            return false;
+        }
+        bool bDurationOk, bTransitionOk;
+        PlaylistEntry entry;
+        entry.pathOffset       = quint32(newArena.size());
+        entry.pathLength       = quint16(fieldLengths[0]);
+        entry.transitionOffset = quint32(newArena.size() + fieldLengths[0]);
+        entry.transitionLength = quint8(fieldLengths[2]);
+        entry.flags            = (*pFields[0] == '/') ? ENTRY_ABSOLUTE_PATH : 0;
+        entry.duration         = quint32(parseTime(pFields[1], fieldLengths[1], &bDurationOk));
+        entry.transitionTime   = quint32(parseTime(pFields[3], fieldLengths[3], &bTransitionOk));
+        if((entry.pathLength == 0) || !bDurationOk || !bTransitionOk) {
+            munmap(pMapped, newLength);
+            sError = QString("%1:%2: invalid entry").arg(sFile).arg(iLine);
+            return false;
+        }
+        newArena.append(pFields[0], fieldLengths[0]);
+        newArena.append(pFields[2], fieldLengths[2]);
+        newEntries.append(entry);
+        pLine = pNext;
+    }
+    munmap(pMapped, newLength);
+    if(newEntries.isEmpty()) {
+        sError = QString("%1: no slides").arg(sFile);
+        return false;
+    }
+
+    close();
+    newArena.squeeze();
+    arena   = newArena;
+    entries = newEntries;
+    sPlaylistFile = QFileInfo(sFile).absoluteFilePath();
+    sBaseDir      = QFileInfo(sFile).absolutePath();
+    return true;
+}
+
+
+int
+Playlist::count() {
+    return entries.count();
+}
+
+
+QString
+Playlist::filePath(int i) {
+    const PlaylistEntry& entry = entries.at(i);
+    QString sPath = QFile::decodeName(QByteArray::fromRawData(arena.constData() + entry.pathOffset,
+                                                              entry.pathLength));
+    if(entry.flags & ENTRY_ABSOLUTE_PATH)
+        return sPath;
+    return sBaseDir + QString("/") + sPath;
+}
+
+
+// Display time (ms) of the slide; 0 for the default
+int
+Playlist::duration(int i) {
+    return int(entries.at(i).duration);
+}
+
+
+// The transition to the slide; empty for a random one
+QString
+Playlist::transitionName(int i) {
+    const PlaylistEntry& entry = entries.at(i);
+    return QString::fromUtf8(arena.constData() + entry.transitionOffset, entry.transitionLength).trimmed();
+}
+
+
+// Duration (ms) of the transition to the slide; 0 for the default
+int
+Playlist::transitionTime(int i) {
+    return int(entries.at(i).transitionTime);
+}
@@ -0,0 +1,59 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+
+// A slide show script: one line per slide with up to four
+// fields separated by tabs (empty or missing fields take the
+// slide show defaults):
+//
+//   file <TAB> duration <TAB> transition <TAB> transition duration
+//
+// Durations are in seconds (decimals allowed), the transition is
+// given by its name ("Fade", "Zoom in", ...) and relative file
+// paths start from the playlist directory. Lines starting with
+// '#' are comments. Paths are at most 65535 bytes long and
+// transition names 255.
+// The file is parsed memory mapped, in a single pass: only the
+// paths and the transition names are kept, packed in one buffer.
+// The playlist file may then be rewritten while it is being shown.
+class Playlist
+{
+public:
+    Playlist();
+    ~Playlist();
+    bool load(QString sFile);
+    void close();
+    bool isLoaded();
+    QString fileName();
+    QString errorString();
+    int  count();
+    QString filePath(int i);
+    int  duration(int i);
+    QString transitionName(int i);
+    int  transitionTime(int i);
+
+private:
+    static int parseTime(const char* pField, int length, bool* pOk);
+
+private:
+    struct PlaylistEntry {
+        quint32 pathOffset;// In the arena
+        quint32 transitionOffset;
+        quint16 pathLength;
+        quint8  transitionLength;
+        quint8  flags;
+        quint32 duration;// ms, 0 for the default
+        quint32 transitionTime;// ms, 0 for the default
+    };
+    QString sPlaylistFile;
+    QString sBaseDir;
+    QString sError;
+    QByteArray arena;// The paths and transition names
+    QVector<PlaylistEntry> entries;
+};
+
+#endif // PLAYLIST_H
@@ -0,0 +1,180 @@
+#include "programcache.h"
+
+#include <string.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+#include "EGL/egl.h"
+
+
+#define PROGRAM_FILE_MAGIC   "SLDPROGB"
+#define PROGRAM_FILE_VERSION 1
+
+
+ProgramCache::ProgramCache() {
+    pGetProgramBinary = Q_NULLPTR;
+    pProgramBinary    = Q_NULLPTR;
+    bSupported = false;
+    nHits      = 0;
+    nMisses    = 0;
+}
+
+
+// An empty directory disables the cache
+void
+ProgramCache::setDirectory(QString sDir) {
+    sCacheDir = sDir;
+    if(!sCacheDir.isEmpty() && !QDir().mkpath(sCacheDir)) {
+        qDebug() << "Unable to create the program cache directory" << sCacheDir;
+        sCacheDir.clear();
+    }
+}
+
+
+QString
+ProgramCache::directory() {
+    return sCacheDir;
+}
+
+
+// Must be called with the GL context current
+bool
+ProgramCache::init() {
+    bSupported = false;
+    if(sCacheDir.isEmpty())
+        return false;
+    const char* sExtensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if(!sExtensions || !strstr(sExtensions, "GL_OES_get_program_binary"))
+        return false;
+    GLint nFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &nFormats);
+    if(nFormats < 1)
+        return false;
+    pGetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYOESPROC>(eglGetProcAddress("glGetProgramBinaryOES"));
+    pProgramBinary    = reinterpret_cast<PFNGLPROGRAMBINARYOESPROC>(eglGetProcAddress("glProgramBinaryOES"));
+    if(!pGetProgramBinary || !pProgramBinary)
+        return false;
+    driverId.clear();
+    driverId.append(reinterpret_cast<const char*>(glGetString(GL_VENDOR))).append('\n');
+    driverId.append(reinterpret_cast<const char*>(glGetString(GL_RENDERER))).append('\n');
+    driverId.append(reinterpret_cast<const char*>(glGetString(GL_VERSION))).append('\n');
+    bSupported = true;
+    return true;
+}
+
+
+bool
+ProgramCache::isSupported() {
+    return bSupported;
+}
+
+
+QString
+ProgramCache::entryName(const QByteArray& vertexSource, const QByteArray& fragmentSource) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(driverId);
+    hash.addData(vertexSource);
+    hash.addData("\n", 1);
+    hash.addData(fragmentSource);
+    return QString("%1/%2.program")
+            .arg(sCacheDir)
+            .arg(QString::fromLatin1(hash.result().toHex()));
+}
+
+
+// Returns the program built from the cached binary or 0 when
+// there is no usable entry (the caller has to compile and link)
+GLuint
+ProgramCache::load(const QByteArray& vertexSource, const QByteArray& fragmentSource) {
+    if(!bSupported)
+        return 0;
+    QString sEntry = entryName(vertexSource, fragmentSource);
+    QFile file(sEntry);
+    if(!file.open(QIODevice::ReadOnly)) {
+        nMisses++;
+        return 0;
+    }
+    QByteArray content = file.readAll();
+    file.close();
+    const ProgramFileHeader* pHeader = reinterpret_cast<const ProgramFileHeader*>(content.constData());
+    if((content.size() < int(sizeof(ProgramFileHeader))) ||
+       (memcmp(pHeader->magic, PROGRAM_FILE_MAGIC, sizeof(pHeader->magic)) != 0) ||
+       (pHeader->version != PROGRAM_FILE_VERSION) ||
+       (content.size() != int(sizeof(ProgramFileHeader) + pHeader->length)))
+    {
+        QFile::remove(sEntry);
+        nMisses++;
+        return 0;
+    }
+    GLuint program = glCreateProgram();
+    if(program == 0)
+        return 0;
+    pProgramBinary(program,
+                   GLenum(pHeader->binaryFormat),
+                   content.constData() + sizeof(ProgramFileHeader),
+                   GLint(pHeader->length));
+    // The driver may still refuse a binary it produced itself
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if(!linked) {
+        glDeleteProgram(program);
+        QFile::remove(sEntry);
+        nMisses++;
+        return 0;
+    }
+    nHits++;
+    return program;
+}
+
+
+bool
+ProgramCache::store(GLuint program, const QByteArray& vertexSource, const QByteArray& fragmentSource) {
+    if(!bSupported)
+        return false;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if(length < 1)
+        return false;
+    QByteArray content(int(sizeof(ProgramFileHeader)) + length, '\0');
+    ProgramFileHeader* pHeader = reinterpret_cast<ProgramFileHeader*>(content.data());
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    pGetProgramBinary(program, length, &written, &binaryFormat,
+                      content.data() + sizeof(ProgramFileHeader));
+    if(written < 1)
+        return false;
+    memcpy(pHeader->magic, PROGRAM_FILE_MAGIC, sizeof(pHeader->magic));
+    pHeader->version      = PROGRAM_FILE_VERSION;
+    pHeader->binaryFormat = quint32(binaryFormat);
+    pHeader->length       = quint32(written);
+    content.resize(int(sizeof(ProgramFileHeader)) + written);
+
+    QString sEntry = entryName(vertexSource, fragmentSource);
+    QSaveFile file(sEntry);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Unable to write" << sEntry;
+        return false;
+    }
+    if(file.write(content) != content.size()) {
+        qDebug() << "Error writing" << sEntry;
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+
+int
+ProgramCache::hits() {
+    return nHits;
+}
+
+
+int
+ProgramCache::misses() {
+    return nMisses;
+}
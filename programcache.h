@@ -0,0 +1,48 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <QString>
+#include <QByteArray>
+
+#include "GLES2/gl2.h"
+#include "GLES2/gl2ext.h"
+
+
+// On disk cache of the linked shader programs, through the
+// GL_OES_get_program_binary extension (when the driver has it).
+// Entries are keyed by the driver vendor, renderer and version
+// and by the shader sources: a driver update or a shader change
+// just produces a different key.
+class ProgramCache
+{
+public:
+    ProgramCache();
+    void setDirectory(QString sDir);
+    QString directory();
+    bool init();
+    bool isSupported();
+    GLuint load(const QByteArray& vertexSource, const QByteArray& fragmentSource);
+    bool store(GLuint program, const QByteArray& vertexSource, const QByteArray& fragmentSource);
+    int  hits();
+    int  misses();
+
+private:
+    QString entryName(const QByteArray& vertexSource, const QByteArray& fragmentSource);
+
+private:
+    struct ProgramFileHeader {
+        char    magic[8];
+        quint32 version;
+        quint32 binaryFormat;
+        quint32 length;
+    };
+    QString sCacheDir;
+    QByteArray driverId;
+    PFNGLGETPROGRAMBINARYOESPROC pGetProgramBinary;
+    PFNGLPROGRAMBINARYOESPROC pProgramBinary;
+    bool bSupported;
+    int nHits;
+    int nMisses;
+};
+
+#endif // PROGRAMCACHE_H
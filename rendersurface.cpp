@@ -0,0 +1,196 @@
+#include "rendersurface.h"
+
+#include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+
+
+// eglTerminate() is not reference counted: the
+// last surface using a display has to call it
+static QMutex displayMutex;
+static QHash<EGLDisplay, int> displayUsers;
+
+
+RenderSurface::RenderSurface() {
+    display = EGL_NO_DISPLAY;
+    surface = EGL_NO_SURFACE;
+    context = EGL_NO_CONTEXT;
+    surfaceWidth  = 0;
+    surfaceHeight = 0;
+    bOpen = false;
+    bDisplayInitialized = false;
+}
+
+
+RenderSurface::~RenderSurface() {
+}
+
+
+bool
+RenderSurface::fail(QString sError) {
+    sLastError = sError;
+    qDebug() << sError;
+    close();
+    return false;
+}
+
+
+QString
+RenderSurface::errorString() {
+    return sLastError;
+}
+
+
+// Bytes of memory reserved to the GPU (-1: unknown)
+qint64
+RenderSurface::gpuMemory() {
+    return -1;
+}
+
+
+EGLDisplay
+RenderSurface::getDisplay() {
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+
+// eglSwapBuffers() will wait for the vertical sync:
+// this is what paces the transitions rendering
+EGLint
+RenderSurface::swapInterval() {
+    return 1;
+}
+
+
+bool
+RenderSurface::open() {
+    // No need to reinitialize...
+    if(bOpen)
+        return true;
+    sLastError.clear();
+    if(!openNative())
+        return fail(sLastError.isEmpty() ? QString("Unable to open the native display") : sLastError);
+
+    // get an EGL display connection
+    display = getDisplay();
+    if(display == EGL_NO_DISPLAY)
+        return fail("Error in eglGetDisplay()");
+
+    // initialize the EGL display connection
+    EGLint major, minor;
+    EGLBoolean result;
+    {
+        QMutexLocker locker(&displayMutex);
+        result = eglInitialize(display, &major, &minor);
+        if(EGL_TRUE == result) {
+            displayUsers[display]++;
+            bDisplayInitialized = true;
+        }
+    }
+    if(EGL_FALSE == result)
+        return fail("Error in eglInitialize()");
+
+    // get an appropriate EGL frame buffer configuration
+    QVector<EGLint> attribute_list;
+    attribute_list << EGL_RED_SIZE        << 8;
+    attribute_list << EGL_GREEN_SIZE      << 8;
+    attribute_list << EGL_BLUE_SIZE       << 8;
+    attribute_list << EGL_ALPHA_SIZE      << 8;
+    attribute_list << EGL_LUMINANCE_SIZE  << EGL_DONT_CARE;
+    attribute_list << EGL_SURFACE_TYPE    << surfaceType();
+    attribute_list << EGL_RENDERABLE_TYPE << EGL_OPENGL_ES2_BIT;
+    attribute_list << EGL_SAMPLES         << 1;
+    attribute_list << EGL_DEPTH_SIZE      << 24;
+    attribute_list << EGL_NONE;
+    EGLConfig config;
+    EGLint num_config = 0;
+    result = eglChooseConfig(display,
+                             attribute_list.constData(),
+                             &config,
+                             1,
+                             &num_config);
+    if((result == EGL_FALSE) || (num_config < 1))
+        return fail("Error in eglChooseConfig()");
+
+    // bind the OpenGL API to the EGL
+    result = eglBindAPI(EGL_OPENGL_ES_API);
+    if(result == EGL_FALSE)
+        return fail("Error binding API");
+
+    // create an EGL rendering context
+    //This seems important for using ES2
+    static const EGLint context_attributes[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+    context = eglCreateContext(display,
+                               config,
+                               EGL_NO_CONTEXT,
+                               context_attributes);
+    if(context == EGL_NO_CONTEXT)
+        return fail("Error in eglCreateContext()");
+
+    surface = createSurface(config);
+    if(surface == EGL_NO_SURFACE)
+        return fail("Error creating the EGL surface");
+
+    // connect the context to the surface
+    result = eglMakeCurrent(display, surface, surface, context);
+    if(EGL_FALSE == result)
+        return fail("Error in eglMakeCurrent()");
+    eglSwapInterval(display, swapInterval());
+    bOpen = true;
+    return true;
+}
+
+
+// Also releases whatever a failed open() left behind
+void
+RenderSurface::close() {
+    if(display != EGL_NO_DISPLAY) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if(surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        if(context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        if(bDisplayInitialized) {
+            QMutexLocker locker(&displayMutex);
+            if(--displayUsers[display] == 0) {
+                displayUsers.remove(display);
+                eglTerminate(display);
+            }
+        }
+    }
+    bDisplayInitialized = false;
+    display = EGL_NO_DISPLAY;
+    surface = EGL_NO_SURFACE;
+    context = EGL_NO_CONTEXT;
+    closeNative();
+    bOpen = false;
+}
+
+
+bool
+RenderSurface::swapBuffers() {
+    return eglSwapBuffers(display, surface) == EGL_TRUE;
+}
+
+
+bool
+RenderSurface::isOpen() {
+    return bOpen;
+}
+
+
+int
+RenderSurface::width() {
+    return surfaceWidth;
+}
+
+
+int
+RenderSurface::height() {
+    return surfaceHeight;
+}
@@ -0,0 +1,52 @@
+#ifndef RENDERSURFACE_H
+#define RENDERSURFACE_H
+
+#include <QString>
+#include <QVector>
+
+#include "EGL/egl.h"
+#include "EGL/eglext.h"
+
+
+// An OpenGL ES 2 context with the surface it renders to. The EGL
+// setup is common: subclasses only provide the native display and
+// the surface (a dispmanx window on the Raspberry Pi, a pbuffer
+// when running headless). Several surfaces, each rendered by its own
+// thread, may share the same EGL display.
+class RenderSurface
+{
+public:
+    RenderSurface();
+    virtual ~RenderSurface();
+    bool open();
+    void close();
+    virtual bool swapBuffers();
+    virtual qint64 gpuMemory();
+    bool isOpen();
+    int  width();
+    int  height();
+    QString errorString();
+
+protected:
+    virtual bool openNative() = 0;
+    virtual void closeNative() = 0;
+    virtual EGLDisplay getDisplay();
+    virtual EGLint surfaceType() = 0;
+    virtual EGLSurface createSurface(EGLConfig config) = 0;
+    virtual EGLint swapInterval();
+    bool fail(QString sError);
+
+protected:
+    EGLDisplay display;
+    EGLSurface surface;
+    EGLContext context;
+    int surfaceWidth;
+    int surfaceHeight;
+
+private:
+    bool bOpen;
+    bool bDisplayInitialized;
+    QString sLastError;
+};
+
+#endif // RENDERSURFACE_H
@@ -0,0 +1,135 @@
+#include "rgb565.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+// The 4x4 Bayer matrix (0..15). Added to a channel before dropping
+// its low bits: halved for the 5 bit channels (step 8) and quartered
+// for the 6 bit green (step 4), so that every level is reached in
+// proportion to the dropped fraction. The channels are first scaled
+// by 31/32 (63/64 for green): the GPU expands 31 (63) back to 255.
+static const unsigned char bayer[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+
+static inline unsigned int
+addSaturated(unsigned int value, unsigned int offset) {
+    value += offset;
+    return (value > 255) ? 255 : value;
+}
+
+
+static inline unsigned short
+ditherPixel(const unsigned char* pSrc, int x, int y) {
+    unsigned int d = bayer[y & 3][x & 3];
+    unsigned int r = addSaturated(pSrc[0] - (pSrc[0] >> 5), d >> 1);
+    unsigned int g = addSaturated(pSrc[1] - (pSrc[1] >> 6), d >> 2);
+    unsigned int b = addSaturated(pSrc[2] - (pSrc[2] >> 5), d >> 1);
+    return (unsigned short)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+
+#if defined(__SSE2__)
+
+// Four pixels at a time: the dither offsets of a row repeat every
+// four pixels, that is exactly one register
+static int
+rgb565RowSimd(const unsigned char* pSrc, unsigned short* pDst, int nPixels, int y) {
+    const unsigned char* pBayer = bayer[y & 3];
+    const __m128i dither = _mm_setr_epi8(
+        char(pBayer[0] >> 1), char(pBayer[0] >> 2), char(pBayer[0] >> 1), 0,
+        char(pBayer[1] >> 1), char(pBayer[1] >> 2), char(pBayer[1] >> 1), 0,
+        char(pBayer[2] >> 1), char(pBayer[2] >> 2), char(pBayer[2] >> 1), 0,
+        char(pBayer[3] >> 1), char(pBayer[3] >> 2), char(pBayer[3] >> 1), 0);
+    const __m128i scale5    = _mm_set1_epi32(0x00070007);// The bits left of >> 5 in R and B
+    const __m128i scale6    = _mm_set1_epi32(0x00000300);// and of >> 6 in G
+    const __m128i redMask   = _mm_set1_epi32(0x000000f8);
+    const __m128i greenMask = _mm_set1_epi32(0x0000fc00);
+    const __m128i blueMask  = _mm_set1_epi32(0x00f80000);
+    __m128i packed[2];
+    int i = 0;
+    for(; i+8<=nPixels; i+=8) {
+        for(int j=0; j<2; j++) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 4*(i+4*j)));
+            __m128i scale = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(pixels, 5), scale5),
+                                         _mm_and_si128(_mm_srli_epi16(pixels, 6), scale6));
+            pixels = _mm_adds_epu8(_mm_sub_epi8(pixels, scale), dither);
+            __m128i r = _mm_slli_epi32(_mm_and_si128(pixels, redMask), 8);
+            __m128i g = _mm_srli_epi32(_mm_and_si128(pixels, greenMask), 5);
+            __m128i b = _mm_srli_epi32(_mm_and_si128(pixels, blueMask), 19);
+            // Sign extended, so that the saturating pack keeps all the 16 bits
+            __m128i rgb = _mm_or_si128(r, _mm_or_si128(g, b));
+            packed[j] = _mm_srai_epi32(_mm_slli_epi32(rgb, 16), 16);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_packs_epi32(packed[0], packed[1]));
+    }
+    return i;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static inline uint16x8_t
+packRgb565(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+    uint16x8_t rgb = vshll_n_u8(r, 8);
+    rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+    return vsriq_n_u16(rgb, vshll_n_u8(b, 8), 11);
+}
+
+
+static int
+rgb565RowSimd(const unsigned char* pSrc, unsigned short* pDst, int nPixels, int y) {
+    unsigned char rbOffsets[16];
+    unsigned char gOffsets[16];
+    for(int x=0; x<16; x++) {
+        rbOffsets[x] = bayer[y & 3][x & 3] >> 1;
+        gOffsets[x]  = bayer[y & 3][x & 3] >> 2;
+    }
+    const uint8x16_t rbDither = vld1q_u8(rbOffsets);
+    const uint8x16_t gDither  = vld1q_u8(gOffsets);
+    int i = 0;
+    for(; i+16<=nPixels; i+=16) {
+        uint8x16x4_t pixels = vld4q_u8(pSrc + 4*i);
+        uint8x16_t r = vqaddq_u8(vsubq_u8(pixels.val[0], vshrq_n_u8(pixels.val[0], 5)), rbDither);
+        uint8x16_t g = vqaddq_u8(vsubq_u8(pixels.val[1], vshrq_n_u8(pixels.val[1], 6)), gDither);
+        uint8x16_t b = vqaddq_u8(vsubq_u8(pixels.val[2], vshrq_n_u8(pixels.val[2], 5)), rbDither);
+        vst1q_u16(pDst + i,     packRgb565(vget_low_u8(r),  vget_low_u8(g),  vget_low_u8(b)));
+        vst1q_u16(pDst + i + 8, packRgb565(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+    }
+    return i;
+}
+
+#else
+
+static int
+rgb565RowSimd(const unsigned char* pSrc, unsigned short* pDst, int nPixels, int y) {
+    (void)pSrc;
+    (void)pDst;
+    (void)nPixels;
+    (void)y;
+    return 0;
+}
+
+#endif
+
+
+void
+rgb565Row(const unsigned char* pSrc, unsigned short* pDst, int nPixels, int y) {
+    int i = rgb565RowSimd(pSrc, pDst, nPixels, y);
+    for(; i<nPixels; i++)
+        pDst[i] = ditherPixel(pSrc + 4*i, i, y);
+}
+
+
+void
+rgb565RowScalar(const unsigned char* pSrc, unsigned short* pDst, int nPixels, int y) {
+    for(int i=0; i<nPixels; i++)
+        pDst[i] = ditherPixel(pSrc + 4*i, i, y);
+}
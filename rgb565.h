@@ -0,0 +1,16 @@
+#ifndef RGB565_H
+#define RGB565_H
+
+// Convert a row of nPixels pixels in R,G,B,X byte order (the fourth
+// byte is ignored) to 16 bit 5-6-5 pixels, as uploaded with
+// GL_RGB / GL_UNSIGNED_SHORT_5_6_5. A 4x4 ordered (Bayer) dither,
+// chosen by the row y and the pixel column, keeps the average color
+// of smooth gradients: no visible banding. The same row always gives
+// the same result, so a frame may be converted band by band.
+void rgb565Row(const unsigned char* pSrc, unsigned short* pDst, int nPixels, int y);
+
+// The same, one pixel at a time (no SSE2 or NEON): the
+// result rgb565Row() must match exactly
+void rgb565RowScalar(const unsigned char* pSrc, unsigned short* pDst, int nPixels, int y);
+
+#endif // RGB565_H
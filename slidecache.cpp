@@ -0,0 +1,155 @@
+#include "slidecache.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+
+
+#define DEFAULT_CACHE_BUDGET (64*1024*1024) // Bytes of decoded slides kept
+
+
+SlideCache::SlideCache() {
+    useCounter = 0;
+    maxBytes   = DEFAULT_CACHE_BUDGET;
+    usedBytes  = 0;
+    nHits      = 0;
+    nMisses    = 0;
+    nEvictions = 0;
+}
+
+
+qint64
+SlideCache::frameSize(const QImage& frame) {
+    return qint64(frame.bytesPerLine()) * frame.height();
+}
+
+
+// A changed file (or a different screen) gives a different key
+QString
+SlideCache::key(QString sFile, int width, int height) {
+    return stampedKey(fileStamp(sFile), width, height);
+}
+
+
+// The path, modification time and size of sFile: stat() it
+// once for the keys of all the screen sizes of a slide
+QString
+SlideCache::fileStamp(QString sFile) {
+    QFileInfo fileInfo(sFile);
+    return QString("%1|%2|%3")
+            .arg(fileInfo.absoluteFilePath())
+            .arg(fileInfo.lastModified().toMSecsSinceEpoch())
+            .arg(fileInfo.size());
+}
+
+
+QString
+SlideCache::stampedKey(QString sStamp, int width, int height) {
+    return QString("%1|%2x%3").arg(sStamp).arg(width).arg(height);
+}
+
+
+void
+SlideCache::setBudget(qint64 newBudget) {
+    QMutexLocker locker(&mutex);
+    maxBytes = qMax(qint64(0), newBudget);
+    evict(maxBytes);
+}
+
+
+qint64
+SlideCache::budget() {
+    QMutexLocker locker(&mutex);
+    return maxBytes;
+}
+
+
+// Without bCountMiss a miss is not counted: the caller
+// will look again (e.g. a decoder worker) and count it
+bool
+SlideCache::find(QString sKey, QImage* pFrame, bool bCountMiss) {
+    QMutexLocker locker(&mutex);
+    QHash<QString, CacheEntry>::iterator it = entries.find(sKey);
+    if(it == entries.end()) {
+        if(bCountMiss)
+            nMisses++;
+        return false;
+    }
+    nHits++;
+    it->lastUse = ++useCounter;
+    *pFrame = it->frame;
+    return true;
+}
+
+
+void
+SlideCache::insert(QString sKey, QImage frame) {
+    QMutexLocker locker(&mutex);
+    qint64 frameBytes = frameSize(frame);
+    if(frame.isNull() || (frameBytes > maxBytes))
+        return;
+    QHash<QString, CacheEntry>::iterator it = entries.find(sKey);
+    if(it != entries.end()) {
+        usedBytes -= frameSize(it->frame);
+        entries.erase(it);
+    }
+    evict(maxBytes - frameBytes);
+    CacheEntry entry;
+    entry.frame   = frame;
+    entry.lastUse = ++useCounter;
+    entries.insert(sKey, entry);
+    usedBytes += frameBytes;
+}
+
+
+// Drop the least recently used frames until no more than
+// maxUsed bytes are in use. Must be called with the mutex locked.
+void
+SlideCache::evict(qint64 maxUsed) {
+    while((usedBytes > maxUsed) && !entries.isEmpty()) {
+        QHash<QString, CacheEntry>::iterator oldest = entries.begin();
+        for(QHash<QString, CacheEntry>::iterator it=entries.begin(); it!=entries.end(); ++it) {
+            if(it->lastUse < oldest->lastUse)
+                oldest = it;
+        }
+        usedBytes -= frameSize(oldest->frame);
+        entries.erase(oldest);
+        nEvictions++;
+    }
+}
+
+
+void
+SlideCache::clear() {
+    QMutexLocker locker(&mutex);
+    entries.clear();
+    usedBytes = 0;
+}
+
+
+qint64
+SlideCache::bytes() {
+    QMutexLocker locker(&mutex);
+    return usedBytes;
+}
+
+
+int
+SlideCache::hits() {
+    QMutexLocker locker(&mutex);
+    return nHits;
+}
+
+
+int
+SlideCache::misses() {
+    QMutexLocker locker(&mutex);
+    return nMisses;
+}
+
+
+int
+SlideCache::evictions() {
+    QMutexLocker locker(&mutex);
+    return nEvictions;
+}
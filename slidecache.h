@@ -0,0 +1,46 @@
+#ifndef SLIDECACHE_H
+#define SLIDECACHE_H
+
+#include <QString>
+#include <QImage>
+#include <QHash>
+#include <QMutex>
+
+
+class SlideCache
+{
+public:
+    SlideCache();
+    static QString key(QString sFile, int width, int height);
+    static QString fileStamp(QString sFile);
+    static QString stampedKey(QString sStamp, int width, int height);
+    static qint64 frameSize(const QImage& frame);
+    void setBudget(qint64 newBudget);
+    qint64 budget();
+    bool find(QString sKey, QImage* pFrame, bool bCountMiss = true);
+    void insert(QString sKey, QImage frame);
+    void clear();
+    qint64 bytes();
+    int hits();
+    int misses();
+    int evictions();
+
+private:
+    void evict(qint64 maxBytes);
+
+private:
+    struct CacheEntry {
+        QImage  frame;
+        quint64 lastUse;
+    };
+    QMutex mutex;
+    QHash<QString, CacheEntry> entries;
+    quint64 useCounter;
+    qint64 maxBytes;
+    qint64 usedBytes;
+    int nHits;
+    int nMisses;
+    int nEvictions;
+};
+
+#endif // SLIDECACHE_H
@@ -0,0 +1,495 @@
+#include "slidediskcache.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QMutexLocker>
+#include <QCryptographicHash>
+
+
+#define SLIDE_FILE_MAGIC   "SLDCACHE"
+#define SLIDE_FILE_VERSION 2
+#define SLIDE_HEADER_SIZE  4096 // Keeps the pixel rows page aligned
+#define SLIDE_FORMAT_ETC1  0x45544331 // "ETC1" in the format field
+#define SLIDE_CACHE_BUDGET (qint64(2048)*1024*1024) // About 250 1080p frames
+
+
+struct MappedSlide {
+    void*  pBase;
+    size_t length;
+};
+
+
+static void
+unmapSlide(void* pInfo) {
+    MappedSlide* pMapped = reinterpret_cast<MappedSlide*>(pInfo);
+    munmap(pMapped->pBase, pMapped->length);
+    delete pMapped;
+}
+
+
+SlideDiskCache::SlideDiskCache() {
+    nHits   = 0;
+    nMisses = 0;
+    nStale  = 0;
+    nCompressedHits   = 0;
+    nCompressedMisses = 0;
+    nCompressedStale  = 0;
+    maxBytes   = SLIDE_CACHE_BUDGET;
+    usedBytes  = 0;
+    lastStamp  = 0;
+    nEvictions = 0;
+}
+
+
+// An empty directory disables the cache. The entries already
+// there count against the budget (the oldest go first if over it).
+void
+SlideDiskCache::setDirectory(QString sDir) {
+    QMutexLocker locker(&mutex);
+    sCacheDir = sDir.isEmpty() ? sDir : QDir::cleanPath(sDir);
+    if(!sCacheDir.isEmpty() && !QDir().mkpath(sCacheDir)) {
+        qDebug() << "Unable to create the slide cache directory" << sCacheDir;
+        sCacheDir.clear();
+    }
+    scanEntries();
+    evict(maxBytes);
+}
+
+
+// Bytes of entries kept on disk: the least recently
+// written or found entries are removed to stay within it
+void
+SlideDiskCache::setBudget(qint64 newBudget) {
+    QMutexLocker locker(&mutex);
+    maxBytes = qMax(qint64(0), newBudget);
+    evict(maxBytes);
+}
+
+
+qint64
+SlideDiskCache::budget() {
+    QMutexLocker locker(&mutex);
+    return maxBytes;
+}
+
+
+qint64
+SlideDiskCache::bytesUsed() {
+    QMutexLocker locker(&mutex);
+    return usedBytes;
+}
+
+
+QString
+SlideDiskCache::directory() {
+    QMutexLocker locker(&mutex);
+    return sCacheDir;
+}
+
+
+bool
+SlideDiskCache::isEnabled() {
+    QMutexLocker locker(&mutex);
+    return !sCacheDir.isEmpty();
+}
+
+
+QString
+SlideDiskCache::entryName(QString sFile, int width, int height, QString sSuffix) {
+    QByteArray pathHash = QCryptographicHash::hash(QFile::encodeName(sFile),
+                                                   QCryptographicHash::Sha1);
+    return QString("%1/%2x%3/%4.%5")
+            .arg(sCacheDir)
+            .arg(width)
+            .arg(height)
+            .arg(QString::fromLatin1(pathHash.toHex()))
+            .arg(sSuffix);
+}
+
+
+// List the entries already in the cache directory, aged by their
+// modification time. Must be called with the mutex locked.
+void
+SlideDiskCache::scanEntries() {
+    entries.clear();
+    usedBytes = 0;
+    if(sCacheDir.isEmpty())
+        return;
+    QDirIterator it(sCacheDir,
+                    QStringList() << QString("*.slide") << QString("*.etc1"),
+                    QDir::Files,
+                    QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        it.next();
+        DiskEntry entry;
+        entry.bytes   = it.fileInfo().size();
+        entry.lastUse = it.fileInfo().lastModified().toMSecsSinceEpoch();
+        entries.insert(it.filePath(), entry);
+        usedBytes += entry.bytes;
+        lastStamp = qMax(lastStamp, entry.lastUse);
+    }
+}
+
+
+// The current time in ms, strictly increasing for entries
+// used within the same ms. Must be called with the mutex locked.
+qint64
+SlideDiskCache::useStamp() {
+    lastStamp = qMax(lastStamp+1, QDateTime::currentMSecsSinceEpoch());
+    return lastStamp;
+}
+
+
+// A hit makes the entry the youngest, on disk too (its mtime)
+// so that the order survives a restart. Must be called with
+// the mutex locked.
+void
+SlideDiskCache::touchEntry(QString sEntry) {
+    utimensat(AT_FDCWD, QFile::encodeName(sEntry).constData(), Q_NULLPTR, 0);
+    QHash<QString, DiskEntry>::iterator it = entries.find(sEntry);
+    if(it != entries.end())
+        it->lastUse = useStamp();
+}
+
+
+// A (re)written entry: the oldest ones are removed if now
+// over budget. Must be called with the mutex locked.
+void
+SlideDiskCache::addEntry(QString sEntry, qint64 entryBytes) {
+    QHash<QString, DiskEntry>::iterator it = entries.find(sEntry);
+    if(it != entries.end())
+        usedBytes -= it->bytes;
+    DiskEntry entry;
+    entry.bytes   = entryBytes;
+    entry.lastUse = useStamp();
+    entries.insert(sEntry, entry);
+    usedBytes += entryBytes;
+    evict(maxBytes);
+}
+
+
+// Delete a stale or evicted entry. A frame still mapped from
+// it stays valid. Must be called with the mutex locked.
+void
+SlideDiskCache::removeEntry(QString sEntry) {
+    QFile::remove(sEntry);
+    QHash<QString, DiskEntry>::iterator it = entries.find(sEntry);
+    if(it != entries.end()) {
+        usedBytes -= it->bytes;
+        entries.erase(it);
+    }
+}
+
+
+// Remove the least recently used entries until no more than
+// maxUsed bytes are on disk. Must be called with the mutex locked.
+void
+SlideDiskCache::evict(qint64 maxUsed) {
+    while((usedBytes > maxUsed) && !entries.isEmpty()) {
+        QHash<QString, DiskEntry>::iterator oldest = entries.begin();
+        for(QHash<QString, DiskEntry>::iterator it=entries.begin(); it!=entries.end(); ++it) {
+            if(it->lastUse < oldest->lastUse)
+                oldest = it;
+        }
+        removeEntry(oldest.key());
+        nEvictions++;
+    }
+}
+
+
+// The entry is of this version, for this screen and for
+// the current content of sFile (the data is not checked)
+bool
+SlideDiskCache::isValid(const void* pEntry, size_t length, QString sFile, int width, int height) {
+    if(length < SLIDE_HEADER_SIZE)
+        return false;
+    const SlideFileHeader* pHeader = reinterpret_cast<const SlideFileHeader*>(pEntry);
+    QFileInfo sourceInfo(sFile);
+    QByteArray pathHash = QCryptographicHash::hash(QFile::encodeName(sFile),
+                                                   QCryptographicHash::Sha1);
+    return (memcmp(pHeader->magic, SLIDE_FILE_MAGIC, sizeof(pHeader->magic)) == 0) &&
+           (pHeader->version     == SLIDE_FILE_VERSION) &&
+           (pHeader->width       == quint32(width)) &&
+           (pHeader->height      == quint32(height)) &&
+           (pHeader->dataOffset  == SLIDE_HEADER_SIZE) &&
+           (pHeader->sourceMtime == sourceInfo.lastModified().toMSecsSinceEpoch()) &&
+           (pHeader->sourceSize  == sourceInfo.size()) &&
+           (memcmp(pHeader->pathHash, pathHash.constData(), sizeof(pHeader->pathHash)) == 0);
+}
+
+
+void
+SlideDiskCache::fillHeader(QByteArray* pHeader, QString sFile, int width, int height) {
+    QFileInfo sourceInfo(sFile);
+    pHeader->fill('\0', SLIDE_HEADER_SIZE);
+    SlideFileHeader* pFields = reinterpret_cast<SlideFileHeader*>(pHeader->data());
+    memcpy(pFields->magic, SLIDE_FILE_MAGIC, sizeof(pFields->magic));
+    pFields->version     = SLIDE_FILE_VERSION;
+    pFields->width       = quint32(width);
+    pFields->height      = quint32(height);
+    pFields->dataOffset  = SLIDE_HEADER_SIZE;
+    pFields->sourceMtime = sourceInfo.lastModified().toMSecsSinceEpoch();
+    pFields->sourceSize  = sourceInfo.size();
+    QByteArray pathHash = QCryptographicHash::hash(QFile::encodeName(sFile),
+                                                   QCryptographicHash::Sha1);
+    memcpy(pFields->pathHash, pathHash.constData(), sizeof(pFields->pathHash));
+}
+
+
+// Map the cached frame of sFile (if there is a valid one) and return
+// it wrapped in *pFrame. The mapping is released with the last QImage copy.
+bool
+SlideDiskCache::find(QString sFile, int width, int height, QImage* pFrame) {
+    QString sEntry;
+    {
+        QMutexLocker locker(&mutex);
+        if(sCacheDir.isEmpty())
+            return false;
+        sEntry = entryName(sFile, width, height);
+    }
+    int fd = open(QFile::encodeName(sEntry).constData(), O_RDONLY);
+    if(fd == -1) {
+        QMutexLocker locker(&mutex);
+        nMisses++;
+        return false;
+    }
+    struct stat entryStat;
+    if((fstat(fd, &entryStat) == -1) || (entryStat.st_size < SLIDE_HEADER_SIZE)) {
+        close(fd);
+        QMutexLocker locker(&mutex);
+        nStale++;
+        removeEntry(sEntry);
+        return false;
+    }
+    size_t length = size_t(entryStat.st_size);
+    // Read the whole file here, on the calling thread, and not
+    // page by page when the frame will be uploaded to the GPU
+    void* pBase = mmap(Q_NULLPTR, length, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if(pBase == MAP_FAILED) {
+        QMutexLocker locker(&mutex);
+        nMisses++;
+        return false;
+    }
+
+    const SlideFileHeader* pHeader = reinterpret_cast<const SlideFileHeader*>(pBase);
+    bool bValid = isValid(pBase, length, sFile, width, height) &&
+                  (pHeader->levels == 0) &&
+                  (length >= SLIDE_HEADER_SIZE + size_t(pHeader->bytesPerLine)*pHeader->height);
+    if(!bValid) {
+        munmap(pBase, length);
+        QMutexLocker locker(&mutex);
+        nStale++;
+        removeEntry(sEntry);
+        return false;
+    }
+
+    MappedSlide* pMapped = new MappedSlide;
+    pMapped->pBase  = pBase;
+    pMapped->length = length;
+    *pFrame = QImage(reinterpret_cast<const uchar*>(pBase) + pHeader->dataOffset,
+                     int(pHeader->width),
+                     int(pHeader->height),
+                     int(pHeader->bytesPerLine),
+                     QImage::Format(pHeader->format),
+                     unmapSlide,
+                     pMapped);
+    QMutexLocker locker(&mutex);
+    nHits++;
+    touchEntry(sEntry);
+    return true;
+}
+
+
+// Write (or rewrite, if stale) the cache entry of sFile
+bool
+SlideDiskCache::store(QString sFile, const QImage& frame) {
+    QString sEntry;
+    {
+        QMutexLocker locker(&mutex);
+        if(sCacheDir.isEmpty() || frame.isNull())
+            return false;
+        sEntry = entryName(sFile, frame.width(), frame.height());
+    }
+    QDir().mkpath(QFileInfo(sEntry).absolutePath());
+
+    QByteArray header;
+    fillHeader(&header, sFile, frame.width(), frame.height());
+    SlideFileHeader* pHeader = reinterpret_cast<SlideFileHeader*>(header.data());
+    pHeader->bytesPerLine = quint32(frame.bytesPerLine());
+    pHeader->format       = quint32(frame.format());
+
+    // QSaveFile renames the entry in place only when completely written
+    QSaveFile file(sEntry);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Unable to write" << sEntry;
+        return false;
+    }
+    qint64 frameBytes = qint64(frame.bytesPerLine())*frame.height();
+    if((file.write(header) != header.size()) ||
+       (file.write(reinterpret_cast<const char*>(frame.constBits()), frameBytes) != frameBytes))
+    {
+        qDebug() << "Error writing" << sEntry;
+        file.cancelWriting();
+        return false;
+    }
+    qint64 entryBytes = file.size();
+    if(!file.commit())
+        return false;
+    QMutexLocker locker(&mutex);
+    addEntry(sEntry, entryBytes);
+    return true;
+}
+
+
+// The nLevels ETC1 levels of sFile compressed for a width x height
+// screen. They are small: just read, not mapped.
+bool
+SlideDiskCache::findCompressed(QString sFile, int width, int height, int nLevels, QVector<QByteArray>* pLevels) {
+    QString sEntry;
+    {
+        QMutexLocker locker(&mutex);
+        if(sCacheDir.isEmpty())
+            return false;
+        sEntry = entryName(sFile, width, height, QString("etc1"));
+    }
+    QFile file(sEntry);
+    if(!file.open(QIODevice::ReadOnly)) {
+        QMutexLocker locker(&mutex);
+        nCompressedMisses++;
+        return false;
+    }
+    QByteArray entry = file.readAll();
+    file.close();
+    const SlideFileHeader* pHeader = reinterpret_cast<const SlideFileHeader*>(entry.constData());
+    bool bValid = isValid(entry.constData(), size_t(entry.size()), sFile, width, height) &&
+                  (pHeader->levels == quint32(nLevels)) &&
+                  (pHeader->format == SLIDE_FORMAT_ETC1);
+    // Every level is preceded by its size
+    pLevels->clear();
+    int offset = SLIDE_HEADER_SIZE;
+    for(int i=0; bValid && (i<nLevels); i++) {
+        quint32 levelBytes = 0;
+        bValid = offset + int(sizeof(levelBytes)) <= entry.size();
+        if(!bValid)
+            break;
+        memcpy(&levelBytes, entry.constData()+offset, sizeof(levelBytes));
+        offset += int(sizeof(levelBytes));
+        bValid = qint64(offset) + levelBytes <= entry.size();
+        if(bValid)
+            pLevels->append(entry.mid(offset, int(levelBytes)));
+        offset += int(levelBytes);
+    }
+    QMutexLocker locker(&mutex);
+    if(!bValid) {
+        pLevels->clear();
+        nCompressedStale++;
+        removeEntry(sEntry);
+        return false;
+    }
+    nCompressedHits++;
+    touchEntry(sEntry);
+    return true;
+}
+
+
+bool
+SlideDiskCache::storeCompressed(QString sFile, int width, int height, const QVector<QByteArray>& levels) {
+    QString sEntry;
+    {
+        QMutexLocker locker(&mutex);
+        if(sCacheDir.isEmpty() || levels.isEmpty())
+            return false;
+        sEntry = entryName(sFile, width, height, QString("etc1"));
+    }
+    QDir().mkpath(QFileInfo(sEntry).absolutePath());
+
+    QByteArray header;
+    fillHeader(&header, sFile, width, height);
+    SlideFileHeader* pHeader = reinterpret_cast<SlideFileHeader*>(header.data());
+    pHeader->format = SLIDE_FORMAT_ETC1;
+    pHeader->levels = quint32(levels.count());
+
+    QSaveFile file(sEntry);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Unable to write" << sEntry;
+        return false;
+    }
+    bool bWritten = file.write(header) == header.size();
+    for(int i=0; bWritten && (i<levels.count()); i++) {
+        quint32 levelBytes = quint32(levels.at(i).size());
+        bWritten = (file.write(reinterpret_cast<const char*>(&levelBytes), sizeof(levelBytes)) == qint64(sizeof(levelBytes))) &&
+                   (file.write(levels.at(i)) == levels.at(i).size());
+    }
+    if(!bWritten) {
+        qDebug() << "Error writing" << sEntry;
+        file.cancelWriting();
+        return false;
+    }
+    qint64 entryBytes = file.size();
+    if(!file.commit())
+        return false;
+    QMutexLocker locker(&mutex);
+    addEntry(sEntry, entryBytes);
+    return true;
+}
+
+
+int
+SlideDiskCache::hits() {
+    QMutexLocker locker(&mutex);
+    return nHits;
+}
+
+
+int
+SlideDiskCache::misses() {
+    QMutexLocker locker(&mutex);
+    return nMisses;
+}
+
+
+int
+SlideDiskCache::staleEntries() {
+    QMutexLocker locker(&mutex);
+    return nStale;
+}
+
+
+int
+SlideDiskCache::compressedHits() {
+    QMutexLocker locker(&mutex);
+    return nCompressedHits;
+}
+
+
+int
+SlideDiskCache::compressedMisses() {
+    QMutexLocker locker(&mutex);
+    return nCompressedMisses;
+}
+
+
+int
+SlideDiskCache::staleCompressedEntries() {
+    QMutexLocker locker(&mutex);
+    return nCompressedStale;
+}
+
+
+int
+SlideDiskCache::evictions() {
+    QMutexLocker locker(&mutex);
+    return nEvictions;
+}
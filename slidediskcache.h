@@ -0,0 +1,81 @@
+#ifndef SLIDEDISKCACHE_H
+#define SLIDEDISKCACHE_H
+
+#include <QString>
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+#include <QMutex>
+#include <QHash>
+
+
+class SlideDiskCache
+{
+public:
+    SlideDiskCache();
+    void setDirectory(QString sDir);
+    QString directory();
+    bool isEnabled();
+    void setBudget(qint64 newBudget);
+    qint64 budget();
+    qint64 bytesUsed();
+    bool find(QString sFile, int width, int height, QImage* pFrame);
+    bool store(QString sFile, const QImage& frame);
+    bool findCompressed(QString sFile, int width, int height, int nLevels, QVector<QByteArray>* pLevels);
+    bool storeCompressed(QString sFile, int width, int height, const QVector<QByteArray>& levels);
+    int  hits();
+    int  misses();
+    int  staleEntries();
+    int  compressedHits();
+    int  compressedMisses();
+    int  staleCompressedEntries();
+    int  evictions();
+
+private:
+    QString entryName(QString sFile, int width, int height, QString sSuffix = QString("slide"));
+    bool isValid(const void* pEntry, size_t length, QString sFile, int width, int height);
+    void fillHeader(QByteArray* pHeader, QString sFile, int width, int height);
+    void scanEntries();
+    void touchEntry(QString sEntry);
+    void addEntry(QString sEntry, qint64 entryBytes);
+    void removeEntry(QString sEntry);
+    void evict(qint64 maxUsed);
+    qint64 useStamp();
+
+private:
+    // On disk layout: this header padded to SLIDE_HEADER_SIZE
+    // bytes followed by height rows of bytesPerLine bytes each or,
+    // for ETC1 compressed slides, by the levels one after the other.
+    struct SlideFileHeader {
+        char    magic[8];
+        quint32 version;
+        quint32 width;
+        quint32 height;
+        quint32 bytesPerLine;
+        quint32 format;
+        quint32 dataOffset;
+        qint64  sourceMtime;
+        qint64  sourceSize;
+        char    pathHash[20];
+        quint32 levels;// ETC1 levels (0: uncompressed)
+    };
+    struct DiskEntry {
+        qint64 bytes;
+        qint64 lastUse;// Entry mtime (ms): refreshed by every hit
+    };
+    QMutex mutex;
+    QString sCacheDir;
+    QHash<QString, DiskEntry> entries;// Every entry file, by path
+    qint64 maxBytes;
+    qint64 usedBytes;
+    qint64 lastStamp;
+    int nEvictions;
+    int nHits;
+    int nMisses;
+    int nStale;
+    int nCompressedHits;// ETC1 lookups, counted apart
+    int nCompressedMisses;
+    int nCompressedStale;
+};
+
+#endif // SLIDEDISKCACHE_H
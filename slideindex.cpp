@@ -0,0 +1,461 @@
+#include "slideindex.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QSet>
+#include <QMutexLocker>
+
+
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | \
+                      IN_DELETE_SELF | IN_MOVE_SELF)
+
+
+SlideIndex::SlideIndex(QObject* parent)
+    : QObject(parent)
+{
+    bRecursive      = false;
+    iScanGeneration = 0;
+    bRefreshing     = false;
+    bEnumerating    = false;
+    bDirty          = false;
+    inotifyFd       = -1;
+    watchDescriptor = -1;
+    pNotifier       = Q_NULLPTR;
+    connect(&scanner, SIGNAL(slidesFound()),
+            this, SLOT(onSlidesFound()));
+    connect(&scanner, SIGNAL(enumerationDone(int)),
+            this, SLOT(onEnumerationDone(int)));
+    connect(&scanner, SIGNAL(slidesProbed()),
+            this, SLOT(onSlidesProbed()));
+    connect(&scanner, SIGNAL(scanDone(int)),
+            this, SLOT(onScanDone(int)));
+}
+
+
+SlideIndex::~SlideIndex() {
+    scanner.stop();
+    if(bDirty)
+        saveIndex();
+    stopWatching();
+}
+
+
+// The index saved by the last run (if any) is available at once;
+// the directory is then scanned in background to bring it up to
+// date. Without a saved index the slides are added while found.
+// From now on inotify will keep the index updated.
+void
+SlideIndex::setDirectory(QString sNewDir) {
+    if(bDirty)
+        saveIndex();
+    scanner.cancel();
+    stopWatching();
+    {
+        QMutexLocker locker(&mutex);
+        sDir = QDir(sNewDir).absolutePath();
+    }
+    startWatching();
+    bool bLoaded;
+    {
+        QMutexLocker locker(&mutex);
+        bLoaded = !sCacheDir.isEmpty() && slides.load(indexFile());
+        if(!bLoaded)
+            slides.clear();
+    }
+    emit slidesReset();
+    rescan(bLoaded);
+}
+
+
+QString
+SlideIndex::directory() {
+    QMutexLocker locker(&mutex);
+    return sDir;
+}
+
+
+// Include the slides in the subdirectories too
+void
+SlideIndex::setRecursive(bool bRecurse) {
+    if(bRecurse == bRecursive)
+        return;
+    bRecursive = bRecurse;
+    if(!sDir.isEmpty())
+        setDirectory(sDir);
+}
+
+
+bool
+SlideIndex::isRecursive() {
+    return bRecursive;
+}
+
+
+// Where the index is saved between runs (empty to never save it)
+void
+SlideIndex::setCacheDirectory(QString sDir) {
+    sCacheDir = sDir;
+    if(!sCacheDir.isEmpty() && !QDir().mkpath(sCacheDir)) {
+        qDebug() << "Unable to create the slide index directory" << sCacheDir;
+        sCacheDir.clear();
+    }
+}
+
+
+bool
+SlideIndex::isWatching() {
+    return watchDescriptor != -1;
+}
+
+
+bool
+SlideIndex::isScanning() {
+    return scanner.isScanning();
+}
+
+
+int
+SlideIndex::count() {
+    QMutexLocker locker(&mutex);
+    return slides.count();
+}
+
+
+// The path relative to the slide directory
+QString
+SlideIndex::fileName(int iSlide) {
+    QMutexLocker locker(&mutex);
+    if((iSlide < 0) || (iSlide >= slides.count()))
+        return QString();// Removed meanwhile (other threads)
+    return QFile::decodeName(slides.name(iSlide));
+}
+
+
+QString
+SlideIndex::filePath(int iSlide) {
+    QMutexLocker locker(&mutex);
+    if((iSlide < 0) || (iSlide >= slides.count()))
+        return QString();
+    return sDir + QString("/") + QFile::decodeName(slides.name(iSlide));
+}
+
+
+// Size and orientation are valid only when the SLIDE_RECORD_PROBED
+// flag is set. Only in the thread of the index: not locked.
+const SlideRecord&
+SlideIndex::slideInfo(int iSlide) {
+    return slides.record(iSlide);
+}
+
+
+// Position of sName in the index or -1 if not present
+int
+SlideIndex::indexOf(QString sName) {
+    QMutexLocker locker(&mutex);
+    return slides.indexOf(QFile::encodeName(sName).constData());
+}
+
+
+int
+SlideIndex::memoryBytes() {
+    QMutexLocker locker(&mutex);
+    return slides.memoryBytes() + staging.memoryBytes();
+}
+
+
+QString
+SlideIndex::indexFile() {
+    QByteArray key = QFile::encodeName(sDir);
+    if(bRecursive)
+        key += "|recursive";
+    QByteArray keyHash = QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+    return QString("%1/%2.index")
+            .arg(sCacheDir)
+            .arg(QString::fromLatin1(keyHash.toHex()));
+}
+
+
+void
+SlideIndex::saveIndex() {
+    bDirty = false;
+    if(sCacheDir.isEmpty() || sDir.isEmpty())
+        return;
+    if(!slides.save(indexFile()))
+        qDebug() << "Unable to save the slide index" << indexFile();
+}
+
+
+// With bRefresh the current index stays as it is until
+// the whole directory tree has been listed
+void
+SlideIndex::rescan(bool bRefresh) {
+    bRefreshing  = bRefresh;
+    bEnumerating = true;
+    {
+        QMutexLocker locker(&mutex);
+        staging.clear();
+    }
+    pendingChanges.clear();
+    iScanGeneration = scanner.scan(sDir, bRecursive, slides);
+}
+
+
+void
+SlideIndex::onSlidesFound() {
+    SlideTable found;
+    QList<QByteArray> directories;
+    scanner.takeFound(&found, &directories);
+    for(int i=0; i<directories.count(); i++)
+        watchDirectory(directories.at(i));
+    if(found.count() == 0)
+        return;
+    QMutexLocker locker(&mutex);
+    if(bRefreshing) {
+        staging.merge(found);
+        return;
+    }
+    slides.merge(found);
+    locker.unlock();
+    bDirty = true;
+    emit slidesReset();
+}
+
+
+void
+SlideIndex::onEnumerationDone(int iGeneration) {
+    if(iGeneration != iScanGeneration)
+        return;
+    bEnumerating = false;
+    if(!bRefreshing) {
+        // Slides listed just before being removed are back: drop them
+        QSet<QByteArray> seen;
+        for(int i=pendingChanges.count()-1; i>=0; i--) {
+            const QByteArray& name = pendingChanges.at(i).second;
+            if(seen.contains(name))
+                continue;// Only the last change counts
+            seen.insert(name);
+            if(pendingChanges.at(i).first)
+                continue;
+            QMutexLocker locker(&mutex);
+            int iPosition = slides.indexOf(name.constData());
+            if(iPosition == -1)
+                continue;
+            slides.remove(iPosition);
+            locker.unlock();
+            emit slideRemoved(iPosition);
+        }
+        pendingChanges.clear();
+        return;
+    }
+    // Changes notified while scanning may be missing from staging
+    QMutexLocker locker(&mutex);
+    for(int i=0; i<pendingChanges.count(); i++) {
+        const char* pName = pendingChanges.at(i).second.constData();
+        if(pendingChanges.at(i).first) {
+            int iSlide = slides.indexOf(pName);
+            int iPosition;
+            if(iSlide != -1)
+                staging.insert(pName, slides.record(iSlide), &iPosition);
+        }
+        else {
+            int iPosition = staging.indexOf(pName);
+            if(iPosition != -1)
+                staging.remove(iPosition);
+        }
+    }
+    pendingChanges.clear();
+    slides = staging;
+    staging.clear();
+    locker.unlock();
+    bRefreshing = false;
+    bDirty = true;
+    emit slidesReset();
+}
+
+
+void
+SlideIndex::onSlidesProbed() {
+    SlideTable probed;
+    scanner.takeProbed(&probed);
+    QMutexLocker locker(&mutex);
+    for(int i=0; i<probed.count(); i++) {
+        int iSlide = slides.indexOf(probed.name(i));
+        if(iSlide == -1)
+            continue;
+        SlideRecord& current = slides.record(iSlide);
+        const SlideRecord& info = probed.record(i);
+        if(current.mtime != info.mtime)
+            continue;// Rewritten in the meantime
+        current.width       = info.width;
+        current.height      = info.height;
+        current.orientation = info.orientation;
+        current.flags       = info.flags;
+        bDirty = true;
+    }
+}
+
+
+void
+SlideIndex::onScanDone(int iGeneration) {
+    if(iGeneration == iScanGeneration)
+        saveIndex();
+}
+
+
+void
+SlideIndex::startWatching() {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotifyFd == -1) {
+        qDebug() << "inotify_init1() failed:" << strerror(errno);
+        return;
+    }
+    watchDirectory(QByteArray());
+    watchDescriptor = watchedDirs.key(QByteArray(), -1);
+    if(watchDescriptor == -1) {
+        qDebug() << "Unable to watch" << sDir;
+        close(inotifyFd);
+        inotifyFd = -1;
+        return;
+    }
+    pNotifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+    connect(pNotifier, SIGNAL(activated(int)),
+            this, SLOT(onInotifyEvent()));
+}
+
+
+// Subdirectories are watched as the scanner finds them
+void
+SlideIndex::watchDirectory(const QByteArray& prefix) {
+    if(inotifyFd == -1)
+        return;
+    QByteArray path = QFile::encodeName(sDir);
+    uint32_t mask = INOTIFY_MASK;
+    if(!prefix.isEmpty())
+        path += "/" + prefix;
+    if(bRecursive)
+        mask |= IN_CREATE;// For the new subdirectories
+    int wd = inotify_add_watch(inotifyFd, path.constData(), mask);
+    if(wd != -1)
+        watchedDirs.insert(wd, prefix.isEmpty() ? prefix : prefix + "/");
+}
+
+
+void
+SlideIndex::stopWatching() {
+    if(pNotifier) {
+        pNotifier->setEnabled(false);
+        pNotifier->deleteLater();
+        pNotifier = Q_NULLPTR;
+    }
+    if(inotifyFd != -1)
+        close(inotifyFd);// Removes the watches too
+    inotifyFd       = -1;
+    watchDescriptor = -1;
+    watchedDirs.clear();
+}
+
+
+bool
+SlideIndex::isSlide(QString sName) {
+    QByteArray name = QFile::encodeName(sName);
+    return SlideScanner::isSlideName(name.constData(), name.size());
+}
+
+
+void
+SlideIndex::insertSlide(QString sName) {
+    QByteArray name = QFile::encodeName(sName);
+    SlideRecord info;
+    memset(&info, 0, sizeof(info));// Probed by the next scan
+    info.mtime = QFileInfo(sDir + QString("/") + sName).lastModified().toMSecsSinceEpoch();
+    int iPosition;
+    bool bNew;
+    {
+        QMutexLocker locker(&mutex);
+        bNew = slides.insert(name.constData(), info, &iPosition);
+    }
+    bDirty = true;
+    if(bEnumerating)
+        pendingChanges.append(qMakePair(true, name));
+    if(bNew)
+        emit slideInserted(iPosition);
+}
+
+
+void
+SlideIndex::removeSlide(QString sName) {
+    QByteArray name = QFile::encodeName(sName);
+    if(bEnumerating)
+        pendingChanges.append(qMakePair(false, name));
+    int iPosition;
+    {
+        QMutexLocker locker(&mutex);
+        iPosition = slides.indexOf(name.constData());
+        if(iPosition == -1)
+            return;
+        slides.remove(iPosition);
+    }
+    bDirty = true;
+    emit slideRemoved(iPosition);
+}
+
+
+// New files are added when closed after writing (or moved in)
+// so that half written slides are never shown.
+void
+SlideIndex::onInotifyEvent() {
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    bool bRescan  = false;
+    bool bRefresh = false;
+    forever {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+        for(char* ptr=buffer; ptr<buffer+length; ) {
+            const struct inotify_event* pEvent = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + pEvent->len;
+            if(pEvent->mask & IN_Q_OVERFLOW) {
+                bRescan = true;
+                continue;
+            }
+            if(pEvent->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                if(pEvent->wd == watchDescriptor)
+                    bRescan = true;
+                else if(pEvent->mask & IN_IGNORED)
+                    watchedDirs.remove(pEvent->wd);
+                continue;
+            }
+            if(pEvent->len == 0)
+                continue;
+            if(pEvent->mask & IN_ISDIR) {
+                // Subdirectories come and go with all their slides
+                if(bRecursive)
+                    bRefresh = true;
+                continue;
+            }
+            QString sName = QFile::decodeName(watchedDirs.value(pEvent->wd) + QByteArray(pEvent->name));
+            if(!isSlide(sName))
+                continue;
+            if(pEvent->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                insertSlide(sName);
+            else if(pEvent->mask & (IN_DELETE | IN_MOVED_FROM))
+                removeSlide(sName);
+        }
+    }
+    if(bRescan) {
+        // The directory itself is gone or we lost events
+        setDirectory(sDir);
+    }
+    else if(bRefresh) {
+        rescan(true);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef SLIDEINDEX_H
+#define SLIDEINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSocketNotifier>
+#include <QMutex>
+
+#include "slidetable.h"
+#include "slidescanner.h"
+
+
+// The slides of a directory. Changed only in the thread of the index
+// (scan results and inotify events): count(), fileName(), filePath(),
+// indexOf() and memoryBytes() may be called from other threads too
+// (the outputs following the first one share its index).
+class SlideIndex : public QObject
+{
+    Q_OBJECT
+public:
+    SlideIndex(QObject* parent = Q_NULLPTR);
+    ~SlideIndex();
+    void setDirectory(QString sNewDir);
+    QString directory();
+    void setRecursive(bool bRecurse);
+    bool isRecursive();
+    void setCacheDirectory(QString sDir);
+    bool isWatching();
+    bool isScanning();
+    int  count();
+    QString fileName(int iSlide);
+    QString filePath(int iSlide);
+    const SlideRecord& slideInfo(int iSlide);
+    int  indexOf(QString sName);
+    int  memoryBytes();
+
+signals:
+    void slideInserted(int iPosition);
+    void slideRemoved(int iPosition);
+    void slidesReset();
+
+private slots:
+    void onInotifyEvent();
+    void onSlidesFound();
+    void onEnumerationDone(int iGeneration);
+    void onSlidesProbed();
+    void onScanDone(int iGeneration);
+
+private:
+    void rescan(bool bRefresh);
+    void startWatching();
+    void stopWatching();
+    void watchDirectory(const QByteArray& prefix);
+    bool isSlide(QString sName);
+    void insertSlide(QString sName);
+    void removeSlide(QString sName);
+    QString indexFile();
+    void saveIndex();
+
+private:
+    QMutex mutex;// Guards sDir, slides and staging
+    QString sDir;
+    QString sCacheDir;
+    bool bRecursive;
+    SlideTable slides;
+    SlideScanner scanner;
+    int  iScanGeneration;
+    // While refreshing a loaded index the scan results are
+    // collected apart and replace the index at the end
+    bool bRefreshing;
+    SlideTable staging;
+    // Changes notified while the directory is listed
+    bool bEnumerating;
+    QList<QPair<bool, QByteArray> > pendingChanges;// Inserted?, name
+    bool bDirty;
+    int inotifyFd;
+    int watchDescriptor;
+    QHash<int, QByteArray> watchedDirs;// Watch descriptor -> path prefix
+    QSocketNotifier* pNotifier;
+};
+
+#endif // SLIDEINDEX_H
@@ -0,0 +1,167 @@
+#include "slideloader.h"
+
+#include <QDebug>
+#include <QImageReader>
+
+#include "framepool.h"
+#include "jpegdecoder.h"
+#include "stripdecoder.h"
+#include "letterbox.h"
+#include "tracer.h"
+
+
+#define DEFAULT_MEMORY_LIMIT (96*1024*1024) // Bytes for preparing a slide
+#define MIN_DECODE_MEMORY    ( 4*1024*1024)
+
+
+SlideLoader::SlideLoader() {
+    screen_width  = 0;
+    screen_height = 0;
+    imageMode     = Qt::KeepAspectRatio;
+    imageFormat   = QImage::Format_RGBA8888_Premultiplied;
+    memory_limit  = DEFAULT_MEMORY_LIMIT;
+}
+
+
+void
+SlideLoader::setScreenSize(int width, int height) {
+    screen_width  = width;
+    screen_height = height;
+}
+
+
+int
+SlideLoader::screenWidth() {
+    return screen_width;
+}
+
+
+int
+SlideLoader::screenHeight() {
+    return screen_height;
+}
+
+
+// Load a slide and letterbox it into a screen sized, vertically flipped
+// frame ready to be used as a texture. An unreadable file gives a white frame.
+bool
+SlideLoader::load(QString sFile, QImage* pFrame) {
+    TraceSpan span("loadSlide", "decode");
+    QImage image;
+    bool bLoaded = decode(sFile, screen_width, screen_height, &image);
+    if(!compose(image, screen_width, screen_height, pFrame))
+        return false;
+    return bLoaded;
+}
+
+
+// The same for several screens: the file is decoded only once
+// (large enough for the biggest screen) and then scaled for each.
+bool
+SlideLoader::load(QString sFile, const QVector<QSize>& screens, QVector<QImage>* pFrames) {
+    TraceSpan span("loadSlide", "decode");
+    int maxWidth  = 0;
+    int maxHeight = 0;
+    for(int i=0; i<screens.count(); i++) {
+        maxWidth  = qMax(maxWidth,  screens.at(i).width());
+        maxHeight = qMax(maxHeight, screens.at(i).height());
+    }
+    QImage image;
+    bool bLoaded = decode(sFile, maxWidth, maxHeight, &image);
+    pFrames->resize(screens.count());
+    for(int i=0; i<screens.count(); i++) {
+        if(!compose(image, screens.at(i).width(), screens.at(i).height(), &(*pFrames)[i]))
+            return false;
+    }
+    return bLoaded;
+}
+
+
+// Peak memory (bytes) for preparing a slide, decoded image and screen
+// frames included: larger images are decoded in strips (or not at all)
+void
+SlideLoader::setMemoryLimit(qint64 bytes) {
+    memory_limit = bytes;
+}
+
+
+qint64
+SlideLoader::memoryLimit() {
+    return memory_limit;
+}
+
+
+// The image composed by load() for a width x height screen: downscaled
+// by the JPEG decoder or the StripDecoder, if at all
+bool
+SlideLoader::decode(QString sFile, int width, int height, QImage* pImage) {
+    TraceSpan decodeSpan("decodeImage", "decode");
+    // What is left after the frame and the one it replaces
+    qint64 decodeLimit = qMax(memory_limit - 2*4*qint64(width)*height, qint64(MIN_DECODE_MEMORY));
+    bool bLoaded = false;
+    // JPEGs are decoded already downscaled near to the screen size
+    if(JpegDecoder::isJpeg(sFile))
+        bLoaded = JpegDecoder::decode(sFile, width, height, pImage, decodeLimit);
+    if(!bLoaded) {
+        if(StripDecoder::fullDecodeBytes(sFile) > decodeLimit) {
+            bLoaded = StripDecoder::decode(sFile, width, height, decodeLimit, pImage);
+        }
+        else {
+            // Read into a pooled image: the Qt handlers (PNG among them)
+            // reuse its buffer when size and format are what they read
+            QImageReader reader(sFile);
+            *pImage = FramePool::instance()->image(reader.size(), reader.imageFormat());
+            bLoaded = reader.read(pImage);
+        }
+    }
+    if(!bLoaded) {
+        qDebug() << "Unable to load" << sFile;
+        *pImage = QImage();
+    }
+    return bLoaded;
+}
+
+
+// Letterbox an image, scaled to fit, into a width x height frame. The
+// storage of *pFrame is reused when it has already the right size and
+// format and nobody else holds it, otherwise a frame is taken from
+// the FramePool.
+bool
+SlideLoader::compose(QImage image, int width, int height, QImage* pFrame) {
+    QSize scaledSize(0, 0);
+    if(!image.isNull())
+        scaledSize = image.size().scaled(width, height, imageMode);
+    if((pFrame->width() != width) || (pFrame->height() != height) ||
+       (pFrame->format() != imageFormat) || !pFrame->isDetached())
+    {
+        *pFrame = FramePool::instance()->image(width, height, imageFormat);
+    }
+    if(pFrame->isNull()) {
+        qDebug() << "Unable to create the slide frame";
+        return false;
+    }
+    // The letterbox kernel wants premultiplied RGBA or BGRA bytes
+    bool bSwapRB = false;
+    switch(image.format()) {
+        case QImage::Format_RGBX8888:
+        case QImage::Format_RGBA8888_Premultiplied:
+            break;
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            bSwapRB = true;
+            break;
+#endif
+        default: {
+            TraceSpan convertSpan("convertImage", "decode");
+            image = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+            break;
+        }
+    }
+    // Scale, flip, center over a white background and convert in a single pass
+    TraceSpan letterboxSpan("letterboxFlip", "decode");
+    letterboxScaleFlip(image.constBits(), image.width(), image.height(), image.bytesPerLine(),
+                       bSwapRB, scaledSize.width(), scaledSize.height(),
+                       pFrame->bits(), pFrame->width(), pFrame->height(), pFrame->bytesPerLine());
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef SLIDELOADER_H
+#define SLIDELOADER_H
+
+#include <QString>
+#include <QImage>
+#include <QSize>
+#include <QVector>
+
+
+class SlideLoader
+{
+public:
+    SlideLoader();
+    void setScreenSize(int width, int height);
+    int  screenWidth();
+    int  screenHeight();
+    void setMemoryLimit(qint64 bytes);
+    qint64 memoryLimit();
+    bool load(QString sFile, QImage* pFrame);
+    bool load(QString sFile, const QVector<QSize>& screens, QVector<QImage>* pFrames);
+    bool compose(QImage image, int width, int height, QImage* pFrame);
+    bool decode(QString sFile, int width, int height, QImage* pImage);
+
+private:
+    int screen_width;
+    int screen_height;
+    qint64 memory_limit;
+    QImage::Format imageFormat;
+    enum Qt::AspectRatioMode imageMode;
+};
+
+#endif // SLIDELOADER_H
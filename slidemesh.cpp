@@ -0,0 +1,88 @@
+#include "slidemesh.h"
+
+#include <QVector>
+
+
+SlideMesh::SlideMesh() {
+    vertexBuf = 0;
+    indexBuf  = 0;
+    nVertices = 0;
+    nIndices  = 0;
+}
+
+
+bool
+SlideMesh::create(int nxSteps, int nySteps) {
+    destroy();
+    int nxVertices = nxSteps + 1;
+    int nyVertices = nySteps + 1;
+    // Indices are 16 bits wide in OpenGL ES 2
+    if((nxSteps < 1) || (nySteps < 1) || (nxVertices*nyVertices > 65536))
+        return false;
+
+    QVector<GridVertex> vertices;
+    vertices.reserve(nxVertices*nyVertices);
+    for(int j=0; j<nyVertices; j++) {
+        for(int i=0; i<nxVertices; i++) {
+            GridVertex vertex;
+            vertex.u = GLushort((i*65535 + nxSteps/2) / nxSteps);
+            vertex.v = GLushort((j*65535 + nySteps/2) / nySteps);
+            vertices.append(vertex);
+        }
+    }
+    QVector<GLushort> indices;
+    indices.reserve(6*nxSteps*nySteps);
+    for(int j=0; j<nySteps; j++) {
+        for(int i=0; i<nxSteps; i++) {
+            GLushort bottomLeft = GLushort(j*nxVertices + i);
+            GLushort topLeft    = GLushort(bottomLeft + nxVertices);
+            indices << bottomLeft << GLushort(bottomLeft+1) << topLeft;
+            indices << topLeft    << GLushort(bottomLeft+1) << GLushort(topLeft+1);
+        }
+    }
+    nVertices = vertices.count();
+    nIndices  = indices.count();
+
+    glGenBuffers(1, &vertexBuf);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuf);
+    glBufferData(GL_ARRAY_BUFFER, nVertices*sizeof(GridVertex), vertices.constData(), GL_STATIC_DRAW);
+    glGenBuffers(1, &indexBuf);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, nIndices*sizeof(GLushort), indices.constData(), GL_STATIC_DRAW);
+    return true;
+}
+
+
+void
+SlideMesh::destroy() {
+    if(vertexBuf != 0)
+        glDeleteBuffers(1, &vertexBuf);
+    if(indexBuf != 0)
+        glDeleteBuffers(1, &indexBuf);
+    vertexBuf = 0;
+    indexBuf  = 0;
+    nVertices = 0;
+    nIndices  = 0;
+}
+
+
+void
+SlideMesh::draw(GLint positionLocation) {
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuf);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuf);
+    glVertexAttribPointer(positionLocation,
+                          2,
+                          GL_UNSIGNED_SHORT,
+                          GL_TRUE,// Normalized to 0.0 - 1.0
+                          sizeof(GridVertex),
+                          0);
+    glEnableVertexAttribArray(positionLocation);
+    glDrawElements(GL_TRIANGLES, nIndices, GL_UNSIGNED_SHORT, 0);
+}
+
+
+// Bytes of vertex and index data read by each draw
+int
+SlideMesh::vertexBytes() {
+    return nVertices*int(sizeof(GridVertex)) + nIndices*int(sizeof(GLushort));
+}
@@ -0,0 +1,30 @@
+#ifndef SLIDEMESH_H
+#define SLIDEMESH_H
+
+#include "GLES2/gl2.h"
+
+
+// A nxSteps x nySteps grid covering the whole slide. Vertices only carry
+// their normalized grid coordinates (2 unsigned shorts): the vertex shaders
+// derive from them both the position and the texture coordinates.
+class SlideMesh
+{
+public:
+    SlideMesh();
+    bool create(int nxSteps, int nySteps);
+    void destroy();
+    void draw(GLint positionLocation);
+    int  vertexBytes();
+
+private:
+    struct GridVertex {
+        GLushort u;
+        GLushort v;
+    };
+    GLuint vertexBuf;
+    GLuint indexBuf;
+    GLsizei nVertices;
+    GLsizei nIndices;
+};
+
+#endif // SLIDEMESH_H
@@ -0,0 +1,92 @@
+#include "slideprefetcher.h"
+
+
+#define DEFAULT_PREFETCH_DEPTH 2 // Slides decoded ahead of time
+
+
+// pDecodePool = Q_NULLPTR: the pool of the process
+SlidePrefetcher::SlidePrefetcher(DecodePool* pDecodePool) {
+    pPool   = pDecodePool ? pDecodePool : DecodePool::instance();
+    iClient = pPool->addClient();
+    nDepth  = DEFAULT_PREFETCH_DEPTH;
+}
+
+
+SlidePrefetcher::~SlidePrefetcher() {
+    stop();
+}
+
+
+// Forget the slides of this output: the workers keep serving the others
+void
+SlidePrefetcher::stop() {
+    if(iClient < 0)
+        return;
+    pPool->removeClient(iClient);
+    iClient = -1;
+}
+
+
+void
+SlidePrefetcher::setScreenSize(int width, int height) {
+    pPool->setScreenSize(iClient, width, height);
+}
+
+
+// Only read and written by the output thread
+void
+SlidePrefetcher::setDepth(int newDepth) {
+    nDepth = qMax(1, newDepth);
+}
+
+
+int
+SlidePrefetcher::depth() {
+    return nDepth;
+}
+
+
+DecodePool*
+SlidePrefetcher::decodePool() {
+    return pPool;
+}
+
+
+SlideCache*
+SlidePrefetcher::slideCache() {
+    return pPool->slideCache();
+}
+
+
+SlideDiskCache*
+SlidePrefetcher::slideDiskCache() {
+    return pPool->slideDiskCache();
+}
+
+
+FrameStats*
+SlidePrefetcher::decodeStatistics() {
+    return pPool->decodeStatistics();
+}
+
+
+int
+SlidePrefetcher::prefetchMisses() {
+    return pPool->prefetchMisses(iClient);
+}
+
+
+// Replace the list of the slides that will be shown next.
+// Ready frames no more scheduled are dropped.
+void
+SlidePrefetcher::schedule(QStringList sUpcoming) {
+    pPool->schedule(iClient, sUpcoming);
+}
+
+
+// Return the prepared frame of sFile waiting for the workers
+// if it is not yet ready (a "prefetch miss"), and whether it is animated.
+QImage
+SlidePrefetcher::takeSlide(QString sFile, bool* pAnimated) {
+    return pPool->takeSlide(iClient, sFile, pAnimated);
+}
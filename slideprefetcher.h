@@ -0,0 +1,35 @@
+#ifndef SLIDEPREFETCHER_H
+#define SLIDEPREFETCHER_H
+
+#include <QStringList>
+#include <QImage>
+
+#include "decodepool.h"
+
+
+// The slides of one output decoded ahead of time by the
+// (shared) DecodePool workers
+class SlidePrefetcher
+{
+public:
+    SlidePrefetcher(DecodePool* pDecodePool = Q_NULLPTR);
+    ~SlidePrefetcher();
+    void setScreenSize(int width, int height);
+    void setDepth(int newDepth);
+    int  depth();
+    void schedule(QStringList sUpcoming);
+    QImage takeSlide(QString sFile, bool* pAnimated = Q_NULLPTR);
+    int  prefetchMisses();
+    DecodePool* decodePool();
+    SlideCache* slideCache();
+    SlideDiskCache* slideDiskCache();
+    FrameStats* decodeStatistics();
+    void stop();
+
+private:
+    DecodePool* pPool;
+    int iClient;
+    int nDepth;
+};
+
+#endif // SLIDEPREFETCHER_H
@@ -0,0 +1,341 @@
+#include "slidescanner.h"
+#include "tracer.h"
+
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QImageReader>
+#include <QMutexLocker>
+
+
+#define FIRST_BATCH_SLIDES     64 // Grows up to MAX_BATCH_SLIDES
+#define MAX_BATCH_SLIDES    16384
+#define MAX_BATCH_TIME        250 // ms: slow disks still deliver often
+#define DIRENT_BUFFER_SIZE  32768
+
+
+// What getdents64() returns (not in the glibc headers)
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64  d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char d_name[];
+};
+
+
+SlideScanner::SlideScanner(QObject* parent)
+    : QThread(parent)
+{
+    bRecursive      = false;
+    nGeneration     = 0;
+    bRequest        = false;
+    bAbort          = false;
+    bScanning       = false;
+    iWorkGeneration = 0;
+    bWorkRecursive  = false;
+    batchLimit      = FIRST_BATCH_SLIDES;
+}
+
+
+SlideScanner::~SlideScanner() {
+    stop();
+}
+
+
+void
+SlideScanner::stop() {
+    mutex.lock();
+    bAbort = true;
+    workAvailable.wakeAll();
+    mutex.unlock();
+    wait();
+}
+
+
+// Start a new scan (abandoning the current one, if any). Slides of
+// known with an unchanged mtime are not probed again. Returns the
+// generation that will be reported by enumerationDone() and scanDone().
+int
+SlideScanner::scan(QString sDir, bool bRecurse, const SlideTable& known) {
+    QMutexLocker locker(&mutex);
+    rootDir     = QFile::encodeName(sDir);
+    bRecursive  = bRecurse;
+    knownSlides = known;
+    nGeneration++;
+    bRequest  = true;
+    bScanning = true;
+    foundSlides.clear();
+    foundDirs.clear();
+    probedSlides.clear();
+    if(!isRunning())
+        start(QThread::LowPriority);
+    workAvailable.wakeAll();
+    return nGeneration;
+}
+
+
+void
+SlideScanner::cancel() {
+    QMutexLocker locker(&mutex);
+    nGeneration++;
+    bRequest  = false;
+    bScanning = false;
+    foundSlides.clear();
+    foundDirs.clear();
+    probedSlides.clear();
+}
+
+
+bool
+SlideScanner::isScanning() {
+    QMutexLocker locker(&mutex);
+    return bScanning;
+}
+
+
+// The slides (sorted) and the subdirectories found since the last call
+void
+SlideScanner::takeFound(SlideTable* pSlides, QList<QByteArray>* pDirectories) {
+    QMutexLocker locker(&mutex);
+    *pSlides = foundSlides;
+    *pDirectories = foundDirs;
+    foundSlides.clear();
+    foundDirs.clear();
+}
+
+
+// The slides whose headers have been read since the last call
+void
+SlideScanner::takeProbed(SlideTable* pSlides) {
+    QMutexLocker locker(&mutex);
+    *pSlides = probedSlides;
+    probedSlides.clear();
+}
+
+
+bool
+SlideScanner::isSlideName(const char* pName, int nameLength) {
+    const char* pDot = static_cast<const char*>(memrchr(pName, '.', size_t(nameLength)));
+    if(!pDot)
+        return false;
+    return (strcasecmp(pDot, ".jpg")   == 0) ||
+           (strcasecmp(pDot, ".jpeg")  == 0) ||
+           (strcasecmp(pDot, ".png")   == 0) ||
+           (strcasecmp(pDot, ".gif")   == 0) ||
+           (strcasecmp(pDot, ".webp")  == 0) ||
+           (strcasecmp(pDot, ".mjpg")  == 0) ||
+           (strcasecmp(pDot, ".mjpeg") == 0);
+}
+
+
+bool
+SlideScanner::isCurrent() {
+    QMutexLocker locker(&mutex);
+    return !bAbort && (iWorkGeneration == nGeneration);
+}
+
+
+void
+SlideScanner::run() {
+    forever {
+        mutex.lock();
+        while(!bAbort && !bRequest)
+            workAvailable.wait(&mutex);
+        if(bAbort) {
+            mutex.unlock();
+            return;
+        }
+        bRequest = false;
+        iWorkGeneration = nGeneration;
+        workRoot        = rootDir;
+        bWorkRecursive  = bRecursive;
+        workKnown       = knownSlides;
+        knownSlides.clear();
+        mutex.unlock();
+
+        batch.clear();
+        batchDirs.clear();
+        toProbe.clear();
+        batchLimit = FIRST_BATCH_SLIDES;
+        flushClock.start();
+        enumerate();
+        if(!isCurrent())
+            continue;
+        emit enumerationDone(iWorkGeneration);
+        workKnown.clear();
+        probe();
+        mutex.lock();
+        bool bDone = !bAbort && (iWorkGeneration == nGeneration);
+        if(bDone)
+            bScanning = false;
+        mutex.unlock();
+        if(bDone)
+            emit scanDone(iWorkGeneration);
+    }
+}
+
+
+// Breadth first: the slides at the top are delivered first
+void
+SlideScanner::enumerate() {
+    TraceSpan span("enumerateSlides", "index");
+    QList<QByteArray> pending;
+    pending.append(QByteArray());
+    while(!pending.isEmpty()) {
+        if(!isCurrent())
+            return;
+        QList<QByteArray> subdirs;
+        scanDirectory(pending.takeFirst(), &subdirs);
+        pending.append(subdirs);
+    }
+    flushFound(true);
+}
+
+
+void
+SlideScanner::scanDirectory(const QByteArray& prefix, QList<QByteArray>* pSubdirs) {
+    QByteArray path = workRoot;
+    if(!prefix.isEmpty())
+        path += "/" + prefix;
+    int dirFd = open(path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirFd == -1)
+        return;
+    char buffer[DIRENT_BUFFER_SIZE] __attribute__ ((aligned(8)));
+    QByteArray name;
+    forever {
+        long length = syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+        for(long offset=0; offset<length; ) {
+            const LinuxDirent64* pEntry = reinterpret_cast<const LinuxDirent64*>(buffer + offset);
+            offset += pEntry->d_reclen;
+            if(pEntry->d_name[0] == '.')// Hidden files, "." and ".."
+                continue;
+            int nameLength = int(strlen(pEntry->d_name));
+            unsigned char type = pEntry->d_type;
+            struct stat entryStat;
+            if(type == DT_UNKNOWN) {
+                if(fstatat(dirFd, pEntry->d_name, &entryStat, AT_SYMLINK_NOFOLLOW) == -1)
+                    continue;
+                type = S_ISDIR(entryStat.st_mode) ? DT_DIR : DT_REG;
+            }
+            // Symbolic links to directories are not followed (no loops)
+            if(type == DT_DIR) {
+                if(bWorkRecursive) {
+                    name = prefix + QByteArray(pEntry->d_name, nameLength);
+                    pSubdirs->append(name + "/");
+                    batchDirs.append(name);
+                }
+                continue;
+            }
+            if(!isSlideName(pEntry->d_name, nameLength))
+                continue;
+            if((fstatat(dirFd, pEntry->d_name, &entryStat, 0) == -1) || !S_ISREG(entryStat.st_mode))
+                continue;
+            name = prefix + QByteArray(pEntry->d_name, nameLength);
+            SlideRecord info;
+            memset(&info, 0, sizeof(info));
+            info.mtime = qint64(entryStat.st_mtim.tv_sec)*1000 + entryStat.st_mtim.tv_nsec/1000000;
+            int iKnown = workKnown.indexOf(name.constData());
+            if(iKnown != -1) {
+                const SlideRecord& known = workKnown.record(iKnown);
+                if((known.mtime == info.mtime) && (known.flags & SLIDE_RECORD_PROBED)) {
+                    info.width       = known.width;
+                    info.height      = known.height;
+                    info.orientation = known.orientation;
+                    info.flags       = known.flags;
+                }
+            }
+            if(!(info.flags & SLIDE_RECORD_PROBED))
+                toProbe.append(name.constData(), name.size(), info);
+            batch.append(name.constData(), name.size(), info);
+            flushFound(false);
+        }
+    }
+    close(dirFd);
+}
+
+
+// Batches grow geometrically: few slides are delivered at once at
+// the start (the show can begin) and the merges into the index are
+// O(n log n) over the whole scan.
+void
+SlideScanner::flushFound(bool bForce) {
+    bool bFull = (batch.count() >= batchLimit) || (flushClock.elapsed() >= MAX_BATCH_TIME);
+    if(!bForce && !bFull)
+        return;
+    if((batch.count() == 0) && batchDirs.isEmpty())
+        return;
+    batch.sort();
+    bool bNotify;
+    {
+        QMutexLocker locker(&mutex);
+        if(bAbort || (iWorkGeneration != nGeneration))
+            return;
+        bNotify = (foundSlides.count() == 0) && foundDirs.isEmpty();
+        foundSlides.merge(batch);
+        foundDirs.append(batchDirs);
+    }
+    batch.clear();
+    batchDirs.clear();
+    batchLimit = qMin(2*batchLimit, MAX_BATCH_SLIDES);
+    flushClock.restart();
+    if(bNotify)
+        emit slidesFound();
+}
+
+
+// Read the headers of the new (or changed) slides
+void
+SlideScanner::probe() {
+    TraceSpan span("probeSlides", "index");
+    batch.clear();
+    batchLimit = FIRST_BATCH_SLIDES;
+    flushClock.restart();
+    for(int i=0; i<toProbe.count(); i++) {
+        if(!isCurrent())
+            return;
+        SlideRecord info = toProbe.record(i);
+        QImageReader reader(QFile::decodeName(workRoot + "/" + toProbe.name(i)));
+        QSize size = reader.size();
+        if(size.isValid()) {
+            info.width       = quint32(size.width());
+            info.height      = quint32(size.height());
+            info.orientation = quint8(reader.transformation());
+        }
+        info.flags |= SLIDE_RECORD_PROBED;// Even if unreadable: no retries
+        batch.append(toProbe.name(i), info.nameLength, info);
+        flushProbed(false);
+    }
+    flushProbed(true);
+    toProbe.clear();
+}
+
+
+void
+SlideScanner::flushProbed(bool bForce) {
+    bool bFull = (batch.count() >= batchLimit) || (flushClock.elapsed() >= MAX_BATCH_TIME);
+    if((!bForce && !bFull) || (batch.count() == 0))
+        return;
+    bool bNotify;
+    {
+        QMutexLocker locker(&mutex);
+        if(bAbort || (iWorkGeneration != nGeneration))
+            return;
+        bNotify = (probedSlides.count() == 0);
+        for(int i=0; i<batch.count(); i++)
+            probedSlides.append(batch, i);
+    }
+    batch.clear();
+    batchLimit = qMin(2*batchLimit, MAX_BATCH_SLIDES);
+    flushClock.restart();
+    if(bNotify)
+        emit slidesProbed();
+}
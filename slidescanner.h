@@ -0,0 +1,79 @@
+#ifndef SLIDESCANNER_H
+#define SLIDESCANNER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QElapsedTimer>
+
+#include "slidetable.h"
+
+
+// Enumerates a slide directory (and, optionally, its subdirectories)
+// on a worker thread, reading the entries with getdents64() and
+// handing them over in batches while the scan is going on.
+// A first pass only lists the slides (names and mtimes); then the
+// image headers of the slides not already known are read to get
+// their size and orientation.
+class SlideScanner : public QThread
+{
+    Q_OBJECT
+public:
+    SlideScanner(QObject* parent = Q_NULLPTR);
+    ~SlideScanner();
+    int  scan(QString sDir, bool bRecursive, const SlideTable& known);
+    void cancel();
+    void stop();
+    bool isScanning();
+    void takeFound(SlideTable* pSlides, QList<QByteArray>* pDirectories);
+    void takeProbed(SlideTable* pSlides);
+    static bool isSlideName(const char* pName, int nameLength);
+
+signals:
+    void slidesFound();
+    void enumerationDone(int iGeneration);
+    void slidesProbed();
+    void scanDone(int iGeneration);
+
+protected:
+    void run();
+
+private:
+    void enumerate();
+    void probe();
+    void scanDirectory(const QByteArray& prefix, QList<QByteArray>* pSubdirs);
+    void flushFound(bool bForce);
+    void flushProbed(bool bForce);
+    bool isCurrent();
+
+private:
+    QMutex mutex;
+    QWaitCondition workAvailable;
+    // Request (protected by the mutex)
+    QByteArray rootDir;
+    bool bRecursive;
+    SlideTable knownSlides;
+    int  nGeneration;
+    bool bRequest;
+    bool bAbort;
+    bool bScanning;
+    // Results not yet taken (protected by the mutex)
+    SlideTable foundSlides;
+    QList<QByteArray> foundDirs;
+    SlideTable probedSlides;
+    // Worker only
+    int  iWorkGeneration;
+    QByteArray workRoot;
+    bool bWorkRecursive;
+    SlideTable workKnown;
+    SlideTable batch;
+    QList<QByteArray> batchDirs;
+    SlideTable toProbe;
+    int  batchLimit;
+    QElapsedTimer flushClock;
+};
+
+#endif // SLIDESCANNER_H
@@ -0,0 +1,273 @@
+#include "slidetable.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+
+#define TABLE_FILE_MAGIC   "SLDINDEX"
+#define TABLE_FILE_VERSION 1
+
+
+SlideTable::SlideTable() {
+    garbageBytes = 0;
+}
+
+
+void
+SlideTable::clear() {
+    arena.clear();
+    records.clear();
+    garbageBytes = 0;
+}
+
+
+int
+SlideTable::count() const {
+    return records.count();
+}
+
+
+const char*
+SlideTable::name(int i) const {
+    return arena.constData() + records.at(i).nameOffset;
+}
+
+
+const SlideRecord&
+SlideTable::record(int i) const {
+    return records.at(i);
+}
+
+
+SlideRecord&
+SlideTable::record(int i) {
+    return records[i];
+}
+
+
+// Case insensitive (ASCII only) and then byte by byte:
+// the same order of the former QString based index.
+int
+SlideTable::compareNames(const char* pLeft, const char* pRight) {
+    const uchar* pL = reinterpret_cast<const uchar*>(pLeft);
+    const uchar* pR = reinterpret_cast<const uchar*>(pRight);
+    for(; *pL || *pR; pL++, pR++) {
+        int l = ((*pL >= 'A') && (*pL <= 'Z')) ? *pL + ('a'-'A') : *pL;
+        int r = ((*pR >= 'A') && (*pR <= 'Z')) ? *pR + ('a'-'A') : *pR;
+        if(l != r)
+            return l - r;
+    }
+    return strcmp(pLeft, pRight);
+}
+
+
+// Append without keeping the order (see sort())
+void
+SlideTable::append(const char* pName, int nameLength, const SlideRecord& info) {
+    SlideRecord newRecord  = info;
+    newRecord.nameOffset = quint32(arena.size());
+    newRecord.nameLength = quint16(nameLength);
+    arena.append(pName, nameLength);
+    arena.append('\0');
+    records.append(newRecord);
+}
+
+
+void
+SlideTable::append(const SlideTable& other, int i) {
+    append(other.name(i), other.record(i).nameLength, other.record(i));
+}
+
+
+int
+SlideTable::lowerBound(const char* pName) const {
+    const char* pArena = arena.constData();
+    return int(std::lower_bound(records.constBegin(), records.constEnd(), pName,
+                                [pArena](const SlideRecord& left, const char* pRight) {
+                                    return compareNames(pArena + left.nameOffset, pRight) < 0;
+                                }) - records.constBegin());
+}
+
+
+// Position of pName in the (sorted) table or -1 if not present
+int
+SlideTable::indexOf(const char* pName) const {
+    int iPosition = lowerBound(pName);
+    if((iPosition < records.count()) && (strcmp(name(iPosition), pName) == 0))
+        return iPosition;
+    return -1;
+}
+
+
+// Returns false (and updates the record) if pName is already there
+bool
+SlideTable::insert(const char* pName, const SlideRecord& info, int* pPosition) {
+    int iPosition = lowerBound(pName);
+    *pPosition = iPosition;
+    if((iPosition < records.count()) && (strcmp(name(iPosition), pName) == 0)) {
+        SlideRecord& current = records[iPosition];
+        current.mtime       = info.mtime;
+        current.width       = info.width;
+        current.height      = info.height;
+        current.orientation = info.orientation;
+        current.flags       = info.flags;
+        return false;
+    }
+    append(pName, int(strlen(pName)), info);
+    SlideRecord newRecord = records.takeLast();
+    records.insert(iPosition, newRecord);
+    return true;
+}
+
+
+void
+SlideTable::remove(int i) {
+    garbageBytes += records.at(i).nameLength + 1;
+    records.remove(i);
+    if(garbageBytes > arena.size()/2)
+        compact();
+}
+
+
+void
+SlideTable::sort() {
+    const char* pArena = arena.constData();
+    std::stable_sort(records.begin(), records.end(),
+                     [pArena](const SlideRecord& left, const SlideRecord& right) {
+                         return compareNames(pArena + left.nameOffset,
+                                             pArena + right.nameOffset) < 0;
+                     });
+}
+
+
+// Merge the sorted other table into this (sorted) one.
+// Records of other replace those with the same name.
+void
+SlideTable::merge(const SlideTable& other) {
+    if(other.count() == 0)
+        return;
+    quint32 otherBase = quint32(arena.size());
+    arena.append(other.arena);
+    garbageBytes += other.garbageBytes;
+    QVector<SlideRecord> otherRecords = other.records;
+    for(int i=0; i<otherRecords.count(); i++)
+        otherRecords[i].nameOffset += otherBase;
+
+    const char* pArena = arena.constData();
+    QVector<SlideRecord> merged;
+    merged.reserve(records.count() + otherRecords.count());
+    int i = 0;
+    int j = 0;
+    while((i < records.count()) || (j < otherRecords.count())) {
+        int result;
+        if(i == records.count())
+            result = 1;
+        else if(j == otherRecords.count())
+            result = -1;
+        else
+            result = compareNames(pArena + records.at(i).nameOffset,
+                                  pArena + otherRecords.at(j).nameOffset);
+        if(result < 0) {
+            merged.append(records.at(i++));
+        }
+        else {
+            if(result == 0) {// Already known: the newer record wins
+                garbageBytes += records.at(i).nameLength + 1;
+                i++;
+            }
+            merged.append(otherRecords.at(j++));
+        }
+    }
+    records = merged;
+    if(garbageBytes > arena.size()/2)
+        compact();
+}
+
+
+// Drop the names of the removed records
+void
+SlideTable::compact() {
+    QByteArray newArena;
+    newArena.reserve(arena.size() - garbageBytes);
+    for(int i=0; i<records.count(); i++) {
+        SlideRecord& current = records[i];
+        quint32 newOffset = quint32(newArena.size());
+        newArena.append(arena.constData() + current.nameOffset, current.nameLength + 1);
+        current.nameOffset = newOffset;
+    }
+    arena = newArena;
+    garbageBytes = 0;
+}
+
+
+int
+SlideTable::memoryBytes() const {
+    return arena.capacity() + records.capacity()*int(sizeof(SlideRecord));
+}
+
+
+bool
+SlideTable::load(QString sFile) {
+    clear();
+    QFile file(sFile);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray content = file.readAll();
+    TableFileHeader header;
+    if(content.size() < int(sizeof(header)))
+        return false;
+    memcpy(&header, content.constData(), sizeof(header));
+    qint64 expectedSize = qint64(sizeof(header)) +
+                          qint64(header.nRecords)*sizeof(SlideRecord) +
+                          header.arenaSize;
+    if((memcmp(header.magic, TABLE_FILE_MAGIC, sizeof(header.magic)) != 0) ||
+       (header.version    != TABLE_FILE_VERSION) ||
+       (header.recordSize != sizeof(SlideRecord)) ||
+       (expectedSize      != content.size()))
+    {
+        qDebug() << "Discarding the invalid slide index" << sFile;
+        return false;
+    }
+    const char* pData = content.constData() + sizeof(header);
+    records.resize(int(header.nRecords));
+    memcpy(records.data(), pData, header.nRecords*sizeof(SlideRecord));
+    arena = QByteArray(pData + header.nRecords*sizeof(SlideRecord), int(header.arenaSize));
+    // Never trust a name pointing outside the arena
+    for(int i=0; i<records.count(); i++) {
+        const SlideRecord& current = records.at(i);
+        if((qint64(current.nameOffset) + current.nameLength >= arena.size()) ||
+           (arena.at(int(current.nameOffset + current.nameLength)) != '\0'))
+        {
+            qDebug() << "Discarding the corrupted slide index" << sFile;
+            clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool
+SlideTable::save(QString sFile) const {
+    SlideTable packed = *this;
+    if(packed.garbageBytes > 0)
+        packed.compact();
+    TableFileHeader header;
+    memcpy(header.magic, TABLE_FILE_MAGIC, sizeof(header.magic));
+    header.version    = TABLE_FILE_VERSION;
+    header.recordSize = sizeof(SlideRecord);
+    header.nRecords   = quint32(packed.records.count());
+    header.arenaSize  = quint32(packed.arena.size());
+    QSaveFile file(sFile);
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(packed.records.constData()),
+               qint64(packed.records.count())*sizeof(SlideRecord));
+    file.write(packed.arena);
+    return file.commit();
+}
@@ -0,0 +1,68 @@
+#ifndef SLIDETABLE_H
+#define SLIDETABLE_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+
+
+// What is known of a slide file without decoding it
+struct SlideRecord {
+    quint32 nameOffset;// In the name arena
+    quint16 nameLength;
+    quint8  orientation;// QImageIOHandler::Transformations
+    quint8  flags;
+    quint32 width;
+    quint32 height;
+    qint64  mtime;// ms since the epoch
+};
+Q_STATIC_ASSERT(sizeof(SlideRecord) == 24);
+
+#define SLIDE_RECORD_PROBED 0x01 // width, height and orientation are valid
+
+
+// A compact table of slides: the names (paths relative to the
+// slide directory, NUL terminated, as encoded on disk) are packed
+// in a single arena and every slide takes one fixed size record.
+// It is the slide index, the batches of the directory scanner and
+// the on disk image of the index at the same time.
+class SlideTable
+{
+public:
+    SlideTable();
+    void clear();
+    int  count() const;
+    const char* name(int i) const;
+    const SlideRecord& record(int i) const;
+    SlideRecord& record(int i);
+    void append(const char* pName, int nameLength, const SlideRecord& info);
+    void append(const SlideTable& other, int i);
+    int  lowerBound(const char* pName) const;
+    int  indexOf(const char* pName) const;
+    bool insert(const char* pName, const SlideRecord& info, int* pPosition);
+    void remove(int i);
+    void sort();
+    void merge(const SlideTable& other);
+    int  memoryBytes() const;
+    bool load(QString sFile);
+    bool save(QString sFile) const;
+    static int compareNames(const char* pLeft, const char* pRight);
+
+private:
+    void compact();
+
+private:
+    // On disk layout: this header, the records and then the arena
+    struct TableFileHeader {
+        char    magic[8];
+        quint32 version;
+        quint32 recordSize;
+        quint32 nRecords;
+        quint32 arenaSize;
+    };
+    QByteArray arena;
+    QVector<SlideRecord> records;
+    int garbageBytes;// Names of removed records still in the arena
+};
+
+#endif // SLIDETABLE_H
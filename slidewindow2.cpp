@@ -4,67 +4,131 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <iostream>
 
+#include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
-#include <QPainter>
+#include <QFile>
 #include <QTime>
 
-#include "bcm_host.h"
+#include "dispmanxsurface.h"
+#include "rgb565.h"
+#include "framepool.h"
 #include "math.h"
 
 
-#define BUFFER_OFFSET(i) ((char *)NULL + i)
-
 #define STEADY_SHOW_TIME       3000 // Change slide time
 #define TRANSITION_TIME        1500 // Transition duration
-#define UPDATE_TIME              20 // Time between screen updates
-
-
-SlideWindow::SlideWindow()
+#define UPLOAD_BAND_TIME         20 // Time between texture bands uploads
+#define STATS_UPDATE_TIME      5000 // StatsUpdated D-Bus signal period
+#define PREFETCH_HORIZON_TIME 10000 // Playlist show time decoded ahead
+#define ANIMATION_TICK_TIME      10 // Time between checks for due animation frames
+#define UNSYNCED_FRAME_TIME      16 // Frame time without a vsync to wait for (e.g. headless)
+#define MAX_KEN_BURNS_ZOOM     2.0f // Slide textures are this larger than the screen at most
+#define GPU_MEMORY_SHARE       2    // RGBA slides and frame buffers may take 1/2 of the GPU memory
+
+
+// The window takes the ownership of pRenderSurface
+// (Q_NULLPTR: the first dispmanx display)
+SlideWindow::SlideWindow(RenderSurface* pRenderSurface)
     : QObject()
+    , uploadStats(FrameStats::LogScale)
+    , inputStats(FrameStats::LogScale)
 {
     qsrand(QTime::currentTime().msec());
 
-    imageMode   = Qt::KeepAspectRatio;
-    imageFormat = QImage::Format_RGBA8888_Premultiplied;
-    pBaseImage  = Q_NULLPTR;
-
+    pSurface = pRenderSurface ? pRenderSurface : new DispmanxSurface();
+    // eglSwapBuffers() returns at once with no vsync to wait
+    // for: the timers pace the frames instead of spinning
+    frameTime = (pSurface->swapInterval() == 0) ? UNSYNCED_FRAME_TIME : 0;
+    screen_width  = 0;
+    screen_height = 0;
+    slide_width   = 0;
+    slide_height  = 0;
     viewingDistance  = 20.0;
 
-    A      = A0      = QVector4D(0.0, -1.0, 0.0, 1.0);
-    theta  = theta0  = M_PI_2;
-    angle  = angle0  = 0.0f;
-    alpha  = alpha0  = 1.0f;
-    fScale = fScale0 = 1.0f;
-    fRot   = fRot0   = 0.0f;
-
     steadyTime = STEADY_SHOW_TIME;
-    updateTime = UPDATE_TIME;
+    transitionTime = TRANSITION_TIME;
+    currentTransitionTime = transitionTime;
+    lastFrameTime  = -1;
+
+    nUploadBands = 1;
+    iNextBand    = 0;
+    textureRing[0] = textureRing[1] = 0;
+    pTransition    = Q_NULLPTR;
+    pShownAnimation    = &animationRing[0];
+    pIncomingAnimation = &animationRing[1];
+    pShownMotion    = &motionRing[0];
+    pIncomingMotion = &motionRing[1];
+    kenBurnsZoom    = 0.0f;
+    lastMotionFrameTime = -1;
+    bMipmaps        = false;
+    bEtc1Wanted     = false;
+    bEtc1           = false;
+    bRgb565Forced   = false;
+    bRgb565Auto     = true;
+    bRgb565         = false;
+    etc1Encoder.setDiskCache(prefetcher.slideDiskCache());
 
     sSlideDir = QDir::homePath();// Just to set a default location
-    iCurrentSlide = 0;
+    programCache.setDirectory(QDir::homePath()+QString("/.cache/slideshow/programs"));
+    slideIndex.setCacheDirectory(QDir::homePath()+QString("/.cache/slideshow/index"));
+    pSlideIndex = &slideIndex;
+    iCurrentSlide  = 0;
+    iShownSlide    = 0;
+    iIncomingSlide = 0;
 
     bGLInitialized  = false;
     bEglInitialized = false;
     bRunning        = false;
     bSlidesPresent  = false;
+    bPaused         = false;
+    bInputEnabled   = true;
+    inputEventTime  = -1;
 
     timerSteady.setSingleShot(true);
+    timerUpdate.setTimerType(Qt::PreciseTimer);
+    timerMotion.setTimerType(Qt::PreciseTimer);
     connect(&timerUpdate, SIGNAL(timeout()),
             this, SLOT(ontimerUpdateEvent()));
     connect(&timerSteady, SIGNAL(timeout()),
             this, SLOT(onTimerSteadyEvent()));
 
-    connect(&timerCheckInput, SIGNAL(timeout()),
-            this, SLOT(onTimerCheckInput()));
+    connect(&inputDevices, SIGNAL(nextRequested(qint64)),
+            this, SLOT(onNextRequested(qint64)));
+    connect(&inputDevices, SIGNAL(previousRequested(qint64)),
+            this, SLOT(onPreviousRequested(qint64)));
+    connect(&inputDevices, SIGNAL(pauseRequested(qint64)),
+            this, SLOT(onPauseRequested(qint64)));
+    connect(&inputDevices, SIGNAL(jumpRequested(int,qint64)),
+            this, SLOT(onJumpRequested(int,qint64)));
+    connect(&inputDevices, SIGNAL(exitRequested()),
+            this, SLOT(onExitRequested()));
+    connect(&timerUpload, SIGNAL(timeout()),
+            this, SLOT(onTimerUploadEvent()));
+    connect(&timerStats, SIGNAL(timeout()),
+            this, SLOT(onTimerStatsEvent()));
+    connect(&timerAnimation, SIGNAL(timeout()),
+            this, SLOT(onTimerAnimationEvent()));
+    connect(&timerMotion, SIGNAL(timeout()),
+            this, SLOT(onTimerMotionEvent()));
+
+    connect(&slideIndex, SIGNAL(slideInserted(int)),
+            this, SLOT(onSlideInserted(int)));
+    connect(&slideIndex, SIGNAL(slideRemoved(int)),
+            this, SLOT(onSlideRemoved(int)));
+    connect(&slideIndex, SIGNAL(slidesReset()),
+            this, SLOT(onSlidesReset()));
 
 }
 
 
 SlideWindow::~SlideWindow() {
+    stopTrace();
     deinitEgl();
+    delete pSurface;
     qDebug() << "slideshow closed";
 }
 
@@ -73,51 +137,31 @@ void
 SlideWindow::deinitEgl() {
     if(!bEglInitialized)
         return;
-    DISPMANX_UPDATE_HANDLE_T dispman_update;
     // clear screen
     glClear(GL_COLOR_BUFFER_BIT);
-    eglSwapBuffers(display, surface);
-    glDeleteBuffers(1, &arrayBuf);
-    eglDestroySurface(display, surface);
-    dispman_update = vc_dispmanx_update_start(0);
-    vc_dispmanx_element_remove(dispman_update, dispman_element);
-    vc_dispmanx_update_submit_sync(dispman_update);
-    vc_dispmanx_display_close(dispman_display);
+    pSurface->swapBuffers();
+    timerUpload.stop();
+    timerAnimation.stop();
+    timerMotion.stop();
+    animationRing[0].close();
+    animationRing[1].close();
+    etc1Encoder.cancel();
+    inputDevices.close();
+    glDeleteTextures(2, textureRing);
+    compressedTextures.clear();
     // Release OpenGL resources
-    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
-    eglDestroyContext(display, context);
-    eglTerminate(display);
-    bcm_host_deinit();
+    transitions.release();
+    pTransition = Q_NULLPTR;
+    pSurface->close();
     bEglInitialized = false;
     bGLInitialized  = false;
 }
 
 
-void
-SlideWindow::initEglAttributes() {
-    attribute_list.append(EGL_RED_SIZE);
-    attribute_list.append(EGLint(8));
-    attribute_list.append(EGL_GREEN_SIZE);
-    attribute_list.append(EGLint(8));
-    attribute_list.append(EGL_BLUE_SIZE);
-    attribute_list.append(EGLint(8));
-    attribute_list.append(EGL_ALPHA_SIZE);
-    attribute_list.append(EGLint(8));
-    attribute_list.append(EGL_LUMINANCE_SIZE);
-    attribute_list.append(EGLint(EGL_DONT_CARE));
-    attribute_list.append(EGL_SURFACE_TYPE);
-    attribute_list.append(EGLint(EGL_WINDOW_BIT));
-    attribute_list.append(EGLint(EGL_SAMPLES));
-    attribute_list.append(EGLint(1));
-    attribute_list.append(EGL_DEPTH_SIZE);
-    attribute_list.append(EGLint(24));
-    attribute_list.append(EGLint(EGL_NONE));
-}
-
-
 void
 SlideWindow::setSlideDir(QString sNewDir) {
     qDebug() << "setSlideDir(" << sNewDir << ")";
+    emit slideDirSet(sNewDir);
     sSlideDir = sNewDir;
     updateSlideList();
 }
@@ -125,56 +169,505 @@ SlideWindow::setSlideDir(QString sNewDir) {
 
 void
 SlideWindow::updateSlideList() {
-    // Update slide list just in case we are updating the slide directory...
-    slideList = QFileInfoList();
-    QDir slideDir(sSlideDir);
-    if(slideDir.exists()) {
-        QStringList nameFilter = QStringList() << "*.jpg" << "*.jpeg" << "*.png";
-        slideDir.setNameFilters(nameFilter);
-        slideDir.setFilter(QDir::Files);
-        slideList = slideDir.entryInfoList();
+    TraceSpan span("updateSlideList", "slides");
+    // The index of the followed output: kept updated there
+    if(pSlideIndex != &slideIndex) {
+        onSlidesReset();
+        return;
+    }
+    // Already watched: inotify keeps the slide index updated
+    if(slideIndex.isWatching() && (slideIndex.directory() == QDir(sSlideDir).absolutePath()))
+        return;
+    // Returns at once: the directory is scanned in background
+    slideIndex.setDirectory(sSlideDir);
+}
+
+
+// Keep showing the same slides when files are added or
+// removed before the current position in the index
+void
+SlideWindow::onSlideInserted(int iPosition) {
+    if(playlist.isLoaded())
+        return;
+    if((iPosition <= iCurrentSlide) && (pSlideIndex->count() > 1))
+        iCurrentSlide++;
+    bSlidesPresent = pSlideIndex->count() > 0;
+    schedulePrefetch();
+    startWhenSlidesArrive();
+}
+
+
+void
+SlideWindow::onSlideRemoved(int iPosition) {
+    if(playlist.isLoaded())
+        return;
+    if(iPosition < iCurrentSlide)
+        iCurrentSlide--;
+    if(iCurrentSlide >= pSlideIndex->count())
+        iCurrentSlide = 0;
+    bSlidesPresent = pSlideIndex->count() > 0;
+    schedulePrefetch();
+}
+
+
+void
+SlideWindow::onSlidesReset() {
+    if(playlist.isLoaded())
+        return;
+    int iPosition = pSlideIndex->indexOf(sNextSlide);
+    if(iPosition != -1)
+        iCurrentSlide = iPosition;
+    else if(iCurrentSlide >= pSlideIndex->count())
+        iCurrentSlide = 0;
+    bSlidesPresent = pSlideIndex->count() > 0;
+    schedulePrefetch();
+    startWhenSlidesArrive();
+}
+
+
+// The slide index is filled while the directory is scanned:
+// a running show waiting for slides starts with the first ones
+void
+SlideWindow::startWhenSlidesArrive() {
+    if(bRunning && bSlidesPresent && !bGLInitialized && !bPaused)
+        timerSteady.start(0);
+}
+
+
+void
+SlideWindow::setPrefetchDepth(int depth) {
+    prefetcher.setDepth(depth);
+    schedulePrefetch();
+}
+
+
+int
+SlideWindow::prefetchMisses() {
+    return prefetcher.prefetchMisses();
+}
+
+
+FrameStats
+SlideWindow::frameStatistics() {
+    return frameStats;
+}
+
+
+// Split the upload of each new slide in nBands horizontal
+// bands spread over the steady period
+void
+SlideWindow::setUploadBands(int nBands) {
+    nUploadBands = qMax(1, nBands);
+}
+
+
+void
+SlideWindow::setCacheBudget(int megaBytes) {
+    prefetcher.slideCache()->setBudget(qint64(megaBytes)*1024*1024);
+}
+
+
+// Larger slides are decoded in strips to stay below the limit
+void
+SlideWindow::setDecodeMemoryLimit(int megaBytes) {
+    prefetcher.decodePool()->setMemoryLimit(qint64(megaBytes)*1024*1024);
+}
+
+
+int
+SlideWindow::cacheHits() {
+    return prefetcher.slideCache()->hits();
+}
+
+
+int
+SlideWindow::cacheMisses() {
+    return prefetcher.slideCache()->misses();
+}
+
+
+int
+SlideWindow::cacheEvictions() {
+    return prefetcher.slideCache()->evictions();
+}
+
+
+void
+SlideWindow::setDiskCacheDir(QString sDir) {
+    prefetcher.slideDiskCache()->setDirectory(sDir);
+}
+
+
+// The least recently shown slides leave the disk cache first
+void
+SlideWindow::setDiskCacheBudget(int megaBytes) {
+    prefetcher.slideDiskCache()->setBudget(qint64(megaBytes)*1024*1024);
+}
+
+
+// Where the linked shader programs are saved: an empty
+// directory forces the shaders to be compiled at every start
+void
+SlideWindow::setProgramCacheDir(QString sDir) {
+    programCache.setDirectory(sDir);
+}
+
+
+// Where the slide index is saved between runs: an empty
+// directory forces a full scan of the slides at every start
+void
+SlideWindow::setIndexCacheDir(QString sDir) {
+    slideIndex.setCacheDirectory(sDir);
+}
+
+
+void
+SlideWindow::setRecursiveScan(bool bRecursive) {
+    slideIndex.setRecursive(bRecursive);
+}
+
+
+// Show what pLeader shows: the slides of its index (no scan of our
+// own) and its D-Bus and keyboard commands, queued (every output runs
+// in its own thread). Called in the thread of this window, before
+// the leader gets any command.
+void
+SlideWindow::follow(SlideWindow* pLeader) {
+    pSlideIndex = pLeader->pSlideIndex;
+    connect(pSlideIndex, SIGNAL(slideInserted(int)),
+            this, SLOT(onSlideInserted(int)), Qt::QueuedConnection);
+    connect(pSlideIndex, SIGNAL(slideRemoved(int)),
+            this, SLOT(onSlideRemoved(int)), Qt::QueuedConnection);
+    connect(pSlideIndex, SIGNAL(slidesReset()),
+            this, SLOT(onSlidesReset()), Qt::QueuedConnection);
+
+    connect(pLeader, SIGNAL(slideDirSet(QString)),
+            this, SLOT(setSlideDir(QString)), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(slideShowStarted()),
+            this, SLOT(startSlideShow()), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(slideShowStopped()),
+            this, SLOT(stopSlideShow()), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(nextSlideRequested()),
+            this, SLOT(nextSlide()), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(previousSlideRequested()),
+            this, SLOT(previousSlide()), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(slideJumpRequested(int)),
+            this, SLOT(jumpToSlide(int)), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(slideShowPaused()),
+            this, SLOT(pauseSlideShow()), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(slideShowResumed()),
+            this, SLOT(resumeSlideShow()), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(playlistLoaded(QString)),
+            this, SLOT(loadPlaylist(QString)), Qt::QueuedConnection);
+    connect(pLeader, SIGNAL(playlistCleared()),
+            this, SLOT(clearPlaylist()), Qt::QueuedConnection);
+}
+
+
+// Only one output of the process should grab the keyboards
+void
+SlideWindow::setInputEnabled(bool bEnabled) {
+    bInputEnabled = bEnabled;
+    if(!bEnabled)
+        inputDevices.close();
+}
+
+
+// Slowly pan and zoom (up to maxZoom times) across every slide.
+// The slides are then prepared larger than the screen, by maxZoom,
+// so it must be set before the show starts (0: no Ken Burns).
+void
+SlideWindow::setKenBurns(float maxZoom) {
+    kenBurnsZoom = (maxZoom > 1.0f) ? qMin(maxZoom, MAX_KEN_BURNS_ZOOM) : 0.0f;
+}
+
+
+// Upload the still slides ETC1 compressed (if the GPU can): 1/8 of
+// the bytes to upload and to keep in GPU memory. Must be set before
+// the show starts.
+void
+SlideWindow::setCompressedTextures(bool bEnabled) {
+    bEtc1Wanted = bEnabled;
+}
+
+
+// "rgba", "rgb565" (half the upload time and GPU memory, dithered)
+// or "auto": RGB565 only if RGBA slides would not fit comfortably in
+// the GPU memory. Must be set before the show starts.
+bool
+SlideWindow::setTextureFormat(QString sFormat) {
+    if(sFormat == QString("rgba")) {
+        bRgb565Forced = false;
+        bRgb565Auto   = false;
+    }
+    else if(sFormat == QString("rgb565")) {
+        bRgb565Forced = true;
+        bRgb565Auto   = false;
     }
-    if(slideList.count() > 0) {
-        bSlidesPresent = true;
+    else if(sFormat == QString("auto")) {
+        bRgb565Forced = false;
+        bRgb565Auto   = true;
+    }
+    else {
+        qDebug() << "Unknown texture format" << sFormat;
+        return false;
     }
+    return true;
+}
+
+
+static QVariantMap
+latencyStats(FrameStats* pStats) {
+    QVariantMap stats;
+    stats.insert("count", pStats->frames());
+    stats.insert("minUs", pStats->minimum());
+    stats.insert("avgUs", pStats->average());
+    stats.insert("p50Us", pStats->percentile(0.50));
+    stats.insert("p99Us", pStats->percentile(0.99));
+    stats.insert("maxUs", pStats->maximum());
+    return stats;
+}
+
+
+// Runtime statistics for the D-Bus clients. The counters are
+// updated lock free by the render loop and the prefetcher.
+QVariantMap
+SlideWindow::GetStats() {
+    QVariantMap stats;
+    QVariantMap frames = latencyStats(&frameStats);
+    frames.insert("late", frameStats.lateFrames());
+    frames.insert("bucketUs", FrameStats::bucketWidth());
+    QVariantList histogram;
+    QVector<int> counts = frameStats.histogram();
+    for(int i=0; i<counts.count(); i++)
+        histogram.append(counts.at(i));
+    frames.insert("histogram", histogram);
+    stats.insert("frames", frames);
+    stats.insert("transitions", nTransitions.loadAcquire());
+    stats.insert("decode", latencyStats(prefetcher.decodeStatistics()));
+    stats.insert("decodedFiles", prefetcher.decodePool()->decodedFiles());
+    stats.insert("composedFrames", prefetcher.decodePool()->composedFrames());
+    stats.insert("upload", latencyStats(&uploadStats));
+    stats.insert("animationFrames", animationRing[0].decodedFrames()+animationRing[1].decodedFrames());
+    stats.insert("animationLateFrames", animationRing[0].lateFrames()+animationRing[1].lateFrames());
+    stats.insert("etc1", latencyStats(etc1Encoder.encodeStatistics()));
+    stats.insert("etc1Slides", etc1Encoder.encodedSlides());
+    stats.insert("etc1Rejected", etc1Encoder.rejectedSlides());
+    stats.insert("input", latencyStats(&inputStats));
+    stats.insert("paused", bPaused);
+    stats.insert("prefetchMisses", prefetcher.prefetchMisses());
+    stats.insert("cacheHits", prefetcher.slideCache()->hits());
+    stats.insert("cacheMisses", prefetcher.slideCache()->misses());
+    stats.insert("cacheBytes", prefetcher.slideCache()->bytes());
+    stats.insert("framePoolAllocations", FramePool::instance()->allocations());
+    stats.insert("framePoolReuses", FramePool::instance()->reuses());
+    stats.insert("framePoolBytes", FramePool::instance()->usedBytes()+FramePool::instance()->freeBytes());
+    stats.insert("slides", slideCount());
+    stats.insert("playlist", playlist.fileName());
+    stats.insert("indexBytes", pSlideIndex->memoryBytes());
+    stats.insert("indexing", pSlideIndex->isScanning());
+    stats.insert("running", bRunning);
+
+    // Resident set size from /proc (second field, in pages)
+    qint64 residentBytes = 0;
+    QFile statm("/proc/self/statm");
+    if(statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if(fields.count() > 1)
+            residentBytes = fields.at(1).toLongLong()*sysconf(_SC_PAGESIZE);
+    }
+    stats.insert("residentBytes", residentBytes);
+    // Two slide textures (with their mipmaps, 4 bits per pixel if ETC1
+    // compressed, 16 if RGB565), double buffered color and 24 bit depth
+    // (padded to 32) buffers and the transition meshes
+    qint64 gpuBytes = 0;
+    if(bGLInitialized) {
+        qint64 screenPixels = qint64(screen_width)*screen_height;
+        gpuBytes = (2*4+4)*screenPixels + transitions.vertexBytes();
+        for(int i=0; i<2; i++) {
+            qint64 textureBytes = qint64(slide_width)*slide_height;
+            if(compressedTextures.contains(textureRing[i]))
+                textureBytes /= 2;
+            else
+                textureBytes *= bRgb565 ? 2 : 4;
+            if(bMipmaps)
+                textureBytes += textureBytes/3;
+            gpuBytes += textureBytes;
+        }
+    }
+    stats.insert("gpuBytesEstimate", gpuBytes);
+    stats.insert("textureFormat", bRgb565 ? "rgb565" : "rgba");
+    return stats;
+}
+
+
+// Start recording a timeline of the rendering, decoding and upload
+// spans: it will be written to sFile by stopTrace()
+void
+SlideWindow::startTrace(QString sFile) {
+    if(Tracer::isEnabled())
+        stopTrace();
+    sTraceFile = sFile;
+    Tracer::start();
+    qDebug() << "Tracing to" << sTraceFile;
+}
+
+
+void
+SlideWindow::stopTrace() {
+    if(!Tracer::isEnabled() || sTraceFile.isEmpty())
+        return;
+    Tracer::stop();
+    Tracer::save(sTraceFile);
+}
+
+
+void
+SlideWindow::onTimerStatsEvent() {
+    emit StatsUpdated(GetStats());
+}
+
+
+// Tell the prefetcher which slides will be shown next
+void
+SlideWindow::schedulePrefetch() {
+    int nSlides = slideCount();
+    if(nSlides == 0)
+        return;
+    if(!playlist.isLoaded())
+        sNextSlide = pSlideIndex->fileName(iCurrentSlide);
+    if(!bEglInitialized)
+        return;
+    QStringList sUpcoming;
+    int nDepth  = qMin(prefetcher.depth(), nSlides);
+    // The playlist tells how long the next slides will stay:
+    // when they are short more of them are decoded ahead
+    if(playlist.isLoaded()) {
+        int nMaxDepth = qMin(2*prefetcher.depth(), nSlides);
+        int showTime  = 0;
+        for(int i=0; i<nDepth; i++)
+            showTime += slideDuration((iCurrentSlide+i) % nSlides);
+        while((nDepth < nMaxDepth) && (showTime < PREFETCH_HORIZON_TIME))
+            showTime += slideDuration((iCurrentSlide+nDepth++) % nSlides);
+    }
+    for(int i=0; i<nDepth; i++)
+        sUpcoming.append(slidePath((iCurrentSlide+i) % nSlides));
+    prefetcher.schedule(sUpcoming);
+}
+
+
+// The slides come from the playlist, if loaded,
+// or else from the slide directory
+int
+SlideWindow::slideCount() {
+    return playlist.isLoaded() ? playlist.count() : pSlideIndex->count();
+}
+
+
+QString
+SlideWindow::slidePath(int iSlide) {
+    return playlist.isLoaded() ? playlist.filePath(iSlide) : pSlideIndex->filePath(iSlide);
+}
+
+
+// How long (ms) the slide is shown before the next transition
+int
+SlideWindow::slideDuration(int iSlide) {
+    if(playlist.isLoaded() && (iSlide < playlist.count()) && (playlist.duration(iSlide) > 0))
+        return playlist.duration(iSlide);
+    return steadyTime;
+}
+
+
+// Show the slides of a playlist instead of those of the slide
+// directory. The GL state is kept: only the slide textures are
+// refilled, starting from the first entry.
+bool
+SlideWindow::loadPlaylist(QString sFile) {
+    TraceSpan span("loadPlaylist", "slides");
+    emit playlistLoaded(sFile);
+    if(!playlist.load(sFile)) {
+        qDebug() << playlist.errorString();
+        return false;
+    }
+    qDebug() << "Playlist" << playlist.fileName() << "slides" << playlist.count();
+    restartSlides();
+    return true;
+}
+
+
+// Back to the slide directory
+void
+SlideWindow::clearPlaylist() {
+    emit playlistCleared();
+    if(!playlist.isLoaded())
+        return;
+    playlist.close();
+    updateSlideList();
+    restartSlides();
+}
+
+
+void
+SlideWindow::restartSlides() {
+    iCurrentSlide  = 0;
+    bSlidesPresent = slideCount() > 0;
+    if(bGLInitialized && bSlidesPresent) {
+        showSlide(0);
+        return;
+    }
+    schedulePrefetch();
+    startWhenSlidesArrive();
 }
 
 
 void
 SlideWindow::startSlideShow() {
+    emit slideShowStarted();
     initEgl();
-    updateSlideList();
+    prefetcher.setScreenSize(slide_width, slide_height);
+    if(!playlist.isLoaded())
+        updateSlideList();
     if(bSlidesPresent) {
         if(!initializeGL()) {
             qDebug() << "GL not initialized: Could not start";
             deinitEgl();
             return;
         }
-        initInputDevices();
-        if((keyboardFd != -1) || (mouseFd != -1)) {
-            timerCheckInput.start(200);
-        }
         qDebug() << "SlideShow starting";
         paintGL();
     }
-    timerSteady.start(steadyTime);
+    if(!bPaused)
+        timerSteady.start(slideDuration(iShownSlide));
+    timerStats.start(STATS_UPDATE_TIME);
     bRunning = true;
 }
 
 
+// Through the event loop of the application: the other outputs
+// are stopped (MyApp::~MyApp()) before the decode pool is gone
 void
 SlideWindow::exitShow() {
-    exit(EXIT_SUCCESS);
+    stopTrace();
+    QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
 }
 
 
 void
 SlideWindow::stopSlideShow() {
+    emit slideShowStopped();
     timerSteady.stop();
     timerUpdate.stop();
+    timerUpload.stop();
+    timerStats.stop();
     deinitEgl();
-    releaseInputDevices();
+    inputDevices.close();
     bRunning = false;
+    qDebug() << "Frames" << frameStats.frames()
+             << "min" << frameStats.minimum()
+             << "avg" << frameStats.average()
+             << "p99" << frameStats.percentile(0.99) << "us"
+             << "late" << frameStats.lateFrames();
 }
 
 
@@ -185,295 +678,163 @@ SlideWindow::isRunning() {
 
 
 void
-SlideWindow::releaseInputDevices() {
-    if(keyboardFd != -1)
-        close(keyboardFd);
-    if(mouseFd != -1)
-        close(mouseFd);
-}
-
-
-void
-SlideWindow::initInputDevices() {
-    mouseFd    = -1;
-    keyboardFd = -1;
-    int result;
-
-    QString sFileDir = QString("/dev/input/by-id");
-    QDir sDir(sFileDir);
-    QList<QFileInfo> fileList;
-    QStringList nameFilter;
-    if(sDir.exists()) {
-        nameFilter << "*event-kbd*";
-        sDir.setNameFilters(nameFilter);
-        sDir.setFilter(QDir::Files);
-        fileList = sDir.entryInfoList();
-        if(fileList.count() == 0) {
-            qDebug() << "No keyboard found";
-            return;
-        }
-    }
-    else {
-        qDebug() << sFileDir << "Not Found";
+SlideWindow::initEgl() {
+    // No need to reinitialize...
+    if(bEglInitialized)
         return;
-    }
-    for(int i=0; i<fileList.count(); i++) {
-        keyboardFd = open(fileList.at(i).absoluteFilePath().toLocal8Bit().constData(), O_RDONLY | O_NONBLOCK);
-        result = ioctl(keyboardFd, EVIOCGRAB, 1);
-//        qDebug() << "keyboardFd=" << keyboardFd << ((result == 0) ? "SUCCESS" : "FAILURE") << "in getting exclusive access";
-        if(result)
-            break;
-    }
-/*
-    fileList.clear();
-    nameFilter.clear();
-    nameFilter << "*event-mouse*";
-    sDir.setNameFilters(nameFilter);
-    sDir.setFilter(QDir::Files);
-    fileList = sDir.entryInfoList();
-    if(fileList.count() == 0) {
-        qDebug() << "No mouse found";
+    if(!pSurface->open()) {
+        emit closing(pSurface->errorString());
         return;
     }
-    for(int i=0; i<fileList.count(); i++) {
-        mouseFd = open(fileList.at(i).absoluteFilePath().toLocal8Bit().constData(), O_RDONLY | O_NONBLOCK);
-        result = ioctl(mouseFd, EVIOCGRAB, 1);
-        qDebug() << "mouseFd=" << mouseFd << ((result == 0) ? "SUCCESS" : "FAILURE") << "in getting exclusive access";
-        if(result)
-            break;
+    screen_width  = uint32_t(pSurface->width());
+    screen_height = uint32_t(pSurface->height());
+    // Ken Burns zooms into slides larger than the screen:
+    // at the maximum zoom a texel still maps to a pixel
+    float oversize = qMax(1.0f, kenBurnsZoom);
+    slide_width  = uint32_t(qRound(oversize*screen_width));
+    slide_height = uint32_t(qRound(oversize*screen_height));
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if((maxSize > 0) && ((slide_width > uint32_t(maxSize)) || (slide_height > uint32_t(maxSize)))) {
+        float fit = qMin(float(maxSize)/slide_width, float(maxSize)/slide_height);
+        slide_width  = uint32_t(fit*slide_width);
+        slide_height = uint32_t(fit*slide_height);
     }
-*/
+    bEglInitialized = true;
+    bGLInitialized  = false;
 }
 
 
-// Read a file and return its contents in a character string
-char*
-SlideWindow::ReadFile(QString url) {
-    //open the file for reading
-    QFile file(url);
-    if(!file.open(QIODevice::ReadOnly)) {
-        emit closing(QString("Unable to open file: %1").arg(url));
-        return Q_NULLPTR;
-    }
-    // Get the file size
-    long lSize=file.size();
-    //lets allocate the memory for the file
-    char *buffer = (char *) calloc(1, lSize+1);
-    if(!buffer) {
-        file.close();
-        free(buffer);
-        emit closing(QString("Unable to allocate memory for file buffer"));
-        return Q_NULLPTR;
-    }
-    //lets copy the data into the buffer
-    if(file.read(buffer, lSize) != lSize) {
-        file.close();
-        free(buffer);
-        emit closing(QString("Error reading from file: %1").arg(url));
-        return Q_NULLPTR;
-    }
-    file.close();
-    return buffer;
+// Keyboard commands: the first frame shown after a key
+// press gives the keystroke to photon latency.
+void
+SlideWindow::onNextRequested(qint64 eventTimeUs) {
+    inputEventTime = eventTimeUs;
+    nextSlide();
 }
 
 
 void
-SlideWindow::initEgl() {
-    // No need to reinitialize...
-    if(bEglInitialized)
-        return;
-    int32_t success = 0;
+SlideWindow::onPreviousRequested(qint64 eventTimeUs) {
+    inputEventTime = eventTimeUs;
+    previousSlide();
+}
 
-    bcm_host_init();
-    initEglAttributes();
 
-    // Let's find the max display size
-    success = graphics_get_display_size(0,// Display number
-                                        &screen_width,
-                                        &screen_height);
-    if(success < 0) {
-        emit closing("Error in graphics_get_display_size()");
-        return;
-    }
+void
+SlideWindow::onJumpRequested(int iSlide, qint64 eventTimeUs) {
+    inputEventTime = eventTimeUs;
+    jumpToSlide(iSlide);
+}
 
-    // get an EGL display connection
-    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-    if(display == EGL_NO_DISPLAY) {
-        emit closing("Error in eglGetDisplay()");
-        return;
-    }
 
-    // initialize the EGL display connection
-    int major, minor;
-    EGLBoolean result;
-    result = eglInitialize(display, &major, &minor);
-    if(EGL_FALSE == result) {
-        emit closing("Error in eglInitialize()");
-        return;
-    }
-//    qDebug() << "EGL version" << major << ":" << minor;
-
-    // get an appropriate EGL frame buffer configuration
-    EGLConfig config;
-    EGLint num_config;
-    result = eglChooseConfig(display,
-                             attribute_list.constData(),
-                             &config,
-                             1,
-                             &num_config);
-    if(result == EGL_FALSE) {
-        emit closing("Error in eglChooseConfig()");
-        return;
-    }
+void
+SlideWindow::onPauseRequested(qint64 eventTimeUs) {
+    Q_UNUSED(eventTimeUs)
+    if(bPaused)
+        resumeSlideShow();
+    else
+        pauseSlideShow();
+}
 
-    // bind the OpenGL API to the EGL
-    result = eglBindAPI(EGL_OPENGL_ES_API);
-    if(result == EGL_FALSE) 	{
-        emit closing("Error binding API");
-        return;
-    }
 
-    // create an EGL rendering context
-    //This seems important for using ES2
-    static const EGLint context_attributes[] =
-    {
-        EGL_CONTEXT_CLIENT_VERSION, 2,
-        EGL_NONE
-    };
-    context = eglCreateContext(display,
-                               config,
-                               EGL_NO_CONTEXT,
-                               context_attributes);
-    if(context == EGL_NO_CONTEXT) {
-        emit closing("Error in eglCreateContext()");
-        return;
-    }
+void
+SlideWindow::onExitRequested() {
+    emit closing("Esc pressed");
+    stopSlideShow();
+    exitShow();
+}
+
 
-    VC_RECT_T dst_rect;
-    dst_rect.x      = 0;
-    dst_rect.y      = 0;
-    dst_rect.width  = screen_width;
-    dst_rect.height = screen_height;
-
-    VC_RECT_T src_rect;
-    src_rect.x      = 0;
-    src_rect.y      = 0;
-    src_rect.width  = screen_width << 16;
-    src_rect.height = screen_height << 16;
-
-    // open our display with 0 being the first display,
-    // there are also some other versions of this function
-    // where we can pass in a mode however the mode is not
-    // documented as far as I can see
-    dispman_display = vc_dispmanx_display_open(0);// LCD
-    // now we signal to the video core we are going to start
-    // updating the config
-    dispman_update  = vc_dispmanx_update_start(0);
-
-    // this is the main setup function where we add an element
-    // to the display, this is filled in to the src / dst rectangles
-    dispman_element = vc_dispmanx_element_add(dispman_update,
-                                              dispman_display,
-                                              0, // layer
-                                              &dst_rect,
-                                              0, // src
-                                              &src_rect,
-                                              DISPMANX_PROTECTION_NONE,
-                                              0, // alpha
-                                              0, // clamp
-                                              DISPMANX_TRANSFORM_T(0));// transform
-
-    // having created this element we pass it to the native window
-    // structure ready to create our new EGL surface
-    nativewindow.element = dispman_element;
-    nativewindow.width   = screen_width;
-    nativewindow.height  = screen_height;
-    // we now tell the vc we have finished our update
-    vc_dispmanx_update_submit_sync(dispman_update);
-
-    // finally we can create a new surface using this config and window
-    surface = eglCreateWindowSurface(display, config, &nativewindow, NULL);
-    if(surface == EGL_NO_SURFACE) {
-        emit closing("Error in eglCreateWindowSurface()");
+// The next slide is already in texture1: it is shown at once
+void
+SlideWindow::nextSlide() {
+    emit nextSlideRequested();
+    if(!bGLInitialized || !bSlidesPresent)
         return;
-    }
+    timerSteady.stop();
+    finishUpload(false);
+    prepareNextRound(true);
+}
+
+
+// texture0 shows the slide at iCurrentSlide-2 (texture1 holds the next one)
+void
+SlideWindow::previousSlide() {
+    emit previousSlideRequested();
+    showSlide(iCurrentSlide-3);
+}
+
+
+void
+SlideWindow::jumpToSlide(int iSlide) {
+    emit slideJumpRequested(iSlide);
+    showSlide(iSlide);
+}
 
-    // connect the context to the surface
-    result = eglMakeCurrent(display, surface, surface, context);
-    if(EGL_FALSE == result) {
-        emit closing("Error in eglMakeCurrent()");
+
+void
+SlideWindow::showSlide(int iSlide) {
+    if(!bGLInitialized || !bSlidesPresent)
         return;
-    }
-    bEglInitialized = true;
-    bGLInitialized  = false;
+    int nSlides = slideCount();
+    timerSteady.stop();
+    timerUpdate.stop();
+    timerUpload.stop();
+    iCurrentSlide = ((iSlide % nSlides) + nSlides) % nSlides;
+    // Prefetched (or cached) slides are ready at once
+    if(!prepareNextSlide())
+        return;
+    uploadSlide(texture0);
+    qSwap(pShownAnimation, pIncomingAnimation);
+    qSwap(pShownMotion, pIncomingMotion);
+    if(pShownAnimation->isOpen())
+        pShownAnimation->play(InputDevices::monotonicTimeUs());
+    startMotion(pShownMotion, iIncomingSlide);
+    pTransition->begin();
+    paintGL();
+    // Then the following one, as in prepareNextRound()
+    if(!prepareNextSlide())
+        return;
+    chooseTransition();
+    iNextBand = 0;
+    // A slide being compressed is uploaded when ready
+    if((nUploadBands > 1) || etc1Encoder.isPending())
+        timerUpload.start(UPLOAD_BAND_TIME);
+    else
+        finishUpload(true);
+    if(!bPaused)
+        timerSteady.start(slideDuration(iShownSlide));
+    updateMotionTimer();
 }
 
 
+// Stop changing slides (a running transition is completed)
 void
-SlideWindow::onTimerCheckInput() {
-    if(mouseFd != -1) {// Read events from mouse
-        rd = read(mouseFd, ev, sizeof(ev));
-        if(rd > 0) {
-            int count,n;
-            struct input_event *evp;
-            count = rd / sizeof(struct input_event);
-            n = 0;
-            while(count--) {
-                evp = &ev[n++];
-                if(evp->type == 1) {
-                    if(evp->code == BTN_LEFT) {
-                        if(evp->value == 1) {// Press
-                            printf("Left button pressed\n");
-                        }
-                        else {
-                            printf("Left button released\n");
-                        }
-                    }
-                }
-                if(evp->type == 2) {
-                    if(evp->code == 0) {
-                        // Mouse Left/Right
-                        printf("Mouse moved left/right %d\n",evp->value);
-                    }
-                    if(evp->code == 1) {
-                        // Mouse Up/Down
-                        printf("Mouse moved up/down %d\n",evp->value);
-                    }
-                }
-            }
-        }
-    }
+SlideWindow::pauseSlideShow() {
+    emit slideShowPaused();
+    bPaused = true;
+    timerSteady.stop();
+}
 
-    // evp->value = 0(Released), 1(Pressed), 2(Autorepeat Keypress)
-    if(keyboardFd != -1) {// Read events from keyboard
-        rd = read(keyboardFd, ev, sizeof(ev));
-        if(rd > 0) {
-            struct input_event *evp;
-            int count = rd / sizeof(struct input_event);
-            int n = 0;
-            while(count--) {
-                evp = &ev[n++];
-                if(evp->type == EV_KEY) {
-                    if(evp->value == 1) {
-                        if((evp->code == KEY_ESC)) {
-                            emit closing("Esc pressed");
-                            exit(EXIT_SUCCESS);
-                        }
-                        if(evp->code == KEY_SPACE) {
-                            timerUpdate.stop();
-                            qDebug() << A << theta << angle;
-                        }
-                    }// if(evp->value == 1)
-                }// if(evp->type == EV_KEY)
-            }
-        }
-    }
+
+void
+SlideWindow::resumeSlideShow() {
+    emit slideShowResumed();
+    bPaused = false;
+    if(bRunning && !timerUpdate.isActive())
+        timerSteady.start(slideDuration(iShownSlide));
 }
 
 
 void
 SlideWindow::onTimerSteadyEvent() {
-    updateSlideList();
+    if(bPaused)
+        return;
+    // Without an inotify watch (e.g. the directory
+    // does not exist yet) we have to look again
+    if(!playlist.isLoaded() && (pSlideIndex == &slideIndex) && !slideIndex.isWatching())
+        updateSlideList();
     if(!bSlidesPresent) {// Still no slides !
         timerSteady.start(steadyTime);
         return;
@@ -487,273 +848,422 @@ SlideWindow::onTimerSteadyEvent() {
             return;
         }
     }
-    timerUpdate.start(updateTime);
-    t0 = 0.0;
+    // The incoming slide must be complete
+    finishUpload(true);
+    // An animated incoming slide plays during the transition
+    if(pIncomingAnimation->isOpen())
+        pIncomingAnimation->play(InputDevices::monotonicTimeUs());
+    startMotion(pIncomingMotion, iIncomingSlide);
+    // Frames are rendered back to back: eglSwapBuffers()
+    // blocks until the next vsync (if any, or else frameTime)
+    lastFrameTime = -1;
+    transitionClock.start();
+    timerUpdate.start(frameTime);
+    updateMotionTimer();
 }
 
 
 void
 SlideWindow::ontimerUpdateEvent() {
-    if(animationType == 0) {
-        A += QVector4D(0.0, -0.02, 0.0, 0.0);
-        if(theta > 0.2)
-            theta -= 0.04;
-        else if(angle < M_PI_2)
-            angle+= 0.15;
-        if(A.y() < -1.88) {
-            prepareNextRound();
-        }
+    qint64 now = transitionClock.nsecsElapsed()/1000;
+    if(lastFrameTime >= 0)
+        frameStats.addFrame(now-lastFrameTime);
+    lastFrameTime = now;
+    GLfloat progress = GLfloat(now)/GLfloat(1000*currentTransitionTime);
+    if(progress >= 1.0f) {
+        nTransitions.fetchAndAddRelaxed(1);
+        prepareNextRound();
     }
-    else if(animationType == 1) {
-        alpha -= 0.02;
-        if(alpha < 0.0) {
-            prepareNextRound();
-        }
+    else
+        pTransition->update(progress);
+    paintGL();
+}
+
+
+// The transition to the incoming slide: the one of its playlist
+// entry, if any (and known), or else one picked at random
+void
+SlideWindow::chooseTransition() {
+    pTransition = Q_NULLPTR;
+    currentTransitionTime = transitionTime;
+    if(playlist.isLoaded() && (iIncomingSlide < playlist.count())) {
+        pTransition = transitions.find(playlist.transitionName(iIncomingSlide));
+        if(playlist.transitionTime(iIncomingSlide) > 0)
+            currentTransitionTime = playlist.transitionTime(iIncomingSlide);
     }
-    else if(animationType == 2) {
-        fScale -= 0.02;
-        if(fScale <= 0.0) {
-            prepareNextRound();
-        }
+    if(!pTransition)
+        pTransition = transitions.at(qrand() % transitions.count());
+    pTransition->begin();
+}
+
+
+// With bShowNow the incoming slide is drawn before
+// preparing the next one (used to skip a transition)
+bool
+SlideWindow::prepareNextRound(bool bShowNow) {
+    timerUpdate.stop();
+
+    // The outgoing slide texture will receive the next slide
+    GLuint freeTexture = texture0;
+    texture0 = texture1;
+    texture1 = freeTexture;
+    // The animations and the motions follow their textures
+    qSwap(pShownAnimation, pIncomingAnimation);
+    qSwap(pShownMotion, pIncomingMotion);
+    if(pShownAnimation->isOpen() && !pShownAnimation->isPlaying())
+        pShownAnimation->play(InputDevices::monotonicTimeUs());
+    if(!pShownMotion->isActive())// The transition has been skipped
+        startMotion(pShownMotion, iIncomingSlide);
+    pTransition->begin();
+    if(bShowNow)
+        paintGL();
+    if(!prepareNextSlide())
+        return false;
+    chooseTransition();
+    iNextBand = 0;
+    // A slide being compressed is uploaded when ready
+    if((nUploadBands > 1) || etc1Encoder.isPending())
+        timerUpload.start(UPLOAD_BAND_TIME);
+    else
+        finishUpload(true);
+
+    if(!bPaused)
+        timerSteady.start(slideDuration(iShownSlide));
+    updateMotionTimer();
+    return true;
+}
+
+
+// Replace nRows rows of the texture content starting from firstRow
+// with the ones of the current slide frame.
+void
+SlideWindow::uploadRows(GLuint texture, int firstRow, int nRows) {
+    uploadFrameRows(texture, baseImage, firstRow, nRows);
+}
+
+
+// The whole current slide, shown at once: compressed only if
+// the encoder has already accepted it (no waiting for it)
+void
+SlideWindow::uploadSlide(GLuint texture) {
+    Etc1Texture compressed;
+    if(etc1Encoder.takeReadyTexture(&compressed)) {
+        uploadCompressed(texture, compressed);
+        return;
     }
-    else if(animationType == 3) {
-            fScale -= 0.02;
-            if(fScale <= 0.0) {
-                prepareNextRound();
-            }
+    uploadRows(texture, 0, baseImage.height());
+    completeTexture(texture);
+}
+
+
+// All the levels at once: ETC1 textures can only be replaced whole
+void
+SlideWindow::uploadCompressed(GLuint texture, const Etc1Texture& compressed) {
+    TraceSpan span("uploadCompressed", "upload");
+    QElapsedTimer uploadTimer;
+    uploadTimer.start();
+    glBindTexture(GL_TEXTURE_2D, texture);
+    int width  = compressed.width;
+    int height = compressed.height;
+    for(int i=0; i<compressed.levels.count(); i++) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_ETC1_RGB8_OES, width, height, 0,
+                               compressed.levels.at(i).size(), compressed.levels.at(i).constData());
+        width  = qMax(1, width/2);
+        height = qMax(1, height/2);
     }
-    else if(animationType == 4) {
-            fRot += 2.0;
-            if(fRot > 90.0) {
-                prepareNextRound();
-            }
+    compressedTextures.insert(texture);
+    uploadStats.addFrame(uploadTimer.nsecsElapsed()/1000);
+}
+
+
+void
+SlideWindow::uploadFrameRows(GLuint texture, const QImage& frame, int firstRow, int nRows) {
+    TraceSpan span("uploadRows", "upload");
+    QElapsedTimer uploadTimer;
+    uploadTimer.start();
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Compressed textures can not be updated: back to plain storage
+    if(compressedTextures.remove(texture))
+        allocateTexture();
+    if(bRgb565) {
+        // Dithered by absolute row: bands join seamlessly
+        rgb565Rows.resize(frame.width()*nRows);
+        for(int y=0; y<nRows; y++)
+            rgb565Row(frame.constScanLine(firstRow+y), rgb565Rows.data()+y*frame.width(),
+                      frame.width(), firstRow+y);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, frame.width(), nRows,
+                        GL_RGB, GL_UNSIGNED_SHORT_5_6_5, rgb565Rows.constData());
     }
-    else if(animationType == 5) {
-            t0 += updateTime/1000.0;
-            fRot += 2.0;
-            if(fRot > 90.0) {
-                prepareNextRound();
-            }
+    else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, frame.width(), nRows,
+                        GL_RGBA, GL_UNSIGNED_BYTE, frame.constScanLine(firstRow));
     }
-    paintGL();
+    uploadStats.addFrame(uploadTimer.nsecsElapsed()/1000);
 }
 
 
+// Upload the changed rows of the animation frame, if one is due
 bool
-SlideWindow::getLocations(GLuint currentProgram) {
-    vertexLocation = glGetAttribLocation(currentProgram, "p");
-    texcoordLocation = glGetAttribLocation(currentProgram, "a_texcoord");
-    if((vertexLocation   == -1) ||
-       (texcoordLocation == -1))
-    {
-        emit closing("Shader attributes not found");
+SlideWindow::showAnimationFrame(AnimatedSlide* pAnimation, GLuint texture, qint64 now) {
+    int firstRow, nRows;
+    const QImage* pFrame = pAnimation->takeDueFrame(now, &firstRow, &nRows);
+    if(!pFrame)
         return false;
+    if(nRows > 0) {
+        uploadFrameRows(texture, *pFrame, firstRow, nRows);
+        completeTexture(texture);
     }
-    // Tell OpenGL programmable pipeline how to locate vertex position data
-    glVertexAttribPointer(vertexLocation,
-                          4,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(VertexData),
-                          0);
-    glVertexAttribPointer(texcoordLocation,
-                          2,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(VertexData),
-                          BUFFER_OFFSET(sizeof(vertex.position)));
-    iTex0Loc  = glGetUniformLocation(currentProgram, "texture0");
-    iMPVLoc   = glGetUniformLocation(currentProgram, "mvp_matrix");
-    if((iTex0Loc == -1) ||
-       (iMPVLoc  == -1))
-    {
-        emit closing("Shader uniforms not found");
-        return false;
+    pAnimation->releaseFrame();
+    return nRows > 0;
+}
+
+
+// The frames follow the animation timing: during a transition they
+// are drawn by the transition frames, otherwise here
+void
+SlideWindow::onTimerAnimationEvent() {
+    if(!bGLInitialized)
+        return;
+    qint64 now = InputDevices::monotonicTimeUs();
+    bool bChanged = showAnimationFrame(pShownAnimation, texture0, now);
+    showAnimationFrame(pIncomingAnimation, texture1, now);
+    if(bChanged && !timerUpdate.isActive() && !timerMotion.isActive())
+        paintGL();
+}
+
+
+void
+SlideWindow::updateAnimationTimer() {
+    if(pShownAnimation->isOpen() || pIncomingAnimation->isOpen()) {
+        if(!timerAnimation.isActive())
+            timerAnimation.start(ANIMATION_TICK_TIME);
     }
-    if(animationType == 0) {// Fold effect
-        iALoc     = glGetUniformLocation(currentProgram, "a");
-        iThetaLoc = glGetUniformLocation(currentProgram, "theta");
-        iAngleLoc = glGetUniformLocation(currentProgram, "angle");
-        iLeftLoc  = glGetUniformLocation(currentProgram, "xLeft");
-        if((iALoc     == -1) ||
-           (iThetaLoc == -1) ||
-           (iAngleLoc == -1) ||
-           (iLeftLoc  == -1))
-        {
-            emit closing("Shader uniforms not found");
-            return false;
-        }
-        A     = A0;
-        theta = theta0;
-        angle = angle0;
-        xLeft =-GLfloat(screen_width)/GLfloat(screen_height);
+    else {
+        timerAnimation.stop();
     }
-    else if(animationType == 1) {// Fade effect
-        iTex1Loc  = glGetUniformLocation(currentProgram, "texture1");
-        iAlphaLoc = glGetUniformLocation(currentProgram, "alpha");
-        if((iAlphaLoc == -1) ||
-           (iTex0Loc == -1))
-        {
-            emit closing("Shader uniforms not found");
-            return false;
+}
+
+
+// The mipmaps of a slide texture are rebuilt by the GPU once
+// all its rows are there (only for trilinear filtering)
+void
+SlideWindow::completeTexture(GLuint texture) {
+    if(!bMipmaps || compressedTextures.contains(texture))
+        return;
+    TraceSpan span("generateMipmap", "upload");
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+
+// The slide pans and zooms for all the time it stays on
+// screen: the transitions in and out included
+void
+SlideWindow::startMotion(KenBurns* pMotion, int iSlide) {
+    if(kenBurnsZoom <= 1.0f)
+        return;
+    qint64 duration = currentTransitionTime + slideDuration(iSlide) + transitionTime;
+    pMotion->start(InputDevices::monotonicTimeUs(), 1000*duration, kenBurnsZoom);
+}
+
+
+// With Ken Burns the slides move all the time: between the transitions
+// a frame is rendered at every vsync (eglSwapBuffers() blocks until then)
+void
+SlideWindow::updateMotionTimer() {
+    if((kenBurnsZoom > 1.0f) && bGLInitialized && !timerUpdate.isActive()) {
+        if(!timerMotion.isActive()) {
+            lastMotionFrameTime = -1;
+            timerMotion.start(frameTime);
         }
-        alpha  = alpha0;
     }
-    else if(animationType == 2) {// Zoom out effect
-        fScale = fScale0;
+    else {
+        timerMotion.stop();
     }
-    else if(animationType == 3) {// Zoom out effect
-        fScale = fScale0;
+}
+
+
+void
+SlideWindow::onTimerMotionEvent() {
+    qint64 now = InputDevices::monotonicTimeUs();
+    if(lastMotionFrameTime >= 0)
+        frameStats.addFrame(now-lastMotionFrameTime);
+    lastMotionFrameTime = now;
+    paintGL();
+}
+
+
+void
+SlideWindow::onTimerUploadEvent() {
+    if(etc1Encoder.isPending()) {
+        if(etc1Encoder.isReady())
+            finishUpload(true);
+        return;
     }
-    else if(animationType == 4) {// Rotate from bottom left effect
-        fRot = fRot0;
+    int nRows    = (baseImage.height()+nUploadBands-1) / nUploadBands;
+    int firstRow = iNextBand * nRows;
+    if(firstRow >= baseImage.height()) {
+        timerUpload.stop();
+        return;
     }
-    else if(animationType == 5) {// Rotate from top left effect
-        fRot = fRot0;
+    uploadRows(texture1, firstRow, qMin(nRows, baseImage.height()-firstRow));
+    iNextBand++;
+    if(iNextBand*nRows >= baseImage.height()) {
+        timerUpload.stop();
+        completeTexture(texture1);
     }
-    return true;
 }
 
 
-bool
-SlideWindow::prepareNextRound() {
-    timerUpdate.stop();
-    animationType = qrand() % nAnimationTypes;
-    GLuint currentProgram = programs.at(animationType);
-    glUseProgram(currentProgram);
-    getLocations(currentProgram);
-
-    // Prepare the next slide...
-    glDeleteTextures(1, &texture0);
-    texture0 = texture1;
-    glGenTextures(1, &texture1);
-    if(!prepareNextSlide())
-        return false;
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pBaseImage->width(), pBaseImage->height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, pBaseImage->bits());
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    timerSteady.start(steadyTime);
-    return true;
+// Upload at once all the bands of the next slide still missing.
+// A timed transition waits for the encoder, if still at work: an
+// explicit slide change (bWaitEncoder false) uploads it uncompressed.
+void
+SlideWindow::finishUpload(bool bWaitEncoder) {
+    timerUpload.stop();
+    if(etc1Encoder.isPending()) {
+        Etc1Texture compressed;
+        bool bCompressed = bWaitEncoder ? etc1Encoder.takeTexture(&compressed)
+                                        : etc1Encoder.takeReadyTexture(&compressed);
+        if(bCompressed) {
+            uploadCompressed(texture1, compressed);
+            iNextBand = nUploadBands;
+            return;
+        }
+    }
+    int nRows    = (baseImage.height()+nUploadBands-1) / nUploadBands;
+    int firstRow = iNextBand * nRows;
+    if(firstRow < baseImage.height()) {
+        uploadRows(texture1, firstRow, baseImage.height()-firstRow);
+        completeTexture(texture1);
+    }
+    iNextBand = nUploadBands;
 }
 
 
 bool
 SlideWindow::prepareNextSlide() {
-    if(slideList.count() == 0) {
+    TraceSpan span("prepareNextSlide", "slides");
+    int nSlides = slideCount();
+    if(nSlides == 0) {
         emit closing("Slides removed from directory: exiting ...");
         return false;
     }
-    if(iCurrentSlide >= slideList.count()) {
-        iCurrentSlide = iCurrentSlide % slideList.count();
-        qDebug() << "Errore: iCurrentSlide >= slideList.count()";
+    if(iCurrentSlide >= nSlides) {
+        iCurrentSlide = iCurrentSlide % nSlides;
+        qDebug() << "Errore: iCurrentSlide >= slideCount()";
     }
-    image.load(slideList.at(iCurrentSlide).absoluteFilePath());
-    emit slideChanged(iCurrentSlide);
-    image = image.scaled(screen_width, screen_height, imageMode).mirrored();
-    if(pBaseImage == Q_NULLPTR) {
-        pBaseImage = new QImage(screen_width, screen_height, imageFormat);
+    // The frame has been (hopefully) prepared by the prefetcher thread
+    QString sSlide = slidePath(iCurrentSlide);
+    bool bAnimated;
+    {
+        TraceSpan takeSpan("takeSlide", "slides");
+        baseImage = prefetcher.takeSlide(sSlide, &bAnimated);
     }
-    if(pBaseImage == Q_NULLPTR) {
-        emit closing("Unable to create pBaseImage: exiting ...");
+    iShownSlide    = iIncomingSlide;
+    iIncomingSlide = iCurrentSlide;
+    emit slideChanged(iCurrentSlide);
+    if(baseImage.isNull()) {
+        emit closing("Unable to prepare the slide frame: exiting ...");
         return false;
     }
-    QPainter painter(pBaseImage);
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.fillRect(0, 0, screen_width, screen_height, Qt::white);
-    int x = (pBaseImage->width()-image.width())/2;
-    int y = (pBaseImage->height()-image.height())/2;
-    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    painter.drawImage(x, y, image);
-    painter.end();
-    iCurrentSlide = (iCurrentSlide + 1) % slideList.count();
+    // The first frame of an animation is in baseImage:
+    // the following ones are streamed into its ring
+    pIncomingAnimation->close();
+    pIncomingMotion->stop();
+    if(bAnimated)
+        pIncomingAnimation->open(sSlide, baseImage.width(), baseImage.height());
+    // Still slides are compressed while the previous one is on screen
+    if(bEtc1 && !pIncomingAnimation->isOpen())
+        etc1Encoder.encode(sSlide, baseImage);
+    else
+        etc1Encoder.cancel();
+    updateAnimationTimer();
+    iCurrentSlide = (iCurrentSlide + 1) % nSlides;
+    schedulePrefetch();
     return true;
 }
 
 
+// Level 0 storage of the bound slide texture, in the chosen format
+void
+SlideWindow::allocateTexture() {
+    if(bRgb565)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, slide_width, slide_height, 0,
+                     GL_RGB, GL_UNSIGNED_SHORT_5_6_5, Q_NULLPTR);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, slide_width, slide_height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, Q_NULLPTR);
+}
+
+
 bool
 SlideWindow::initTextures() {
+    // Trilinear filtering for shrinking slides (zoom transitions and
+    // Ken Burns) without shimmering. OpenGL ES 2 builds the mipmaps of
+    // non power of two textures only with GL_OES_texture_npot.
+    QList<QByteArray> extensions = QByteArray(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS))).split(' ');
+    bool bPowerOfTwo = ((slide_width & (slide_width-1)) == 0) && ((slide_height & (slide_height-1)) == 0);
+    bMipmaps = bPowerOfTwo || extensions.contains("GL_OES_texture_npot");
+    if(!bMipmaps)
+        qDebug() << "No mipmaps for" << slide_width << "x" << slide_height << "slides: bilinear filtering";
+    bEtc1 = bEtc1Wanted && extensions.contains("GL_OES_compressed_ETC1_RGB8_texture");
+    if(bEtc1Wanted && !bEtc1)
+        qDebug() << "ETC1 textures not supported: slides uploaded uncompressed";
+    etc1Encoder.setMipmaps(bMipmaps);
+    // 16 bit textures when asked for or when the RGBA slides, with the
+    // frame buffers, would take too much of a small GPU memory split
+    qint64 gpuMemory = pSurface->gpuMemory();
+    qint64 rgbaBytes = 2*4*qint64(slide_width)*slide_height;
+    if(bMipmaps)
+        rgbaBytes += rgbaBytes/3;
+    rgbaBytes += (2*4+4)*qint64(screen_width)*screen_height;
+    bRgb565 = bRgb565Forced ||
+              (bRgb565Auto && (gpuMemory > 0) && (GPU_MEMORY_SHARE*rgbaBytes > gpuMemory));
+    if(bRgb565) {
+        qDebug() << "RGB565 slide textures (GPU memory" << gpuMemory/(1024*1024) << "MB)";
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);// Rows of an odd number of pixels
+    }
+    // The storage of the two slide textures is allocated only once:
+    // then each new slide will just replace the content of one of them.
+    glGenTextures(2, textureRing);
+    for(int i=0; i<2; i++) {
+        glBindTexture(GL_TEXTURE_2D, textureRing[i]);
+        allocateTexture();
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, bMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    texture0 = textureRing[0];
+    texture1 = textureRing[1];
+
     // Setup the first texture
     if(!prepareNextSlide())
         return false;
-    glGenTextures(1, &texture0);// Reserve a name for the first texture
-    glBindTexture(GL_TEXTURE_2D, texture0);// Create a texture object
-    // Specify storage and content of the texture object
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pBaseImage->width(), pBaseImage->height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, pBaseImage->bits());
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    // Now the second texture
+    uploadSlide(texture0);
+    qSwap(pShownAnimation, pIncomingAnimation);
+    qSwap(pShownMotion, pIncomingMotion);
+    if(pShownAnimation->isOpen())
+        pShownAnimation->play(InputDevices::monotonicTimeUs());
+    startMotion(pShownMotion, iIncomingSlide);
+
+    // Now the second texture: compressed while the first one is shown
     if(!prepareNextSlide())
         return false;
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pBaseImage->width(), pBaseImage->height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, pBaseImage->bits());
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    iNextBand = 0;
+    if(etc1Encoder.isPending())
+        timerUpload.start(UPLOAD_BAND_TIME);
+    else
+        finishUpload(true);
     return true;
 }
 
 
-void
-SlideWindow::initGeometry(int screen_width, int screen_height) {
-    float aspectRatio = float(screen_width)/float(screen_height);
-    QVector<VertexData> vertices;
-    int nxStep = 54;
-    int nyStep = 36;
-    float dx = 2.0/nxStep;
-    float dy = 2.0/nyStep;
-    float xdx, ydy;
-
-    float x, y, xT, yT;
-    x = -1.0;
-    for(int i=0; i<nxStep; i++) {
-        xdx = x + dx;
-        if(xdx >= 1.0f) xdx= 1.0f;
-        xT = x + 1.0;
-        y= -1.0f;
-        for(int j=0; j<nyStep; j++) {
-            ydy = y + dy;
-            if(ydy >= 1.0f) ydy = 1.0f;
-            yT = y + 1.0;
-            vertices.append({QVector4D(x*aspectRatio,   y,   0.0f, 1.0f),
-                             QVector2D(0.5*xT,        0.5*yT)});
-            vertices.append({QVector4D(xdx*aspectRatio, y,   0.0f, 1.0f),
-                             QVector2D(0.5*(xdx+1.0), 0.5*yT)});
-            vertices.append({QVector4D(x*aspectRatio,   ydy, 0.0f, 1.0f),
-                             QVector2D(0.5*xT,        0.5*(ydy+1.0))});
-            vertices.append({QVector4D(xdx*aspectRatio, ydy, 0.0f, 1.0f),
-                             QVector2D(0.5*(xdx+1.0), 0.5*(ydy+1.0))});
-            y = ydy;
-        }
-        x = xdx;
-    }
-    nVertices = vertices.count();
-    // Transfer vertex data to VBO 0
-    glBindBuffer(GL_ARRAY_BUFFER, arrayBuf);
-    glBufferData(GL_ARRAY_BUFFER, vertices.count()*sizeof(vertices.at(0)), vertices.data(), GL_STATIC_DRAW);
-}
-
-
 bool
 SlideWindow::initializeGL() {
     if(bGLInitialized)
         return true;
-    programs.clear();
-    // Generate a VBO
-    glGenBuffers(1, &arrayBuf);
-    // Initializes cube geometry and transfers it to VBOs
-    initGeometry(screen_width, screen_height);
     if(!initShaders())
         return false;
     if(!initTextures())
@@ -767,272 +1277,58 @@ SlideWindow::initializeGL() {
     float nearPlane     = viewingDistance - 2.0;
     float farPlane      = viewingDistance + 0.1;
     projection.perspective(verticalAngle, aspectRatio, nearPlane, farPlane);
-    animationType = qrand() % nAnimationTypes;
-    GLuint currentProgram = programs.at(animationType);
-    glUseProgram(currentProgram);
-    getLocations(currentProgram);
+    // The incoming slide is always drawn just behind the outgoing one
+    glClearDepthf(1.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    transitionContext.projection      = projection;
+    transitionContext.viewingDistance = viewingDistance;
+    transitionContext.aspect          = aspectRatio;
+    chooseTransition();
     bGLInitialized = true;
-    return true;
-}
-
-
-bool
-SlideWindow::compileShader(GLenum shaderType, QString shaderFile, GLuint* pShaderName) {
-    GLchar *vShaderStr = ReadFile(shaderFile);
-    if(vShaderStr == Q_NULLPTR)
-        return false;
-    *pShaderName = glCreateShader(shaderType);
-    if(*pShaderName == 0) {
-        emit closing("Unable to create shader");
-        return false;
-    }
-    //load shader source
-    glShaderSource(*pShaderName, 1, (const GLchar **)&vShaderStr, NULL);
-    //Compile shader
-    glCompileShader(*pShaderName);
-    // Check the compile status
-    GLint vCompiled;
-    glGetShaderiv(*pShaderName, GL_COMPILE_STATUS, &vCompiled);
-    if(!vCompiled) {
-        emit closing("Unable to compile Fold vertex shader");
-        return false;
-    }
-    return true;
-}
-
-
-bool
-SlideWindow::linkProgram(GLuint* pNewProgram, GLuint vertexShader, GLuint fragmentShader) {
-    *pNewProgram = glCreateProgram();
-    if(*pNewProgram == 0) {
-        emit closing("Unable to create Program Object");
-        return false;
-    }
-    //Attach shaders to the program object
-    glAttachShader(*pNewProgram, vertexShader);
-    glAttachShader(*pNewProgram, fragmentShader);
-    // Link the program
-    glLinkProgram(*pNewProgram);
-    // Check the link status and print the errors
-    GLint linked;
-    glGetProgramiv(*pNewProgram, GL_LINK_STATUS, &linked);
-    if(!linked) {
-        GLint infoLen = 0;
-        glGetProgramiv(*pNewProgram, GL_INFO_LOG_LENGTH, &infoLen);
-
-        if(infoLen > 1) {
-            char* infoLog = (char*)malloc(sizeof(char) * infoLen);
-            glGetProgramInfoLog(*pNewProgram, infoLen, NULL, infoLog);
-            qDebug() <<"Error linking program" << infoLog;
-            free(infoLog);
-        }
-        glDeleteProgram(*pNewProgram);
-        emit closing("Error linking program");
-        return false;
-    }
+    updateMotionTimer();
+    // Also when GL comes up late (the first slides arrived
+    // after the start): the keys drive the shown slides
+    if(bInputEnabled && !inputDevices.open())
+        qDebug() << "No keyboard found";
     return true;
 }
 
 
 bool
 SlideWindow::initShaders() {
-    //Create vertex shader object
-    GLuint vShaderFold, vShaderFade;
-    if(!compileShader(GL_VERTEX_SHADER, ":/vshaderFold.glsl", &vShaderFold))
-        return false;
-    if(!compileShader(GL_VERTEX_SHADER, ":/vshaderFade.glsl", &vShaderFade))
-        return false;
-
-    GLuint fShaderFold, fShaderFade;
-    if(!compileShader(GL_FRAGMENT_SHADER, ":/fshaderFold.glsl", &fShaderFold))
-        return false;
-    if(!compileShader(GL_FRAGMENT_SHADER, ":/fshaderFade.glsl", &fShaderFade))
+    programCache.init();
+    int nCached = programCache.hits();
+    if(!transitions.init(GLfloat(screen_width)/GLfloat(screen_height), &programCache)) {
+        emit closing(transitions.errorString());
         return false;
-
-    // Create the program objects
-    GLuint newProgram;
-    if(!linkProgram(&newProgram, vShaderFold, fShaderFold))
-        return false;
-    programs.append(newProgram);// Fold page effect at 0
-    if(!linkProgram(&newProgram, vShaderFade, fShaderFade))
-        return false;
-    programs.append(newProgram);// Fade  in  effect at 1
-    if(!linkProgram(&newProgram, vShaderFade, fShaderFold))
-        return false;
-    programs.append(newProgram);// Zoom  out effect at 2
-    programs.append(newProgram);// Zoom  in  effect at 3
-    programs.append(newProgram);// Rotate from bottom left effect at 4
-    programs.append(newProgram);// Rotate from top left effect at 5
-
-    nAnimationTypes = programs.count();
+    }
+    qDebug() << "Programs from cache" << programCache.hits()-nCached
+             << "linked" << transitions.linkedPrograms();
     return true;
 }
 
 
-void
-SlideWindow::drawGeometry() {
-    glEnableVertexAttribArray(vertexLocation);
-    glEnableVertexAttribArray(texcoordLocation);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, nVertices);
-}
-
-
 void
 SlideWindow::paintGL() {
+    TraceSpan span("paintGL", "render");
     // set the clear colour
     glClearColor(1.0, 1.0, 1.0, 1.0);
     // clear Screen and Depth Buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    if(animationType == 0) {
-        glClearDepthf(5.0f);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL);
-
-        glUniform1i(iTex0Loc, 0);
-        glUniform1i(iTex1Loc, 0);
-
-        // Using only texture unit 0
-        glActiveTexture(GL_TEXTURE0);
-
-        glBindTexture(GL_TEXTURE_2D, texture0);
-        glUniform1f(iLeftLoc, xLeft);
-        glUniform1f(iAlphaLoc, 1.0f);
-        glUniform4f(iALoc, A.x(), A.y(), A.z(), A.w());
-        glUniform1f(iThetaLoc, theta);
-        glUniform1f(iAngleLoc, angle);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();// Draw the geometry
-
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glUniform4f(iALoc, A0.x(), A0.y(), A0.z(), A0.w());
-        glUniform1f(iThetaLoc, theta0);
-        glUniform1f(iAngleLoc, angle0);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance-0.01);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-    }
-    else if(animationType == 1) {
-        glUniform1i(iTex0Loc, 0);
-        glUniform1i(iTex1Loc, 1);
-        glUniform1f(iAlphaLoc, alpha);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture0);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-    }
-    else if(animationType == 2) {
-        glClearDepthf(5.0f);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL);
-
-        glUniform1i(iTex0Loc, 0);
-        glUniform1i(iTex1Loc, 0);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture0);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance);
-        matrix.scale(fScale);
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance-0.01);
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-    }
-    else if(animationType == 3) {
-        glClearDepthf(5.0f);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL);
-
-        glUniform1f(iAlphaLoc, alpha0);
-        glUniform1i(iTex0Loc, 0);
-        glUniform1i(iTex1Loc, 0);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture0);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance-0.01);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance);
-        matrix.scale(1.0f-fScale);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-    }
-    else if(animationType == 4) {
-        glClearDepthf(5.0f);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL);
-
-        glUniform1f(iAlphaLoc, alpha0);
-        glUniform1i(iTex0Loc, 0);
-        glUniform1i(iTex1Loc, 0);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture0);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance);
-        matrix.translate(-1.0*GLfloat(screen_width)/GLfloat(screen_height),-1.0, 0.0);
-        matrix.rotate(fRot, 0.0, 0.0, -1.0);
-        matrix.translate(1.0*GLfloat(screen_width)/GLfloat(screen_height),  1.0, 0.0);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance-0.01);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-    }
-    else if(animationType == 5) {
-        glClearDepthf(5.0f);
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL);
-
-        glUniform1f(iAlphaLoc, alpha0);
-        glUniform1i(iTex0Loc, 0);
-        glUniform1i(iTex1Loc, 0);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture0);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance);
-        matrix.translate(-1.0*GLfloat(screen_width)/GLfloat(screen_height), 1.0, 0.0);
-        matrix.rotate(fRot, 0.0, 0.0, -1.0);
-        matrix.translate(1.0*GLfloat(screen_width)/GLfloat(screen_height), -1.0, 0.0);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        matrix.setToIdentity();
-        matrix.translate(0.0, 0.0, -viewingDistance-0.01);
-        // Set modelview-projection matrix
-        glUniformMatrix4fv(iMPVLoc, 4, GL_FALSE, (projection * matrix).constData());
-        drawGeometry();
-    }
+    transitionContext.texture0 = texture0;
+    transitionContext.texture1 = texture1;
+    qint64 now = InputDevices::monotonicTimeUs();
+    transitionContext.window0 = pShownMotion->window(now);
+    transitionContext.window1 = pIncomingMotion->window(now);
+    pTransition->draw(transitionContext);
+
     // Swap back buffer to front
-    eglSwapBuffers(display, surface);
+    TraceSpan swapSpan("eglSwapBuffers", "render");
+    pSurface->swapBuffers();
+    if(inputEventTime >= 0) {
+        inputStats.addFrame(InputDevices::monotonicTimeUs() - inputEventTime);
+        inputEventTime = -1;
+    }
 }
@@ -4,138 +4,213 @@
 #include <QObject>
 
 #include <QTimer>
-#include <QFileInfoList>
+#include <QElapsedTimer>
 #include <QImage>
-#include <QVector4D>
-#include <QVector2D>
+#include <QVariantMap>
+#include <QAtomicInt>
 #include <QMatrix4x4>
+#include <QSet>
+#include <QVector>
 
 #include "GLES2/gl2.h"
 #include "GLES2/gl2ext.h"
-#include "EGL/egl.h"
-#include "EGL/eglext.h"
-#include "bcm_host.h"
 
-#include <linux/input.h>
+#include "slideprefetcher.h"
+#include "slideindex.h"
+#include "framestats.h"
+#include "transitionregistry.h"
+#include "programcache.h"
+#include "rendersurface.h"
+#include "tracer.h"
+#include "inputdevices.h"
+#include "playlist.h"
+#include "animatedslide.h"
+#include "kenburns.h"
+#include "etc1encoder.h"
 
 class SlideWindow : public QObject
 {
     Q_OBJECT
 public:
-    SlideWindow();
+    SlideWindow(RenderSurface* pRenderSurface = Q_NULLPTR);
     ~SlideWindow();
     void paintGL();
-    void pauseSlideShow();
     bool isReady();
     bool isRunning();
     void initEgl();
     void deinitEgl();
     bool initializeGL();
+    void setPrefetchDepth(int depth);
+    int  prefetchMisses();
+    FrameStats frameStatistics();
+    void setUploadBands(int nBands);
+    void setCacheBudget(int megaBytes);
+    void setDecodeMemoryLimit(int megaBytes);
+    int  cacheHits();
+    int  cacheMisses();
+    int  cacheEvictions();
+    void setDiskCacheDir(QString sDir);
+    void setDiskCacheBudget(int megaBytes);
+    void setProgramCacheDir(QString sDir);
+    void setIndexCacheDir(QString sDir);
+    void setRecursiveScan(bool bRecursive);
+    void setInputEnabled(bool bEnabled);
+    void setKenBurns(float maxZoom);
+    void setCompressedTextures(bool bEnabled);
+    bool setTextureFormat(QString sFormat);
+    void follow(SlideWindow* pLeader);
 
 public Q_SLOTS:
     void setSlideDir(QString sDir);
     void startSlideShow();
     void stopSlideShow();
     void exitShow();
+    QVariantMap GetStats();
+    void startTrace(QString sFile);
+    void nextSlide();
+    void previousSlide();
+    void jumpToSlide(int iSlide);
+    void pauseSlideShow();
+    void resumeSlideShow();
+    bool loadPlaylist(QString sFile);
+    void clearPlaylist();
+    void stopTrace();
 
 Q_SIGNALS:
     void crashed();
+    void StatsUpdated(QVariantMap stats);
 
 signals:
     void closing(QString sReason);
     void slideChanged(int iCurrentSlide);
+    // The commands received, for the outputs following this one
+    void slideDirSet(QString sDir);
+    void slideShowStarted();
+    void slideShowStopped();
+    void nextSlideRequested();
+    void previousSlideRequested();
+    void slideJumpRequested(int iSlide);
+    void slideShowPaused();
+    void slideShowResumed();
+    void playlistLoaded(QString sFile);
+    void playlistCleared();
 
 public slots:
     void ontimerUpdateEvent();
     void onTimerSteadyEvent();
-    void onTimerCheckInput();
+    void onTimerUploadEvent();
+    void onSlideInserted(int iPosition);
+    void onSlideRemoved(int iPosition);
+    void onSlidesReset();
+    void onTimerStatsEvent();
+    void onTimerAnimationEvent();
+    void onTimerMotionEvent();
+    void onNextRequested(qint64 eventTimeUs);
+    void onPreviousRequested(qint64 eventTimeUs);
+    void onPauseRequested(qint64 eventTimeUs);
+    void onJumpRequested(int iSlide, qint64 eventTimeUs);
+    void onExitRequested();
 
 protected:
-    void initEglAttributes();
-    void drawGeometry();
-
     void updateSlideList();
-    bool prepareNextRound() ;
+    bool prepareNextRound(bool bShowNow=false);
     bool prepareNextSlide();
+    void schedulePrefetch();
+    void startWhenSlidesArrive();
+    void restartSlides();
+    void showSlide(int iSlide);
+    int  slideCount();
+    QString slidePath(int iSlide);
+    int  slideDuration(int iSlide);
 
-    bool compileShader(GLenum shaderType, QString shaderFile, GLuint *pShaderName);
-    bool linkProgram(GLuint* pNewProgram, GLuint vertexShader, GLuint fragmentShader);
     bool initShaders();
     bool initTextures();
-    void initGeometry(int screen_width, int screen_height);
-    bool getLocations(GLuint currentProgram);
-
-    void initInputDevices();
-    void releaseInputDevices();
-
-    char* ReadFile(QString url);
+    void allocateTexture();
+    void uploadRows(GLuint texture, int firstRow, int nRows);
+    void uploadFrameRows(GLuint texture, const QImage& frame, int firstRow, int nRows);
+    void uploadSlide(GLuint texture);
+    void uploadCompressed(GLuint texture, const Etc1Texture& compressed);
+    bool showAnimationFrame(AnimatedSlide* pAnimation, GLuint texture, qint64 now);
+    void updateAnimationTimer();
+    void completeTexture(GLuint texture);
+    void startMotion(KenBurns* pMotion, int iSlide);
+    void updateMotionTimer();
+    void finishUpload(bool bWaitEncoder);
+    void chooseTransition();
 
 private:
     uint32_t screen_width;
     uint32_t screen_height;
-    DISPMANX_UPDATE_HANDLE_T dispman_update;
-    EGL_DISPMANX_WINDOW_T nativewindow;
-    // OpenGL|ES objects
-    DISPMANX_DISPLAY_HANDLE_T dispman_display;
-    DISPMANX_ELEMENT_HANDLE_T dispman_element;
-    EGLDisplay display;
-    EGLSurface surface;
-    EGLContext context;
-    QVector<EGLint> attribute_list;
+    uint32_t slide_width;// Of the slide textures
+    uint32_t slide_height;
+    RenderSurface* pSurface;
 
 private:
     QApplication* pMyApplication;
     QString sSlideDir;
-    QFileInfoList slideList;
+    SlideIndex slideIndex;
+    SlideIndex* pSlideIndex;// slideIndex or the one of the followed output
+    Playlist playlist;
+    QString sNextSlide;
 
     QTimer timerUpdate, timerSteady;
-    QTimer timerCheckInput;
-
-    int iCurrentSlide;
-    QImage::Format imageFormat;
-    QImage *pBaseImage, image;
-    enum Qt::AspectRatioMode imageMode;
+    QTimer timerUpload;
+    QTimer timerStats;
+    QTimer timerAnimation;
+    QTimer timerMotion;
+
+    int iCurrentSlide;// The next to be loaded
+    int iShownSlide;// In texture0
+    int iIncomingSlide;// In texture1
+    SlidePrefetcher prefetcher;
+    QImage baseImage;
+    AnimatedSlide animationRing[2];// One for each slide texture
+    AnimatedSlide* pShownAnimation;// Playing in texture0
+    AnimatedSlide* pIncomingAnimation;// Ready to play in texture1
+    KenBurns motionRing[2];// Pan and zoom of each slide texture
+    KenBurns* pShownMotion;
+    KenBurns* pIncomingMotion;
+    float kenBurnsZoom;// 0: no Ken Burns motion
+    qint64 lastMotionFrameTime;
 
     int steadyTime;
-    int updateTime;
-
-    struct VertexData {
-        QVector4D position;
-        QVector2D texCoord;
-    } vertex;
-    GLuint arrayBuf;
-    int nVertices;
-
-    QVector<GLuint> programs;
+    int transitionTime;
+    int currentTransitionTime;
+    QElapsedTimer transitionClock;
+    qint64 lastFrameTime;
+    int    frameTime;// Transition and motion timers interval (ms)
+    FrameStats frameStats;
+    FrameStats uploadStats;
+    FrameStats inputStats;
+    qint64 inputEventTime;
+    QAtomicInt nTransitions;
+    QString sTraceFile;
+
+    TransitionRegistry transitions;
+    Transition* pTransition;
+    TransitionContext transitionContext;
+    ProgramCache programCache;
 
     GLfloat viewingDistance;
-    QMatrix4x4 matrix;
+    GLuint textureRing[2];
     GLuint texture0, texture1;
+    bool bMipmaps;
+    bool bEtc1Wanted;
+    bool bEtc1;// Wanted and supported by the GPU
+    Etc1Encoder etc1Encoder;
+    QSet<GLuint> compressedTextures;// Holding ETC1 slides
+    bool bRgb565Forced;
+    bool bRgb565Auto;// When the GPU memory is short
+    bool bRgb565;// 16 bit slide textures
+    QVector<unsigned short> rgb565Rows;// The rows being uploaded, converted
+    int nUploadBands;
+    int iNextBand;
     QMatrix4x4 projection;
-    QVector4D A,      A0;
-    GLfloat   theta,  theta0;
-    GLfloat   angle,  angle0;
-    GLfloat   alpha,  alpha0;
-    GLfloat   fScale, fScale0;
-    GLfloat   fRot,   fRot0;
-    GLfloat   xLeft;
-
-    GLint animationType;
-    int nAnimationTypes;
-
-    GLint iLeftLoc;
-    GLint iAlphaLoc, iALoc, iThetaLoc, iAngleLoc;
-    GLint iTex0Loc, iTex1Loc;
-    GLint iMPVLoc;
-    GLint vertexLocation;
-    GLint texcoordLocation;
-
-    int mouseFd;
-    int keyboardFd;
-    struct input_event ev[64];
-    int rd;
-    double t0;
+
+    InputDevices inputDevices;
     bool bGLInitialized, bEglInitialized, bSlidesPresent, bRunning;
+    bool bPaused;
+    bool bInputEnabled;
 };
 
 #endif // SLIDEWINDOW_H
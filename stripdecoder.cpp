@@ -0,0 +1,247 @@
+#include "stripdecoder.h"
+#include "jpegdecoder.h"
+#include "framepool.h"
+#include "tracer.h"
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <string.h>
+#include <png.h>
+
+#include <QDebug>
+#include <QFile>
+#include <QImageReader>
+
+
+RowScaler::RowScaler(int srcWidth, int sourceHeight, QImage* pDstImage)
+    : pImage(pDstImage)
+    , srcHeight(sourceHeight)
+    , dstWidth(pDstImage->width())
+    , dstHeight(pDstImage->height())
+    , iSrcRow(0)
+    , iDstRow(0)
+    , nSummedRows(0)
+{
+    dstColumn.resize(srcWidth);
+    columnWidth.fill(0, dstWidth);
+    for(int x=0; x<srcWidth; x++) {
+        dstColumn[x] = int(qint64(x)*dstWidth/srcWidth);
+        columnWidth[dstColumn.at(x)]++;
+    }
+    sums.fill(0, 4*dstWidth);
+}
+
+
+// The largest size with the source aspect ratio fitting the screen
+// (images are never enlarged here)
+QSize
+RowScaler::fitSize(int srcWidth, int srcHeight, int screenWidth, int screenHeight) {
+    double fScale = qMin(1.0, qMin(double(screenWidth)/double(srcWidth),
+                                   double(screenHeight)/double(srcHeight)));
+    return QSize(qMax(1, qRound(fScale*srcWidth)), qMax(1, qRound(fScale*srcHeight)));
+}
+
+
+// Besides the destination image
+qint64
+RowScaler::memoryBytes(int srcWidth, int dstWidth) {
+    return qint64(srcWidth)*int(sizeof(int)) +
+           qint64(dstWidth)*int(sizeof(int) + 4*sizeof(quint64));
+}
+
+
+// Rows come in RGB or RGBA (not premultiplied) byte order
+void
+RowScaler::addRow(const uchar* pRow, int bytesPerPixel, bool bAlpha) {
+    if(iSrcRow >= srcHeight)
+        return;
+    int iRowDst = int(qint64(iSrcRow)*dstHeight/srcHeight);
+    if(iRowDst != iDstRow)
+        flushRow();
+    iDstRow = iRowDst;
+    quint64* pSums = sums.data();
+    const int* pColumn = dstColumn.constData();
+    int srcWidth = dstColumn.count();
+    if(bAlpha) {
+        for(int x=0; x<srcWidth; x++, pRow+=bytesPerPixel) {
+            quint64* pSum = pSums + 4*pColumn[x];
+            unsigned alpha = pRow[3];
+            pSum[0] += (pRow[0]*alpha + 127)/255;
+            pSum[1] += (pRow[1]*alpha + 127)/255;
+            pSum[2] += (pRow[2]*alpha + 127)/255;
+            pSum[3] += alpha;
+        }
+    }
+    else {
+        for(int x=0; x<srcWidth; x++, pRow+=bytesPerPixel) {
+            quint64* pSum = pSums + 4*pColumn[x];
+            pSum[0] += pRow[0];
+            pSum[1] += pRow[1];
+            pSum[2] += pRow[2];
+            pSum[3] += 255;
+        }
+    }
+    nSummedRows++;
+    iSrcRow++;
+}
+
+
+void
+RowScaler::finish() {
+    if(nSummedRows > 0)
+        flushRow();
+}
+
+
+void
+RowScaler::flushRow() {
+    uchar* pDst = pImage->scanLine(iDstRow);
+    for(int x=0; x<dstWidth; x++) {
+        quint64 n = quint64(columnWidth.at(x))*quint64(nSummedRows);
+        for(int c=0; c<4; c++) {
+            pDst[4*x+c] = n ? uchar((sums.at(4*x+c) + n/2)/n) : 255;
+            sums[4*x+c] = 0;
+        }
+    }
+    nSummedRows = 0;
+}
+
+
+// Bytes of the whole image as decoded by Qt (0 if unknown)
+qint64
+StripDecoder::fullDecodeBytes(QString sFile) {
+    QSize size = QImageReader(sFile).size();
+    if(!size.isValid())
+        return 0;
+    return 4*qint64(size.width())*qint64(size.height());
+}
+
+
+bool
+StripDecoder::decode(QString sFile, int screenWidth, int screenHeight,
+                     qint64 memoryLimit, QImage* pImage)
+{
+    TraceSpan span("stripDecode", "decode");
+    QByteArray format = QImageReader::imageFormat(sFile);
+    if(format == "jpeg")
+        return JpegDecoder::decodeStrips(sFile, screenWidth, screenHeight, memoryLimit, pImage);
+    if(format == "png")
+        return decodePng(sFile, screenWidth, screenHeight, memoryLimit, pImage);
+    return decodeScaled(sFile, screenWidth, screenHeight, memoryLimit, pImage);
+}
+
+
+static void
+pngError(png_structp pPng, png_const_charp sMessage) {
+    qDebug() << "libpng:" << sMessage;
+    png_longjmp(pPng, 1);
+}
+
+
+static void
+pngWarning(png_structp pPng, png_const_charp sMessage) {
+    Q_UNUSED(pPng)
+    Q_UNUSED(sMessage)
+}
+
+
+// libpng reads one row at a time. Interlaced images can not be
+// read like that: without enough memory for all of them they fail.
+bool
+StripDecoder::decodePng(QString sFile, int screenWidth, int screenHeight,
+                        qint64 memoryLimit, QImage* pImage)
+{
+    FILE* pFile = fopen(QFile::encodeName(sFile).constData(), "rb");
+    if(!pFile)
+        return false;
+    png_structp pPng = png_create_read_struct(PNG_LIBPNG_VER_STRING, Q_NULLPTR, pngError, pngWarning);
+    png_infop pInfo  = pPng ? png_create_info_struct(pPng) : Q_NULLPTR;
+    if(!pInfo) {
+        png_destroy_read_struct(&pPng, Q_NULLPTR, Q_NULLPTR);
+        fclose(pFile);
+        return false;
+    }
+    // Volatile: they change after setjmp()
+    uchar* volatile pRow = Q_NULLPTR;
+    RowScaler* volatile pScaler = Q_NULLPTR;
+    if(setjmp(png_jmpbuf(pPng))) {
+        delete pScaler;
+        free(pRow);
+        png_destroy_read_struct(&pPng, &pInfo, Q_NULLPTR);
+        fclose(pFile);
+        *pImage = QImage();
+        return false;
+    }
+    png_init_io(pPng, pFile);
+    png_read_info(pPng, pInfo);
+    int width  = int(png_get_image_width(pPng, pInfo));
+    int height = int(png_get_image_height(pPng, pInfo));
+    if(png_get_interlace_type(pPng, pInfo) != PNG_INTERLACE_NONE) {
+        qDebug() << sFile << "is interlaced: too large to be shown";
+        png_destroy_read_struct(&pPng, &pInfo, Q_NULLPTR);
+        fclose(pFile);
+        return false;
+    }
+    // Whatever the source format: 8 bit RGBA rows
+    png_set_expand(pPng);
+    png_set_strip_16(pPng);
+    png_set_gray_to_rgb(pPng);
+    png_set_filler(pPng, 0xff, PNG_FILLER_AFTER);
+    png_read_update_info(pPng, pInfo);
+    bool bAlpha = (png_get_color_type(pPng, pInfo) & PNG_COLOR_MASK_ALPHA) ||
+                  png_get_valid(pPng, pInfo, PNG_INFO_tRNS);
+
+    QSize size = RowScaler::fitSize(width, height, screenWidth, screenHeight);
+    // Our row, the two of libpng (up to 16 bit RGBA) and the output
+    qint64 needed = (4+2*8)*qint64(width) +
+                    4*qint64(size.width())*size.height() +
+                    RowScaler::memoryBytes(width, size.width());
+    if(needed > memoryLimit) {
+        qDebug() << sFile << "needs" << needed << "bytes even in strips";
+        png_destroy_read_struct(&pPng, &pInfo, Q_NULLPTR);
+        fclose(pFile);
+        return false;
+    }
+    *pImage = FramePool::instance()->image(size, QImage::Format_RGBA8888_Premultiplied);
+    pRow    = static_cast<uchar*>(malloc(4*size_t(width)));
+    if(pImage->isNull() || !pRow) {
+        free(pRow);
+        png_destroy_read_struct(&pPng, &pInfo, Q_NULLPTR);
+        fclose(pFile);
+        *pImage = QImage();
+        return false;
+    }
+    pScaler = new RowScaler(width, height, pImage);
+    for(int y=0; y<height; y++) {
+        png_read_row(pPng, pRow, Q_NULLPTR);
+        pScaler->addRow(pRow, 4, bAlpha);
+    }
+    pScaler->finish();
+    png_read_end(pPng, Q_NULLPTR);
+    delete pScaler;
+    free(pRow);
+    png_destroy_read_struct(&pPng, &pInfo, Q_NULLPTR);
+    fclose(pFile);
+    return true;
+}
+
+
+// Other formats: only if Qt can read them already scaled
+// (or they are small enough to be decoded whole)
+bool
+StripDecoder::decodeScaled(QString sFile, int screenWidth, int screenHeight,
+                           qint64 memoryLimit, QImage* pImage)
+{
+    QImageReader reader(sFile);
+    QSize size = reader.size();
+    if(!size.isValid())
+        return false;
+    QSize scaledSize = RowScaler::fitSize(size.width(), size.height(), screenWidth, screenHeight);
+    if(reader.supportsOption(QImageIOHandler::ScaledSize))
+        reader.setScaledSize(scaledSize);
+    else if(4*qint64(size.width())*size.height() > memoryLimit) {
+        qDebug() << sFile << "is too large to be shown";
+        return false;
+    }
+    return reader.read(pImage);
+}
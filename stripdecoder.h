@@ -0,0 +1,56 @@
+#ifndef STRIPDECODER_H
+#define STRIPDECODER_H
+
+#include <QString>
+#include <QImage>
+#include <QVector>
+
+
+// Box filters the rows of a large image, fed one at a time from the
+// top, into a (much) smaller premultiplied RGBA image. Only one row
+// of sums is kept, whatever the source height.
+class RowScaler
+{
+public:
+    RowScaler(int srcWidth, int srcHeight, QImage* pDstImage);
+    static QSize fitSize(int srcWidth, int srcHeight, int screenWidth, int screenHeight);
+    static qint64 memoryBytes(int srcWidth, int dstWidth);
+    void addRow(const uchar* pRow, int bytesPerPixel, bool bAlpha);
+    void finish();
+
+private:
+    void flushRow();
+
+private:
+    QImage* pImage;
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    int iSrcRow;
+    int iDstRow;
+    int nSummedRows;
+    QVector<int> dstColumn;// Of each source column
+    QVector<int> columnWidth;// Source columns in each destination one
+    QVector<quint64> sums;// 4 channels for each destination column
+};
+
+
+// Decoding of images too large to be held in memory (e.g. gigapixel
+// panoramas): the rows are read a strip at a time and box filtered
+// into an image that fits the screen. Whatever the source resolution
+// the memory used stays below memoryLimit bytes, or decode() fails.
+class StripDecoder
+{
+public:
+    static qint64 fullDecodeBytes(QString sFile);
+    static bool decode(QString sFile, int screenWidth, int screenHeight,
+                       qint64 memoryLimit, QImage* pImage);
+
+private:
+    static bool decodePng(QString sFile, int screenWidth, int screenHeight,
+                          qint64 memoryLimit, QImage* pImage);
+    static bool decodeScaled(QString sFile, int screenWidth, int screenHeight,
+                             qint64 memoryLimit, QImage* pImage);
+};
+
+#endif // STRIPDECODER_H
@@ -0,0 +1,145 @@
+#include "tracer.h"
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <QDebug>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QSaveFile>
+
+
+struct TraceEvent {
+    const char* sName;
+    const char* sCategory;
+    qint64 startUs;
+    qint64 durationUs;
+    int    tid;
+};
+
+
+static QAtomicInt               bTracing(0);
+static QAtomicPointer<TraceEvent> pRing(Q_NULLPTR);
+static quint32                  ringMask = 0;
+static QAtomicInteger<quint32>  nRecorded(0);
+static QElapsedTimer            traceClock;
+
+
+static int
+threadId() {
+    static thread_local int tid = int(syscall(SYS_gettid));
+    return tid;
+}
+
+
+// The ring is allocated by the first start() and then kept:
+// spans being recorded by other threads may still refer to it.
+void
+Tracer::start(int capacity) {
+    if(bTracing.loadAcquire())
+        return;
+    if(pRing.loadAcquire() == Q_NULLPTR) {
+        quint32 size = 1;
+        while(size < quint32(qMax(capacity, 2)))
+            size <<= 1;
+        ringMask = size - 1;
+        pRing.storeRelease(new TraceEvent[size]);
+    }
+    nRecorded.storeRelease(0);
+    if(!traceClock.isValid())
+        traceClock.start();
+    bTracing.storeRelease(1);
+}
+
+
+void
+Tracer::stop() {
+    bTracing.storeRelease(0);
+}
+
+
+bool
+Tracer::isEnabled() {
+    return bTracing.loadAcquire() != 0;
+}
+
+
+// Microseconds since tracing was first started
+qint64
+Tracer::now() {
+    if(!traceClock.isValid())
+        return 0;
+    return traceClock.nsecsElapsed()/1000;
+}
+
+
+void
+Tracer::addSpan(const char* sName, const char* sCategory, qint64 startUs, qint64 endUs) {
+    if(!bTracing.loadAcquire())
+        return;
+    quint32 iSlot = nRecorded.fetchAndAddRelaxed(1) & ringMask;
+    TraceEvent& event = pRing.loadAcquire()[iSlot];
+    event.sName      = sName;
+    event.sCategory  = sCategory;
+    event.startUs    = startUs;
+    event.durationUs = endUs - startUs;
+    event.tid        = threadId();
+}
+
+
+// Write the recorded spans (oldest first) as a trace-event JSON file.
+// Tracing must be stopped first.
+bool
+Tracer::save(QString sFile) {
+    TraceEvent* pEvents = pRing.loadAcquire();
+    if(isEnabled() || (pEvents == Q_NULLPTR))
+        return false;
+    quint32 nEvents = nRecorded.loadAcquire();
+    quint32 iFirst  = 0;
+    if(nEvents > ringMask+1) {
+        iFirst  = nEvents - (ringMask+1);
+        qDebug() << "Trace ring overflow:" << iFirst << "oldest spans lost";
+    }
+    QSaveFile file(sFile);
+    if(!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Unable to write" << sFile;
+        return false;
+    }
+    qint64 pid = getpid();
+    file.write("{\"traceEvents\":[\n");
+    for(quint32 i=iFirst; i<nEvents; i++) {
+        const TraceEvent& event = pEvents[i & ringMask];
+        file.write(QString("{\"name\":\"%1\",\"cat\":\"%2\",\"ph\":\"X\","
+                           "\"ts\":%3,\"dur\":%4,\"pid\":%5,\"tid\":%6}%7\n")
+                   .arg(QLatin1String(event.sName))
+                   .arg(QLatin1String(event.sCategory))
+                   .arg(event.startUs)
+                   .arg(event.durationUs)
+                   .arg(pid)
+                   .arg(event.tid)
+                   .arg((i+1 < nEvents) ? "," : "")
+                   .toLatin1());
+    }
+    file.write("],\"displayTimeUnit\":\"ms\"}\n");
+    if(!file.commit()) {
+        qDebug() << "Error writing" << sFile;
+        return false;
+    }
+    qDebug() << "Trace of" << nEvents-iFirst << "spans saved to" << sFile;
+    return true;
+}
+
+
+TraceSpan::TraceSpan(const char* sName, const char* sCategory) {
+    sSpanName     = sName;
+    sSpanCategory = sCategory;
+    startTime     = Tracer::isEnabled() ? Tracer::now() : -1;
+}
+
+
+TraceSpan::~TraceSpan() {
+    if(startTime >= 0)
+        Tracer::addSpan(sSpanName, sSpanCategory, startTime, Tracer::now());
+}
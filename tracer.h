@@ -0,0 +1,41 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QtGlobal>
+#include <QString>
+
+
+#define DEFAULT_TRACE_EVENTS 65536 // Ring capacity (a power of 2)
+
+
+// Opt in recorder of timed spans, exported as Chrome trace-event JSON
+// (viewable in chrome://tracing or Perfetto). Spans are stored in a ring
+// allocated once, when tracing starts: recording a span never allocates
+// nor locks. When the ring is full the oldest spans are overwritten.
+// Span names and categories must be string literals.
+class Tracer
+{
+public:
+    static void start(int capacity = DEFAULT_TRACE_EVENTS);
+    static void stop();
+    static bool isEnabled();
+    static qint64 now();
+    static void addSpan(const char* sName, const char* sCategory, qint64 startUs, qint64 endUs);
+    static bool save(QString sFile);
+};
+
+
+// Records a span from its construction to the end of the scope
+class TraceSpan
+{
+public:
+    TraceSpan(const char* sName, const char* sCategory);
+    ~TraceSpan();
+
+private:
+    const char* sSpanName;
+    const char* sSpanCategory;
+    qint64 startTime;
+};
+
+#endif // TRACER_H
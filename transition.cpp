@@ -0,0 +1,102 @@
+#include "transition.h"
+
+#include <QDebug>
+
+
+Transition::Transition() {
+    program          = 0;
+    aspect           = 1.0f;
+    positionLocation = -1;
+    iTex0Loc         = -1;
+    iMPVLoc          = -1;
+    iAspectLoc       = -1;
+    iWindowLoc       = -1;
+}
+
+
+Transition::~Transition() {
+}
+
+
+// By default the slide is drawn as a single quad
+int
+Transition::xSteps() {
+    return 1;
+}
+
+
+int
+Transition::ySteps() {
+    return 1;
+}
+
+
+GLint
+Transition::uniformLocation(const char* sUniform) {
+    GLint location = glGetUniformLocation(program, sUniform);
+    if(location == -1)
+        qDebug() << name() << "transition: uniform" << sUniform << "not found";
+    return location;
+}
+
+
+bool
+Transition::init(GLuint newProgram, GLfloat newAspect) {
+    program = newProgram;
+    aspect  = newAspect;
+    glUseProgram(program);
+    positionLocation = glGetAttribLocation(program, "a_grid");
+    if(positionLocation == -1) {
+        qDebug() << name() << "transition: attribute a_grid not found";
+        return false;
+    }
+    iTex0Loc   = uniformLocation("texture0");
+    iMPVLoc    = uniformLocation("mvp_matrix");
+    iAspectLoc = uniformLocation("aspect");
+    iWindowLoc = uniformLocation("window0");
+    if((iTex0Loc   == -1) ||
+       (iMPVLoc    == -1) ||
+       (iAspectLoc == -1) ||
+       (iWindowLoc == -1))
+    {
+        return false;
+    }
+    // Uniforms keep their values in the program object
+    glUniform1i(iTex0Loc, 0);
+    glUniform1f(iAspectLoc, aspect);
+    if(!getLocations())
+        return false;
+    return mesh.create(xSteps(), ySteps());
+}
+
+
+void
+Transition::release() {
+    mesh.destroy();
+    program = 0;
+}
+
+
+int
+Transition::vertexBytes() {
+    return mesh.vertexBytes();
+}
+
+
+// Called when the transition is chosen for the next round
+void
+Transition::begin() {
+    glUseProgram(program);
+    reset();
+}
+
+
+// window: the part of the texture stretched over the sheet
+void
+Transition::drawSheet(GLuint texture, const QMatrix4x4& mvp, const QVector4D& window) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniformMatrix4fv(iMPVLoc, 1, GL_FALSE, mvp.constData());
+    glUniform4f(iWindowLoc, window.x(), window.y(), window.z(), window.w());
+    mesh.draw(positionLocation);
+}
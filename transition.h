@@ -0,0 +1,62 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include <QString>
+#include <QMatrix4x4>
+#include <QVector4D>
+
+#include "GLES2/gl2.h"
+
+#include "slidemesh.h"
+
+
+// What a transition needs to render a frame
+struct TransitionContext {
+    QMatrix4x4 projection;
+    GLfloat viewingDistance;
+    GLfloat aspect;
+    GLuint  texture0;// Outgoing slide
+    GLuint  texture1;// Incoming slide
+    QVector4D window0;// The parts of the slide textures shown
+    QVector4D window1;// (Ken Burns motion): x, y, width, height
+};
+
+
+// Base class of the slide transitions. Programs, uniform locations and
+// meshes are resolved once in init(): begin(), update() and draw() only
+// set uniform values and issue draw calls.
+class Transition
+{
+public:
+    Transition();
+    virtual ~Transition();
+    virtual QString name() = 0;
+    virtual QString vertexShader() = 0;
+    virtual QString fragmentShader() = 0;
+    bool init(GLuint newProgram, GLfloat newAspect);
+    void release();
+    void begin();
+    virtual void update(GLfloat progress) = 0;
+    virtual void draw(const TransitionContext& context) = 0;
+    int  vertexBytes();
+
+protected:
+    virtual int  xSteps();
+    virtual int  ySteps();
+    virtual bool getLocations() = 0;
+    virtual void reset() = 0;
+    GLint uniformLocation(const char* sUniform);
+    void  drawSheet(GLuint texture, const QMatrix4x4& mvp, const QVector4D& window);
+
+protected:
+    GLuint program;
+    GLfloat aspect;
+    SlideMesh mesh;
+    GLint positionLocation;
+    GLint iTex0Loc;
+    GLint iMPVLoc;
+    GLint iAspectLoc;
+    GLint iWindowLoc;
+};
+
+#endif // TRANSITION_H
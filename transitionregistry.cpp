@@ -0,0 +1,209 @@
+#include "transitionregistry.h"
+#include "transitions.h"
+
+#include <QDebug>
+#include <QFile>
+
+
+TransitionRegistry::TransitionRegistry() {
+    transitions.append(new FoldTransition());
+    transitions.append(new FadeTransition());
+    transitions.append(new ZoomTransition(false));
+    transitions.append(new ZoomTransition(true));
+    transitions.append(new RotateTransition(-1.0f));
+    transitions.append(new RotateTransition( 1.0f));
+    nLinked = 0;
+}
+
+
+TransitionRegistry::~TransitionRegistry() {
+    qDeleteAll(transitions);
+}
+
+
+int
+TransitionRegistry::count() {
+    return transitions.count();
+}
+
+
+Transition*
+TransitionRegistry::at(int i) {
+    return transitions.at(i);
+}
+
+
+// Returns Q_NULLPTR for unknown names
+Transition*
+TransitionRegistry::find(QString sName) {
+    for(int i=0; i<transitions.count(); i++) {
+        if(transitions.at(i)->name().compare(sName, Qt::CaseInsensitive) == 0)
+            return transitions.at(i);
+    }
+    return Q_NULLPTR;
+}
+
+
+QString
+TransitionRegistry::errorString() {
+    return sError;
+}
+
+
+// Number of programs built from source by the last init()
+int
+TransitionRegistry::linkedPrograms() {
+    return nLinked;
+}
+
+
+// Vertex and index buffers of all the transition meshes
+int
+TransitionRegistry::vertexBytes() {
+    int nBytes = 0;
+    for(int i=0; i<transitions.count(); i++)
+        nBytes += transitions.at(i)->vertexBytes();
+    return nBytes;
+}
+
+
+bool
+TransitionRegistry::compileShader(GLenum shaderType, QString shaderFile, const QByteArray& source, GLuint* pShaderName) {
+    const GLchar* vShaderStr = source.constData();
+    *pShaderName = glCreateShader(shaderType);
+    if(*pShaderName == 0) {
+        sError = QString("Unable to create shader");
+        return false;
+    }
+    //load shader source
+    glShaderSource(*pShaderName, 1, &vShaderStr, NULL);
+    //Compile shader
+    glCompileShader(*pShaderName);
+    // Check the compile status
+    GLint vCompiled;
+    glGetShaderiv(*pShaderName, GL_COMPILE_STATUS, &vCompiled);
+    if(!vCompiled) {
+        glDeleteShader(*pShaderName);
+        sError = QString("Unable to compile shader %1").arg(shaderFile);
+        return false;
+    }
+    return true;
+}
+
+
+bool
+TransitionRegistry::linkProgram(GLuint* pNewProgram, GLuint vertexShader, GLuint fragmentShader) {
+    *pNewProgram = glCreateProgram();
+    if(*pNewProgram == 0) {
+        sError = QString("Unable to create Program Object");
+        return false;
+    }
+    //Attach shaders to the program object
+    glAttachShader(*pNewProgram, vertexShader);
+    glAttachShader(*pNewProgram, fragmentShader);
+    // Link the program
+    glLinkProgram(*pNewProgram);
+    // Check the link status and print the errors
+    GLint linked;
+    glGetProgramiv(*pNewProgram, GL_LINK_STATUS, &linked);
+    if(!linked) {
+        GLint infoLen = 0;
+        glGetProgramiv(*pNewProgram, GL_INFO_LOG_LENGTH, &infoLen);
+
+        if(infoLen > 1) {
+            QByteArray infoLog(infoLen, '\0');
+            glGetProgramInfoLog(*pNewProgram, infoLen, NULL, infoLog.data());
+            qDebug() <<"Error linking program" << infoLog;
+        }
+        glDeleteProgram(*pNewProgram);
+        sError = QString("Error linking program");
+        return false;
+    }
+    return true;
+}
+
+
+// Build the programs of all the transitions (with the GL context current).
+// Programs are taken from the program cache (if any) when possible: on a
+// warm start the shader compiler is not used at all. Otherwise every shader
+// source is compiled and every (vertex, fragment) pair is linked only
+// once, even when shared by more transitions.
+bool
+TransitionRegistry::init(GLfloat aspect, ProgramCache* pProgramCache) {
+    release();
+    sError.clear();
+    nLinked = 0;
+    QHash<QString, QByteArray> sources;
+    QHash<QString, GLuint> shaders;
+    bool bResult = true;
+    for(int i=0; bResult && (i<transitions.count()); i++) {
+        Transition* pCurrent = transitions.at(i);
+        QString sVertex   = pCurrent->vertexShader();
+        QString sFragment = pCurrent->fragmentShader();
+        QString sFiles[2] = { sVertex, sFragment };
+        for(int j=0; bResult && (j<2); j++) {
+            if(sources.contains(sFiles[j]))
+                continue;
+            QFile file(sFiles[j]);
+            if(!file.open(QIODevice::ReadOnly)) {
+                sError = QString("Unable to open file: %1").arg(sFiles[j]);
+                bResult = false;
+                break;
+            }
+            sources.insert(sFiles[j], file.readAll());
+        }
+        if(!bResult)
+            break;
+        QString sPair = sVertex + "|" + sFragment;
+        if(!programs.contains(sPair)) {
+            GLuint newProgram = 0;
+            if(pProgramCache)
+                newProgram = pProgramCache->load(sources.value(sVertex), sources.value(sFragment));
+            if(newProgram == 0) {
+                if(!shaders.contains(sVertex)) {
+                    GLuint vShader;
+                    bResult = compileShader(GL_VERTEX_SHADER, sVertex, sources.value(sVertex), &vShader);
+                    if(!bResult)
+                        break;
+                    shaders.insert(sVertex, vShader);
+                }
+                if(!shaders.contains(sFragment)) {
+                    GLuint fShader;
+                    bResult = compileShader(GL_FRAGMENT_SHADER, sFragment, sources.value(sFragment), &fShader);
+                    if(!bResult)
+                        break;
+                    shaders.insert(sFragment, fShader);
+                }
+                bResult = linkProgram(&newProgram, shaders.value(sVertex), shaders.value(sFragment));
+                if(!bResult)
+                    break;
+                nLinked++;
+                if(pProgramCache)
+                    pProgramCache->store(newProgram, sources.value(sVertex), sources.value(sFragment));
+            }
+            programs.insert(sPair, newProgram);
+        }
+        if(!pCurrent->init(programs.value(sPair), aspect)) {
+            sError = QString("%1 transition: shader variables not found").arg(pCurrent->name());
+            bResult = false;
+        }
+    }
+    // Linked programs do not need their shader objects any more
+    QHashIterator<QString, GLuint> shader(shaders);
+    while(shader.hasNext())
+        glDeleteShader(shader.next().value());
+    if(!bResult)
+        release();
+    return bResult;
+}
+
+
+void
+TransitionRegistry::release() {
+    for(int i=0; i<transitions.count(); i++)
+        transitions.at(i)->release();
+    QHashIterator<QString, GLuint> program(programs);
+    while(program.hasNext())
+        glDeleteProgram(program.next().value());
+    programs.clear();
+}
@@ -0,0 +1,40 @@
+#ifndef TRANSITIONREGISTRY_H
+#define TRANSITIONREGISTRY_H
+
+#include <QVector>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+#include "transition.h"
+#include "programcache.h"
+
+
+// Owns one instance of every available transition.
+// To add a new transition just append it in the constructor.
+class TransitionRegistry
+{
+public:
+    TransitionRegistry();
+    ~TransitionRegistry();
+    int count();
+    Transition* at(int i);
+    Transition* find(QString sName);
+    bool init(GLfloat aspect, ProgramCache* pProgramCache);
+    void release();
+    int  linkedPrograms();
+    int  vertexBytes();
+    QString errorString();
+
+private:
+    bool compileShader(GLenum shaderType, QString shaderFile, const QByteArray& source, GLuint* pShaderName);
+    bool linkProgram(GLuint* pNewProgram, GLuint vertexShader, GLuint fragmentShader);
+
+private:
+    QVector<Transition*> transitions;
+    QHash<QString, GLuint> programs;
+    int nLinked;
+    QString sError;
+};
+
+#endif // TRANSITIONREGISTRY_H
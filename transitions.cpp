@@ -0,0 +1,301 @@
+#include "transitions.h"
+
+#include "math.h"
+
+
+//////////////////////////////////////////////////////////////////////
+// Fold
+//////////////////////////////////////////////////////////////////////
+FoldTransition::FoldTransition() {
+    A     = A0     = QVector4D(0.0, -1.0, 0.0, 1.0);
+    theta = theta0 = M_PI_2;
+    angle = angle0 = 0.0f;
+    iALoc = iThetaLoc = iAngleLoc = iLeftLoc = -1;
+}
+
+
+QString
+FoldTransition::name() {
+    return QString("Fold");
+}
+
+
+QString
+FoldTransition::vertexShader() {
+    return QString(":/vshaderFold.glsl");
+}
+
+
+QString
+FoldTransition::fragmentShader() {
+    return QString(":/fshaderFold.glsl");
+}
+
+
+// The sheet must be tessellated to be folded
+int
+FoldTransition::xSteps() {
+    return 54;
+}
+
+
+int
+FoldTransition::ySteps() {
+    return 36;
+}
+
+
+bool
+FoldTransition::getLocations() {
+    iALoc     = uniformLocation("a");
+    iThetaLoc = uniformLocation("theta");
+    iAngleLoc = uniformLocation("angle");
+    iLeftLoc  = uniformLocation("xLeft");
+    if((iALoc     == -1) ||
+       (iThetaLoc == -1) ||
+       (iAngleLoc == -1) ||
+       (iLeftLoc  == -1))
+    {
+        return false;
+    }
+    glUniform1f(iLeftLoc, -aspect);
+    return true;
+}
+
+
+void
+FoldTransition::reset() {
+    A     = A0;
+    theta = theta0;
+    angle = angle0;
+}
+
+
+// The sheet is rolled into a cone of decreasing
+// aperture and then rotated away
+void
+FoldTransition::update(GLfloat progress) {
+    A     = A0 + QVector4D(0.0, -0.88*progress, 0.0, 0.0);
+    theta = qMax(GLfloat(theta0-1.76*progress), 0.2f);
+    GLfloat rotation = progress - (theta0-0.2f)/1.76f;
+    angle = qBound(0.0f, GLfloat(angle0+6.6*rotation), GLfloat(M_PI_2));
+}
+
+
+void
+FoldTransition::draw(const TransitionContext& context) {
+    QMatrix4x4 matrix;
+    matrix.translate(0.0, 0.0, -context.viewingDistance);
+    glUniform4f(iALoc, A.x(), A.y(), A.z(), A.w());
+    glUniform1f(iThetaLoc, theta);
+    glUniform1f(iAngleLoc, angle);
+    drawSheet(context.texture0, context.projection * matrix, context.window0);
+
+    // The incoming slide lies flat just behind
+    matrix.setToIdentity();
+    matrix.translate(0.0, 0.0, -context.viewingDistance-0.01);
+    glUniform4f(iALoc, A0.x(), A0.y(), A0.z(), A0.w());
+    glUniform1f(iThetaLoc, theta0);
+    glUniform1f(iAngleLoc, angle0);
+    drawSheet(context.texture1, context.projection * matrix, context.window1);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Fade
+//////////////////////////////////////////////////////////////////////
+FadeTransition::FadeTransition() {
+    alpha = alpha0 = 1.0f;
+    iTex1Loc    = -1;
+    iAlphaLoc   = -1;
+    iWindow1Loc = -1;
+}
+
+
+QString
+FadeTransition::name() {
+    return QString("Fade");
+}
+
+
+QString
+FadeTransition::vertexShader() {
+    return QString(":/vshaderFade.glsl");
+}
+
+
+QString
+FadeTransition::fragmentShader() {
+    return QString(":/fshaderFade.glsl");
+}
+
+
+bool
+FadeTransition::getLocations() {
+    iTex1Loc    = uniformLocation("texture1");
+    iAlphaLoc   = uniformLocation("alpha");
+    iWindow1Loc = uniformLocation("window1");
+    if((iTex1Loc    == -1) ||
+       (iAlphaLoc   == -1) ||
+       (iWindow1Loc == -1))
+    {
+        return false;
+    }
+    glUniform1i(iTex1Loc, 1);
+    return true;
+}
+
+
+void
+FadeTransition::reset() {
+    alpha = alpha0;
+}
+
+
+void
+FadeTransition::update(GLfloat progress) {
+    alpha = alpha0 - progress;
+}
+
+
+void
+FadeTransition::draw(const TransitionContext& context) {
+    QMatrix4x4 matrix;
+    matrix.translate(0.0, 0.0, -context.viewingDistance);
+    glUniform1f(iAlphaLoc, alpha);
+    // Both the slides are sampled by a single quad,
+    // each through its own window
+    glUniform4f(iWindow1Loc, context.window1.x(), context.window1.y(),
+                             context.window1.z(), context.window1.w());
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, context.texture1);
+    drawSheet(context.texture0, context.projection * matrix, context.window0);
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Zoom
+//////////////////////////////////////////////////////////////////////
+ZoomTransition::ZoomTransition(bool bZoomIn) {
+    bIn    = bZoomIn;
+    fScale = fScale0 = 1.0f;
+}
+
+
+QString
+ZoomTransition::name() {
+    return bIn ? QString("Zoom in") : QString("Zoom out");
+}
+
+
+QString
+ZoomTransition::vertexShader() {
+    return QString(":/vshaderFade.glsl");
+}
+
+
+QString
+ZoomTransition::fragmentShader() {
+    return QString(":/fshaderFold.glsl");
+}
+
+
+bool
+ZoomTransition::getLocations() {
+    return true;
+}
+
+
+void
+ZoomTransition::reset() {
+    fScale = fScale0;
+}
+
+
+void
+ZoomTransition::update(GLfloat progress) {
+    fScale = fScale0 - progress;
+}
+
+
+void
+ZoomTransition::draw(const TransitionContext& context) {
+    QMatrix4x4 matrix;
+    if(bIn) {// The incoming slide grows over the outgoing one
+        matrix.translate(0.0, 0.0, -context.viewingDistance-0.01);
+        drawSheet(context.texture0, context.projection * matrix, context.window0);
+        matrix.setToIdentity();
+        matrix.translate(0.0, 0.0, -context.viewingDistance);
+        matrix.scale(1.0f-fScale);
+        drawSheet(context.texture1, context.projection * matrix, context.window1);
+    }
+    else {// The outgoing slide shrinks over the incoming one
+        matrix.translate(0.0, 0.0, -context.viewingDistance);
+        matrix.scale(fScale);
+        drawSheet(context.texture0, context.projection * matrix, context.window0);
+        matrix.setToIdentity();
+        matrix.translate(0.0, 0.0, -context.viewingDistance-0.01);
+        drawSheet(context.texture1, context.projection * matrix, context.window1);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////
+// Rotate
+//////////////////////////////////////////////////////////////////////
+RotateTransition::RotateTransition(GLfloat yPivotCorner) {
+    yPivot = yPivotCorner;
+    fRot   = fRot0 = 0.0f;
+}
+
+
+QString
+RotateTransition::name() {
+    return (yPivot < 0.0f) ? QString("Rotate from bottom left")
+                           : QString("Rotate from top left");
+}
+
+
+QString
+RotateTransition::vertexShader() {
+    return QString(":/vshaderFade.glsl");
+}
+
+
+QString
+RotateTransition::fragmentShader() {
+    return QString(":/fshaderFold.glsl");
+}
+
+
+bool
+RotateTransition::getLocations() {
+    return true;
+}
+
+
+void
+RotateTransition::reset() {
+    fRot = fRot0;
+}
+
+
+void
+RotateTransition::update(GLfloat progress) {
+    fRot = fRot0 + 90.0f*progress;
+}
+
+
+void
+RotateTransition::draw(const TransitionContext& context) {
+    QMatrix4x4 matrix;
+    matrix.translate(0.0, 0.0, -context.viewingDistance);
+    matrix.translate(-context.aspect, yPivot, 0.0);
+    matrix.rotate(fRot, 0.0, 0.0, -1.0);
+    matrix.translate(context.aspect, -yPivot, 0.0);
+    drawSheet(context.texture0, context.projection * matrix, context.window0);
+
+    matrix.setToIdentity();
+    matrix.translate(0.0, 0.0, -context.viewingDistance-0.01);
+    drawSheet(context.texture1, context.projection * matrix, context.window1);
+}
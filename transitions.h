@@ -0,0 +1,98 @@
+#ifndef TRANSITIONS_H
+#define TRANSITIONS_H
+
+#include <QVector4D>
+
+#include "transition.h"
+
+
+// The outgoing slide is rolled into a cone and rotated away
+class FoldTransition : public Transition
+{
+public:
+    FoldTransition();
+    QString name();
+    QString vertexShader();
+    QString fragmentShader();
+    void update(GLfloat progress);
+    void draw(const TransitionContext& context);
+
+protected:
+    int  xSteps();
+    int  ySteps();
+    bool getLocations();
+    void reset();
+
+private:
+    QVector4D A, A0;
+    GLfloat theta, theta0;
+    GLfloat angle, angle0;
+    GLint iALoc, iThetaLoc, iAngleLoc, iLeftLoc;
+};
+
+
+// Cross fade between the two slides
+class FadeTransition : public Transition
+{
+public:
+    FadeTransition();
+    QString name();
+    QString vertexShader();
+    QString fragmentShader();
+    void update(GLfloat progress);
+    void draw(const TransitionContext& context);
+
+protected:
+    bool getLocations();
+    void reset();
+
+private:
+    GLfloat alpha, alpha0;
+    GLint iTex1Loc, iAlphaLoc, iWindow1Loc;
+};
+
+
+// The outgoing slide shrinks away (zoom out) or
+// the incoming one grows from the center (zoom in)
+class ZoomTransition : public Transition
+{
+public:
+    ZoomTransition(bool bZoomIn);
+    QString name();
+    QString vertexShader();
+    QString fragmentShader();
+    void update(GLfloat progress);
+    void draw(const TransitionContext& context);
+
+protected:
+    bool getLocations();
+    void reset();
+
+private:
+    bool bIn;
+    GLfloat fScale, fScale0;
+};
+
+
+// The outgoing slide rotates away around its bottom
+// left (yPivot = -1) or top left (yPivot = 1) corner
+class RotateTransition : public Transition
+{
+public:
+    RotateTransition(GLfloat yPivotCorner);
+    QString name();
+    QString vertexShader();
+    QString fragmentShader();
+    void update(GLfloat progress);
+    void draw(const TransitionContext& context);
+
+protected:
+    bool getLocations();
+    void reset();
+
+private:
+    GLfloat yPivot;
+    GLfloat fRot, fRot0;
+};
+
+#endif // TRANSITIONS_H
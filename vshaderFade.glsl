@@ -5,9 +5,13 @@ precision highp float;
 #endif
 
 uniform mat4 mvp_matrix;
-attribute vec4 p;
-attribute vec2 a_texcoord;
+uniform float aspect;
+// The part of each slide texture shown (x, y offset and width, height)
+uniform vec4 window0;
+uniform vec4 window1;
+attribute vec2 a_grid;
 varying vec2   v_texcoord;
+varying vec2   v_texcoord1;
 
 
 // The built-in varying called "gl_Position" is declared automatically,
@@ -16,8 +20,11 @@ varying vec2   v_texcoord;
 
 void
 main() {
+    // The grid coordinates (0.0 to 1.0) map to a 2*aspect x 2 sheet
+    vec4 p = vec4((2.0*a_grid.x-1.0)*aspect, 2.0*a_grid.y-1.0, 0.0, 1.0);
     gl_Position = mvp_matrix * p;
     // Pass texture coordinate to fragment shader
     // Value will be automatically interpolated to fragments inside polygon faces
-    v_texcoord = a_texcoord;
+    v_texcoord  = window0.xy + a_grid*window0.zw;
+    v_texcoord1 = window1.xy + a_grid*window1.zw;
 }
@@ -9,11 +9,13 @@ uniform vec4 a;
 uniform float theta;
 uniform float angle;
 uniform float xLeft;
+uniform float aspect;
+// The part of the slide texture shown (x, y offset and width, height)
+uniform vec4 window0;
 
 float r, R, beta;
 vec4 T;
-attribute vec4 p;
-attribute vec2 a_texcoord;
+attribute vec2 a_grid;
 varying vec2   v_texcoord;
 
 
@@ -23,6 +25,8 @@ varying vec2   v_texcoord;
 
 void
 main() {
+    // The grid coordinates (0.0 to 1.0) map to a 2*aspect x 2 sheet
+    vec4 p = vec4((2.0*a_grid.x-1.0)*aspect, 2.0*a_grid.y-1.0, 0.0, 1.0);
     T = vec4(0.0, 0.0, 0.0, 1.0);
     // Compute conical parameters
     R = sqrt((p.x-xLeft)*(p.x-xLeft) + ((p.y+1.0)-a.y)*((p.y+1.0)-a.y));
@@ -46,5 +50,5 @@ main() {
 
     // Pass texture coordinate to fragment shader
     // Value will be automatically interpolated to fragments inside polygon faces
-    v_texcoord = a_texcoord;
+    v_texcoord = window0.xy + a_grid*window0.zw;
 }